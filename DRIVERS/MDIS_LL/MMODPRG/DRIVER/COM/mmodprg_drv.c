@@ -13,6 +13,27 @@
  *     Switches: _ONE_NAMESPACE_PER_DRIVER_, MAC_BYTESWAP,
  *               MMODPROG_ADDRSPACE_SIZE
  *
+ *               Besides single 8/16/32-bit accesses the driver can execute
+ *               micro-sequence programs (MMODPRG_BLK_SEQ), i.e. chains of
+ *               write/read/RMW/poll/delay/branch instructions that are
+ *               validated against the address window and then run in one
+ *               call at bus speed. Burst transfers (MMODPRG_BLK_BURST)
+ *               read/write consecutive elements in one call.
+ *
+ *               Each channel is a context holding call counters and a
+ *               staging buffer for misaligned copies, which is allocated
+ *               on first use. The driver reports MMODPRG_CTX_NUM channels.
+ *               Context isolation is opt-in: all paths start on channel 0
+ *               and share its context; a path gets its own context only
+ *               after selecting another channel with M_MK_CH_CURRENT.
+ *
+ *               Status calls can be recorded into a trace ring
+ *               (MMODPRG_TRC_START) with OSS tick timestamps. Single
+ *               accesses are replayed by the mmodprg_trace tool.
+ *
+ *               Periodic write jobs (MMODPRG_BLK_JOB_START), e.g. watchdog
+ *               or heartbeat toggling, run from cyclic OSS alarms.
+ *
  *---------------------------------------------------------------------------
  * Copyright 2010-2019, MEN Mikro Elektronik GmbH
  ****************************************************************************/
@@ -51,7 +72,7 @@ static const char IdentString[]=MENT_XSTR(MAK_REVISION);
 |  DEFINES                                 |
 +-----------------------------------------*/
 /* general */
-#define CH_NUMBER			1			/* number of device channels */
+#define CH_NUMBER			MMODPRG_CTX_NUM	/* number of device channels */
 #define USE_IRQ				FALSE		/* interrupt required  */
 #define ADDRSPACE_COUNT		1			/* nr of required address spaces */
 #define MOD_ID_SIZE			128			/* ID PROM size [bytes] */
@@ -63,9 +84,38 @@ static const char IdentString[]=MENT_XSTR(MAK_REVISION);
 /* register offsets */
 /* ... */
 
+/* misaligned copies of at least this size are staged */
+#define COPY_STAGE_MIN		16
+
+/* max. delay between snapshot retries [us], doubled from 1us */
+#define SNAP_BACKOFF_MAX	16
+
 /*-----------------------------------------+
 |  TYPEDEFS                                |
 +-----------------------------------------*/
+/* periodic write job slot */
+typedef struct {
+	void            *h;             /* low-level handle */
+	OSS_ALARM_HANDLE *alarm;        /* job timer, NULL=stopped */
+	MMODPRG_JOB     def;            /* job definition */
+	u_int32         idx;            /* SEQ: index of next value */
+	u_int32         value;          /* next value to write */
+	u_int32         lastValue;      /* value last written */
+	u_int32         realMs;         /* real timer period [ms] */
+	u_int32         tickRate;       /* OSS ticks per second */
+	u_int32         lastTick;       /* tick of last write */
+	u_int32         runs;           /* writes done */
+	u_int32         missed;         /* missed deadlines */
+	int             run;            /* timer may write (lock) */
+} JOB_SLOT;
+
+/* per-path context */
+typedef struct {
+	u_int8          *stage;         /* copy staging buffer, NULL=not used yet */
+	u_int32         stageAlloc;     /* size allocated for staging buffer */
+	MMODPRG_CTX_STAT stat;          /* counters */
+} MMODPRG_CTX;
+
 /* low-level handle */
 typedef struct {
 	/* general */
@@ -74,6 +124,7 @@ typedef struct {
     OSS_IRQ_HANDLE  *irqHdl;        /* irq handle */
     DESC_HANDLE     *descHdl;       /* desc handle */
     MACCESS         ma;             /* hw access handle */
+	OSS_SPINL_HANDLE *lock;         /* timer routines vs. driver calls */
 	MDIS_IDENT_FUNCT_TBL idFuncTbl;	/* id function table */
 	/* debug */
     u_int32         dbgLevel;		/* debug level */
@@ -81,6 +132,37 @@ typedef struct {
 	/* misc */
     u_int32         irqCount;       /* interrupt counter */
     u_int32         idCheck;		/* id check enabled */
+    u_int32         winSize;        /* size of address window [bytes] */
+	/* sampler */
+	OSS_ALARM_HANDLE *smpAlarm;     /* sampling timer, NULL=stopped */
+	int             smpRun;         /* timer may sample (lock) */
+	MMODPRG_SMP_ENTRY smpEnt[MMODPRG_SMP_MAX_ENTRIES]; /* plan */
+	u_int32         smpNEnt;        /* number of plan entries */
+	u_int8          *smpBuf;        /* ring buffer */
+	u_int32         smpBufAlloc;    /* size allocated for ring buffer */
+	u_int32         smpRecSize;     /* bytes per sample */
+	u_int32         smpNRec;        /* ring buffer capacity [samples] */
+	u_int32         smpIn;          /* samples produced (timer, lock) */
+	u_int32         smpOut;         /* samples consumed (read, lock) */
+	u_int32         smpWr;          /* next slot to write (lock) */
+	u_int32         smpRd;          /* next slot to read (lock) */
+	u_int32         smpSeq;         /* sample number (lock) */
+	u_int32         smpOverrun;     /* samples lost, buffer full (lock) */
+	u_int32         smpRealMs;      /* real timer period [ms] */
+	/* trace */
+	MMODPRG_TRC_ENT *trcBuf;        /* trace ring, NULL=none */
+	u_int32         trcAlloc;       /* size allocated for trace ring */
+	u_int32         trcNEnt;        /* ring capacity [records] */
+	u_int32         trcWr;          /* next slot to write */
+	u_int32         trcRd;          /* next slot to read */
+	u_int32         trcCnt;         /* records in ring */
+	u_int32         trcLost;        /* records lost, ring full */
+	int             trcOn;          /* recording */
+	u_int32         trcRes;         /* timestamp resolution [us] */
+	/* periodic jobs */
+	JOB_SLOT        job[MMODPRG_JOB_MAX];
+	/* per-path contexts (one per channel) */
+	MMODPRG_CTX     ctx[CH_NUMBER];
 } MMODPRG_HANDLE;
 
 /* include files which need LL_HANDLE */
@@ -105,6 +187,38 @@ static int32 MMODPRG_Info(int32 infoType, ... );
 
 static char* Ident( void );
 static int32 Cleanup(MMODPRG_HANDLE *llHdl, int32 retCode);
+static u_int32 AccRead(MMODPRG_HANDLE *h, u_int32 width, u_int32 offs);
+static void AccWrite(MMODPRG_HANDLE *h, u_int32 width, u_int32 offs,
+					 u_int32 val);
+static int32 CheckRange(MMODPRG_HANDLE *h, u_int32 offs, u_int32 width,
+						u_int32 count);
+static int32 SeqRun(MMODPRG_HANDLE *h, M_SG_BLOCK *blk);
+static int32 Burst(MMODPRG_HANDLE *h, M_SG_BLOCK *blk, int write);
+static int32 Fifo(MMODPRG_HANDLE *h, M_SG_BLOCK *blk, int write);
+static int32 Stride(MMODPRG_HANDLE *h, M_SG_BLOCK *blk, int write);
+static int32 Copy(MMODPRG_HANDLE *h, MMODPRG_CTX *ctx, M_SG_BLOCK *blk);
+static void WinRead(MMODPRG_HANDLE *h, u_int32 offs, u_int32 len,
+					u_int8 *buf);
+static void WinWrite(MMODPRG_HANDLE *h, u_int32 offs, u_int32 len,
+					 const u_int8 *buf);
+static int32 Search(MMODPRG_HANDLE *h, M_SG_BLOCK *blk);
+static int32 Snap(MMODPRG_HANDLE *h, M_SG_BLOCK *blk);
+static int SramAlias(MMODPRG_HANDLE *h, u_int32 offs);
+static u_int32 SramSize(MMODPRG_HANDLE *h);
+static int32 SmpStart(MMODPRG_HANDLE *h, M_SG_BLOCK *blk);
+static void SmpStop(MMODPRG_HANDLE *h);
+static void SmpAlarm(void *arg);
+static int32 SmpDrain(MMODPRG_HANDLE *h, u_int8 *buf, int32 size);
+static int32 TrcStart(MMODPRG_HANDLE *h, u_int32 nEnt);
+static u_int32 TrcTime(MMODPRG_HANDLE *h);
+static void TrcAdd(MMODPRG_HANDLE *h, int32 ch, u_int32 op, u_int32 code,
+				   u_int32 width, u_int32 offs, u_int32 val);
+static int32 TrcRead(MMODPRG_HANDLE *h, M_SG_BLOCK *blk);
+static int32 JobStart(MMODPRG_HANDLE *h, M_SG_BLOCK *blk);
+static void JobStop(MMODPRG_HANDLE *h, JOB_SLOT *job);
+static void JobAlarm(void *arg);
+static int32 JobStat(MMODPRG_HANDLE *h, M_SG_BLOCK *blk);
+static int32 CtxStage(MMODPRG_HANDLE *h, MMODPRG_CTX *ctx);
 
 /**************************** MMODPRG_GetEntry *********************************
  *
@@ -144,6 +258,14 @@ extern void __MMODPRG_GetEntry( LL_ENTRY* drvP )
  *                DEBUG_LEVEL_DESC      OSS_DBG_DEFAULT  see dbg.h
  *                DEBUG_LEVEL           OSS_DBG_DEFAULT  see dbg.h
  *                ID_CHECK              1                0..1
+ *                WINDOW_SIZE           (1)              0..max
+ *
+ *                (1) MMODPRG_ADDRSPACE_SIZE of the driver variant. WINDOW_SIZE
+ *                    limits all range checked accesses (micro-sequences etc.)
+ *                    and may lower the window, e.g. to the SRAM size. It is
+ *                    clamped to the mapped size MMODPRG_ADDRSPACE_SIZE (see
+ *                    LL_INFO_ADDRSPACE), use a driver variant with a larger
+ *                    address space for larger windows. 0 selects the default.
  *
  *---------------------------------------------------------------------------
  *  Input......:  descSpec   pointer to descriptor data
@@ -234,6 +356,23 @@ static int32 MMODPRG_Init(
 		error != ERR_DESC_KEY_NOTFOUND)
 		return( Cleanup(h,error) );
 
+    /* WINDOW_SIZE */
+    if ((error = DESC_GetUInt32(h->descHdl, MMODPRG_ADDRSPACE_SIZE,
+								&h->winSize, "WINDOW_SIZE")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(h,error) );
+
+	/* never beyond the address space requested from MDIS */
+	if (h->winSize == 0 || h->winSize > MMODPRG_ADDRSPACE_SIZE)
+		h->winSize = MMODPRG_ADDRSPACE_SIZE;
+
+	/* required for micro-sequence POLL/DELAY */
+	OSS_MikroDelayInit(osHdl);
+
+	/* serializes timer routines against driver calls */
+	if ((error = OSS_SpinLockCreate(osHdl, &h->lock)))
+		return( Cleanup(h,error) );
+
     /*------------------------------+
     |  init hardware                |
     +------------------------------*/
@@ -338,6 +477,58 @@ static int32 MMODPRG_Write(
  *                Code                 Description                 Values
  *                -------------------  --------------------------  ----------
  *                M_LL_BLK_ID_DATA     program IDPROM data         -
+ *                M_LL_DEBUG_LEVEL     driver debug level          see dbg.h
+ *                MMODPRG_BLK_D8/16/32 write single value          -
+ *                MMODPRG_BLK_SEQ      run micro-sequence          -
+ *                MMODPRG_BLK_BURST    write consecutive elements  -
+ *                MMODPRG_BLK_FIFO     write to FIFO port          -
+ *                MMODPRG_BLK_STRIDE   write strided/2D elements   -
+ *                MMODPRG_BLK_COPY     copy within window          -
+ *                MMODPRG_BLK_SMP_PLAN load plan, start sampler    -
+ *                MMODPRG_SMP_STOP     stop sampler                -
+ *                MMODPRG_CTX_CLR      clear counters of path      -
+ *                MMODPRG_TRC_START    start trace (capacity)      1..max
+ *                MMODPRG_TRC_STOP     stop trace                  -
+ *                MMODPRG_BLK_JOB_START start periodic write job   -
+ *                MMODPRG_JOB_STOP     stop periodic job           0..max or
+ *                                                                 ALL
+ *
+ *                MMODPRG_BLK_JOB_START (MMODPRG_JOB) replaces the job in
+ *                the given slot and writes its values from a cyclic OSS
+ *                alarm. Deadlines missed by more than a period are
+ *                counted (with OSS tick resolution), so the period must
+ *                be at least two OSS ticks. Job writes are serialized
+ *                with micro-sequence RMW instructions and copies.
+ *
+ *                MMODPRG_TRC_START discards a previous trace and records
+ *                all following device status calls of all paths into a
+ *                ring of the given capacity: single accesses
+ *                (MMODPRG_BLK_D8/16/32) with offset and value, all other
+ *                codes with their value or block length. Trace control
+ *                codes are not recorded. Records are dropped (and
+ *                counted) while the ring is full. MMODPRG_TRC_STOP keeps
+ *                the recorded trace readable.
+ *
+ *                MMODPRG_BLK_FIFO writes all elements to one offset. With
+ *                a level register the transfer may be shorter, read the
+ *                level register first to get the number of free entries.
+ *
+ *                MMODPRG_BLK_COPY (MMODPRG_COPY_PB) copies like memmove()
+ *                with the widest access both offsets allow. Misaligned
+ *                copies are staged in the context's staging buffer.
+ *
+ *                MMODPRG_BLK_SMP_PLAN stops a running sampler, discards
+ *                its buffered samples and starts sampling with the new
+ *                plan (MMODPRG_SMP_PLAN followed by the entries) from a
+ *                cyclic OSS alarm. MMODPRG_SMP_STOP keeps the buffered
+ *                samples readable.
+ *
+ *                MMODPRG_BLK_SEQ validates the complete program first and
+ *                returns ERR_LL_ILL_PARAM without accessing the hardware
+ *                if any instruction is invalid or outside the window.
+ *                ERR_OSS_TIMEOUT is returned if a POLL instruction timed
+ *                out. Results of READ instructions are discarded, use the
+ *                GetStat variant to get them.
  *
  *---------------------------------------------------------------------------
  *  Input......:  llHdl             low-level handle
@@ -361,6 +552,7 @@ static int32 MMODPRG_SetStat(
 	int32 error = ERR_SUCCESS;
 	M_SG_BLOCK *blk = (M_SG_BLOCK*)valueP;
 	MMODPRG_HANDLE *h = (MMODPRG_HANDLE *)llHdl;
+	MMODPRG_CTX *ctx = &h->ctx[ch];
     MACCESS ma = h->ma;
 
     DBGWRT_1((DBH, "LL - MMODPRG_SetStat: ch=%d code=0x%04x value=0x%x\n",
@@ -395,6 +587,9 @@ static int32 MMODPRG_SetStat(
                       pb->value, pb->offset ));
 
             MWRITE_D8( ma, pb->offset, pb->value );
+            if (h->trcOn)
+                TrcAdd( h, ch, MMODPRG_TRC_OP_WRITE, MMODPRG_BLK_D8, 1,
+                        pb->offset, pb->value );
             break;
         }
 
@@ -408,6 +603,9 @@ static int32 MMODPRG_SetStat(
                       pb->value, pb->offset ));
 
             MWRITE_D16( ma, pb->offset, pb->value );
+            if (h->trcOn)
+                TrcAdd( h, ch, MMODPRG_TRC_OP_WRITE, MMODPRG_BLK_D16, 2,
+                        pb->offset, pb->value );
             break;
         }
 
@@ -421,6 +619,88 @@ static int32 MMODPRG_SetStat(
                       pb->value, pb->offset ));
 
             MWRITE_D32( ma, pb->offset, pb->value );
+            if (h->trcOn)
+                TrcAdd( h, ch, MMODPRG_TRC_OP_WRITE, MMODPRG_BLK_D32, 4,
+                        pb->offset, pb->value );
+            break;
+        }
+
+        /*--------------------------+
+        |  run micro-sequence       |
+        +--------------------------*/
+        case MMODPRG_BLK_SEQ:
+            error = SeqRun( h, blk );
+            break;
+
+        /*--------------------------+
+        |  write burst              |
+        +--------------------------*/
+        case MMODPRG_BLK_BURST:
+            error = Burst( h, blk, TRUE );
+            break;
+
+        /*--------------------------+
+        |  write FIFO port          |
+        +--------------------------*/
+        case MMODPRG_BLK_FIFO:
+            error = Fifo( h, blk, TRUE );
+            break;
+
+        /*--------------------------+
+        |  write strided/2D         |
+        +--------------------------*/
+        case MMODPRG_BLK_STRIDE:
+            error = Stride( h, blk, TRUE );
+            break;
+
+        /*--------------------------+
+        |  copy within window       |
+        +--------------------------*/
+        case MMODPRG_BLK_COPY:
+            error = Copy( h, ctx, blk );
+            break;
+
+        /*--------------------------+
+        |  start/stop sampler       |
+        +--------------------------*/
+        case MMODPRG_BLK_SMP_PLAN:
+            error = SmpStart( h, blk );
+            break;
+
+        case MMODPRG_SMP_STOP:
+            SmpStop( h );
+            break;
+
+        /*--------------------------+
+        |  start/stop trace         |
+        +--------------------------*/
+        case MMODPRG_TRC_START:
+            error = TrcStart( h, value );
+            break;
+
+        case MMODPRG_TRC_STOP:
+            h->trcOn = FALSE;
+            break;
+
+        /*--------------------------+
+        |  start/stop periodic job  |
+        +--------------------------*/
+        case MMODPRG_BLK_JOB_START:
+            error = JobStart( h, blk );
+            break;
+
+        case MMODPRG_JOB_STOP:
+        {
+            u_int32 n;
+
+            if ((u_int32)value == MMODPRG_JOB_ALL) {
+                for (n=0; n<MMODPRG_JOB_MAX; n++)
+                    JobStop( h, &h->job[n] );
+            }
+            else if ((u_int32)value < MMODPRG_JOB_MAX)
+                JobStop( h, &h->job[value] );
+            else
+                error = ERR_LL_ILL_PARAM;
             break;
         }
 
@@ -430,6 +710,14 @@ static int32 MMODPRG_SetStat(
         case M_LL_DEBUG_LEVEL:
             h->dbgLevel = value;
             break;
+
+        /*--------------------------+
+        |  clear path counters      |
+        +--------------------------*/
+        case MMODPRG_CTX_CLR:
+            OSS_MemFill(h->osHdl, sizeof(ctx->stat), (char*)&ctx->stat, 0);
+            break;
+
         /*--------------------------+
         |  (unknown)                |
         +--------------------------*/
@@ -437,6 +725,21 @@ static int32 MMODPRG_SetStat(
             error = ERR_LL_UNK_CODE;
     }
 
+	ctx->stat.setStats++;
+	if (error)
+		ctx->stat.errors++;
+	else if (code >= M_DEV_BLK_OF && code < M_DEV_BLK_OF + 0x100)
+		ctx->stat.bytesIn += blk->size;
+
+	/* single accesses are traced above, failed calls are not traced */
+	if (h->trcOn && !error && code != MMODPRG_BLK_D8 && code != MMODPRG_BLK_D16 &&
+		code != MMODPRG_BLK_D32 && code != MMODPRG_TRC_START) {
+		if (code >= M_DEV_BLK_OF && code < M_DEV_BLK_OF + 0x100)
+			TrcAdd(h, ch, MMODPRG_TRC_OP_SET, code, 0, 0, blk->size);
+		else if (code >= M_DEV_OF && code < M_DEV_OF + 0x100)
+			TrcAdd(h, ch, MMODPRG_TRC_OP_SET, code, 0, 0, value);
+	}
+
 	return(error);
 }
 
@@ -458,6 +761,34 @@ static int32 MMODPRG_SetStat(
  *                M_LL_ID_SIZE         EEPROM size [bytes]         128
  *                M_LL_BLK_ID_DATA     EEPROM raw data             -
  *                M_MK_BLK_REV_ID      ident function table ptr    -
+ *                MMODPRG_WIN_SIZE     address window size         0..max
+ *                MMODPRG_SRAM_SIZE    probed usable SRAM size     4..max
+ *                MMODPRG_SMP_OVERRUN  samples lost (buffer full)  0..max
+ *                MMODPRG_SMP_COUNT    samples in buffer           0..max
+ *                MMODPRG_SMP_PERIOD   real sampling period [ms]   0..max
+ *                MMODPRG_TRC_COUNT    records in trace ring       0..max
+ *                MMODPRG_TRC_RES      trace time resolution [us]  1..max
+ *                MMODPRG_BLK_D8/16/32 read single value           -
+ *                MMODPRG_BLK_SEQ      run micro-sequence          -
+ *                MMODPRG_BLK_BURST    read consecutive elements   -
+ *                MMODPRG_BLK_FIFO     read from FIFO port         -
+ *                MMODPRG_BLK_STRIDE   read strided/2D elements    -
+ *                MMODPRG_BLK_SEARCH   search value in range       -
+ *                MMODPRG_BLK_SNAP     consistent snapshot read    -
+ *                MMODPRG_BLK_CTX_STAT counters of this path       -
+ *                MMODPRG_BLK_TRC      read trace records          -
+ *                MMODPRG_BLK_JOB_STAT periodic job status         -
+ *
+ *                MMODPRG_BLK_SEQ works like the SetStat variant but returns
+ *                the result slots and the program status in the block.
+ *                A POLL timeout is not reported as error, check the
+ *                status field of the MMODPRG_SEQ_HDR instead.
+ *
+ *                MMODPRG_BLK_SEARCH stops as soon as maxHits matches are
+ *                found and returns their offsets and count in the block.
+ *
+ *                MMODPRG_BLK_SNAP returns ERR_LL_DEV_BUSY if no consistent
+ *                snapshot could be read within the retry limit.
  *
  *---------------------------------------------------------------------------
  *  Input......:  llHdl             low-level handle
@@ -479,6 +810,7 @@ static int32 MMODPRG_GetStat(
 )
 {
 	MMODPRG_HANDLE *h = (MMODPRG_HANDLE *)llHdl;
+	MMODPRG_CTX *ctx = &h->ctx[ch];
     MACCESS ma = h->ma;
     int32 *valueP = (int32*)value32_or_64P;	            /* pointer to 32bit value  */
     INT32_OR_64	*value64P = value32_or_64P;		 		/* stores 32/64bit pointer  */
@@ -563,6 +895,50 @@ static int32 MMODPRG_GetStat(
            *value64P = (INT32_OR_64)&h->idFuncTbl;
            break;
 
+        /*--------------------------+
+        |  address window size      |
+        +--------------------------*/
+        case MMODPRG_WIN_SIZE:
+            *valueP = h->winSize;
+            break;
+
+        /*--------------------------+
+        |  probe SRAM size          |
+        +--------------------------*/
+        case MMODPRG_SRAM_SIZE:
+            *valueP = SramSize( h );
+            break;
+
+        /*--------------------------+
+        |  sampler state            |
+        +--------------------------*/
+        case MMODPRG_SMP_OVERRUN:
+            OSS_SpinLockAcquire( h->osHdl, h->lock );
+            *valueP = h->smpOverrun;
+            OSS_SpinLockRelease( h->osHdl, h->lock );
+            break;
+
+        case MMODPRG_SMP_COUNT:
+            OSS_SpinLockAcquire( h->osHdl, h->lock );
+            *valueP = h->smpIn - h->smpOut;
+            OSS_SpinLockRelease( h->osHdl, h->lock );
+            break;
+
+        case MMODPRG_SMP_PERIOD:
+            *valueP = h->smpAlarm ? h->smpRealMs : 0;
+            break;
+
+        /*--------------------------+
+        |  trace state              |
+        +--------------------------*/
+        case MMODPRG_TRC_COUNT:
+            *valueP = h->trcCnt;
+            break;
+
+        case MMODPRG_TRC_RES:
+            *valueP = h->trcRes;
+            break;
+
         /*--------------------------+
         |  read 8 bit value         |
         +--------------------------*/
@@ -571,6 +947,9 @@ static int32 MMODPRG_GetStat(
             MMODPRG_DX_PB *pb = (MMODPRG_DX_PB*)blk->data;
 
             pb->value = MREAD_D8( ma, pb->offset );
+            if (h->trcOn)
+                TrcAdd( h, ch, MMODPRG_TRC_OP_READ, MMODPRG_BLK_D8, 1,
+                        pb->offset, pb->value );
             DBGWRT_3((DBH, "8 bit value 0x%x read from offset 0x%x\n",
                       pb->value, pb->offset ));
             break;
@@ -584,6 +963,9 @@ static int32 MMODPRG_GetStat(
             MMODPRG_DX_PB *pb = (MMODPRG_DX_PB*)blk->data;
 
             pb->value = MREAD_D16( ma, pb->offset );
+            if (h->trcOn)
+                TrcAdd( h, ch, MMODPRG_TRC_OP_READ, MMODPRG_BLK_D16, 2,
+                        pb->offset, pb->value );
             DBGWRT_3((DBH, "16 bit value 0x%x read from offset 0x%x\n",
                       pb->value, pb->offset ));
             break;
@@ -597,11 +979,84 @@ static int32 MMODPRG_GetStat(
             MMODPRG_DX_PB *pb = (MMODPRG_DX_PB*)blk->data;
 
             pb->value = MREAD_D32( ma, pb->offset );
+            if (h->trcOn)
+                TrcAdd( h, ch, MMODPRG_TRC_OP_READ, MMODPRG_BLK_D32, 4,
+                        pb->offset, pb->value );
             DBGWRT_3((DBH, "32 bit value 0x%x read from offset 0x%x\n",
                       pb->value, pb->offset ));
             break;
         }
 
+        /*--------------------------+
+        |  run micro-sequence       |
+        +--------------------------*/
+        case MMODPRG_BLK_SEQ:
+            error = SeqRun( h, blk );
+            if( error == ERR_OSS_TIMEOUT )
+                error = ERR_SUCCESS;	/* reported in status field */
+            break;
+
+        /*--------------------------+
+        |  read burst               |
+        +--------------------------*/
+        case MMODPRG_BLK_BURST:
+            error = Burst( h, blk, FALSE );
+            break;
+
+        /*--------------------------+
+        |  read FIFO port           |
+        +--------------------------*/
+        case MMODPRG_BLK_FIFO:
+            error = Fifo( h, blk, FALSE );
+            break;
+
+        /*--------------------------+
+        |  read strided/2D          |
+        +--------------------------*/
+        case MMODPRG_BLK_STRIDE:
+            error = Stride( h, blk, FALSE );
+            break;
+
+        /*--------------------------+
+        |  search value             |
+        +--------------------------*/
+        case MMODPRG_BLK_SEARCH:
+            error = Search( h, blk );
+            break;
+
+        /*--------------------------+
+        |  snapshot read            |
+        +--------------------------*/
+        case MMODPRG_BLK_SNAP:
+            error = Snap( h, blk );
+            break;
+
+        /*--------------------------+
+        |  path counters            |
+        +--------------------------*/
+        case MMODPRG_BLK_CTX_STAT:
+            if (blk->size < (int32)sizeof(MMODPRG_CTX_STAT)) {
+                error = ERR_LL_USERBUF;
+                break;
+            }
+            OSS_MemCopy(h->osHdl, sizeof(ctx->stat), (char*)&ctx->stat,
+                        (char*)blk->data);
+            break;
+
+        /*--------------------------+
+        |  read trace               |
+        +--------------------------*/
+        case MMODPRG_BLK_TRC:
+            error = TrcRead( h, blk );
+            break;
+
+        /*--------------------------+
+        |  periodic job status      |
+        +--------------------------*/
+        case MMODPRG_BLK_JOB_STAT:
+            error = JobStat( h, blk );
+            break;
+
         /*--------------------------+
         |  (unknown)                |
         +--------------------------*/
@@ -609,6 +1064,23 @@ static int32 MMODPRG_GetStat(
             error = ERR_LL_UNK_CODE;
     }
 
+	ctx->stat.getStats++;
+	if (error)
+		ctx->stat.errors++;
+	else if (code >= M_DEV_BLK_OF && code < M_DEV_BLK_OF + 0x100)
+		ctx->stat.bytesOut += blk->size;
+
+	/* single accesses are traced above, failed calls and trace state
+	   are not traced */
+	if (h->trcOn && !error && code != MMODPRG_BLK_D8 && code != MMODPRG_BLK_D16 &&
+		code != MMODPRG_BLK_D32 && code != MMODPRG_BLK_TRC &&
+		code != MMODPRG_TRC_COUNT && code != MMODPRG_TRC_RES) {
+		if (code >= M_DEV_BLK_OF && code < M_DEV_BLK_OF + 0x100)
+			TrcAdd(h, ch, MMODPRG_TRC_OP_GET, code, 0, 0, blk->size);
+		else if (code >= M_DEV_OF && code < M_DEV_OF + 0x100)
+			TrcAdd(h, ch, MMODPRG_TRC_OP_GET, code, 0, 0, *valueP);
+	}
+
 	return(error);
 }
 
@@ -616,6 +1088,16 @@ static int32 MMODPRG_GetStat(
  *
  *  Description:  Read a data block from the device
  *
+ *                Drains the sampler ring buffer: as many complete samples
+ *                (MMODPRG_SMP_REC followed by the values) as fit into the
+ *                buffer are copied, oldest first. The function does not
+ *                wait for samples; 0 bytes are returned if none are
+ *                buffered.
+ *
+ *                ERR_LL_ILL_FUNC is returned if no sampling plan has been
+ *                loaded, ERR_LL_USERBUF if the buffer can't hold one
+ *                sample.
+ *
  *---------------------------------------------------------------------------
  *  Input......:  llHdl        low-level handle
  *                ch           current channel
@@ -633,7 +1115,27 @@ static int32 MMODPRG_BlockRead(
      int32     *nbrRdBytesP
 )
 {
-	return ERR_LL_ILL_FUNC;
+	MMODPRG_HANDLE *h = (MMODPRG_HANDLE *)llHdl;
+	MMODPRG_CTX *ctx = &h->ctx[ch];
+	int32 error = ERR_SUCCESS;
+
+	*nbrRdBytesP = 0;
+
+	ctx->stat.blkReads++;
+
+	if (h->smpBuf == NULL)
+		error = ERR_LL_ILL_FUNC;
+	else if (size < (int32)h->smpRecSize)
+		error = ERR_LL_USERBUF;
+	else {
+		*nbrRdBytesP = SmpDrain(h, (u_int8*)buf, size);
+		ctx->stat.bytesOut += *nbrRdBytesP;
+	}
+
+	if (error)
+		ctx->stat.errors++;
+
+	return(error);
 }
 
 /****************************** MMODPRG_BlockWrite *******************************
@@ -840,9 +1342,33 @@ static int32 Cleanup(
    int32        retCode		/* nodoc */
 )
 {
+	int32 ch, n;
+
     /*------------------------------+
     |  close handles                |
     +------------------------------*/
+	/* stop sampler, free ring buffer */
+	SmpStop(h);
+	if (h->smpBuf)
+		OSS_MemFree(h->osHdl, (int8*)h->smpBuf, h->smpBufAlloc);
+
+	/* stop periodic jobs */
+	for (n=0; n<MMODPRG_JOB_MAX; n++)
+		JobStop(h, &h->job[n]);
+
+	/* free trace ring */
+	if (h->trcBuf)
+		OSS_MemFree(h->osHdl, (int8*)h->trcBuf, h->trcAlloc);
+
+	/* free copy staging buffers of per-path contexts */
+	for (ch=0; ch<CH_NUMBER; ch++)
+		if (h->ctx[ch].stage)
+			OSS_MemFree(h->osHdl, (int8*)h->ctx[ch].stage,
+						h->ctx[ch].stageAlloc);
+
+	if (h->lock)
+		OSS_SpinLockRemove(h->osHdl, &h->lock);
+
 	/* clean up desc */
 	if (h->descHdl)
 		DESC_Exit(&h->descHdl);
@@ -862,3 +1388,1559 @@ static int32 Cleanup(
 	return(retCode);
 }
 
+/********************************* AccRead **********************************
+ *
+ *  Description: Read a 8/16/32-bit value from the address window
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               width   access width in bytes (1, 2 or 4)
+ *               offs    offset within address window
+ *  Output.....: return  value read
+ *  Globals....: -
+ ****************************************************************************/
+static u_int32 AccRead(
+	MMODPRG_HANDLE *h,
+	u_int32 width,
+	u_int32 offs
+)
+{
+	MACCESS ma = h->ma;
+
+	switch (width) {
+	case 1:
+		return( MREAD_D8( ma, offs ) );
+	case 2:
+		return( MREAD_D16( ma, offs ) );
+	default:
+		return( MREAD_D32( ma, offs ) );
+	}
+}
+
+/********************************* AccWrite *********************************
+ *
+ *  Description: Write a 8/16/32-bit value to the address window
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               width   access width in bytes (1, 2 or 4)
+ *               offs    offset within address window
+ *               val     value to write
+ *  Output.....: -
+ *  Globals....: -
+ ****************************************************************************/
+static void AccWrite(
+	MMODPRG_HANDLE *h,
+	u_int32 width,
+	u_int32 offs,
+	u_int32 val
+)
+{
+	MACCESS ma = h->ma;
+
+	switch (width) {
+	case 1:
+		MWRITE_D8( ma, offs, val );
+		break;
+	case 2:
+		MWRITE_D16( ma, offs, val );
+		break;
+	default:
+		MWRITE_D32( ma, offs, val );
+	}
+}
+
+/******************************** CheckRange ********************************
+ *
+ *  Description: Check that count accesses of width bytes starting at offs
+ *               are aligned and lie completely within the address window
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               offs    offset within address window
+ *               width   access width in bytes (1, 2 or 4)
+ *               count   number of consecutive accesses
+ *  Output.....: return  success (0) or ERR_LL_ILL_PARAM
+ *  Globals....: -
+ ****************************************************************************/
+static int32 CheckRange(
+	MMODPRG_HANDLE *h,
+	u_int32 offs,
+	u_int32 width,
+	u_int32 count
+)
+{
+	if (width != 1 && width != 2 && width != 4)
+		return(ERR_LL_ILL_PARAM);
+
+	if (offs & (width-1))
+		return(ERR_LL_ILL_PARAM);
+
+	/* written this way to avoid overflows */
+	if (offs > h->winSize || count > (h->winSize - offs) / width)
+		return(ERR_LL_ILL_PARAM);
+
+	return(ERR_SUCCESS);
+}
+
+/********************************* SeqRun ***********************************
+ *
+ *  Description: Validate and execute a micro-sequence program
+ *
+ *               The block contains a MMODPRG_SEQ_HDR followed by the
+ *               instructions and the result slots. The whole program is
+ *               checked before the first instruction is executed, so an
+ *               invalid program never touches the hardware.
+ *
+ *               A POLL timeout or exceeding MMODPRG_SEQ_MAX_STEPS stops
+ *               the program. The reason is stored in the status field.
+ *
+ *               The device is locked while the program runs, so the total
+ *               time spent in DELAY and POLL (1us per re-read) is limited
+ *               to MMODPRG_SEQ_MAX_WAIT, even if the program loops over
+ *               them. A DELAY or POLL that would exceed it stops the
+ *               program with MMODPRG_SEQ_ST_WAIT.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               blk     block containing the program
+ *  Output.....: return  success (0) or error code
+ *                       ERR_OSS_TIMEOUT if program did not complete
+ *  Globals....: -
+ ****************************************************************************/
+static int32 SeqRun(
+	MMODPRG_HANDLE *h,
+	M_SG_BLOCK *blk
+)
+{
+	MMODPRG_SEQ_HDR *hdr = (MMODPRG_SEQ_HDR*)blk->data;
+	MMODPRG_SEQ_OP *ops, *op;
+	u_int32 *res;
+	u_int32 n, pc, acc = 0, wait = 0;
+	int32 error;
+
+	/*--- check block size ---*/
+	if (blk->size < (int32)sizeof(MMODPRG_SEQ_HDR))
+		return(ERR_LL_USERBUF);
+
+	if (hdr->nOps > MMODPRG_SEQ_MAX_OPS || hdr->nResults > MMODPRG_SEQ_MAX_OPS)
+		return(ERR_LL_ILL_PARAM);
+
+	if ((u_int32)blk->size < MMODPRG_SEQ_SIZE(hdr->nOps, hdr->nResults))
+		return(ERR_LL_USERBUF);
+
+	ops = (MMODPRG_SEQ_OP*)(hdr + 1);
+	res = (u_int32*)(ops + hdr->nOps);
+
+	/*--- validate program ---*/
+	for (n=0; n<hdr->nOps; n++) {
+		op = &ops[n];
+
+		switch (op->op) {
+		case MMODPRG_SEQ_END:
+			break;
+		case MMODPRG_SEQ_READ:
+			if (op->arg != MMODPRG_SEQ_NORES && op->arg >= hdr->nResults)
+				return(ERR_LL_ILL_PARAM);
+			/* fall through */
+		case MMODPRG_SEQ_WRITE:
+		case MMODPRG_SEQ_RMW:
+		case MMODPRG_SEQ_POLL:
+			if ((error = CheckRange(h, op->offset, op->width, 1)))
+				return(error);
+			break;
+		case MMODPRG_SEQ_DELAY:
+			if (op->value > MMODPRG_SEQ_MAX_DELAY)
+				return(ERR_LL_ILL_PARAM);
+			break;
+		case MMODPRG_SEQ_BEQ:
+		case MMODPRG_SEQ_BNE:
+			if (op->arg >= hdr->nOps)
+				return(ERR_LL_ILL_PARAM);
+			break;
+		default:
+			return(ERR_LL_ILL_PARAM);
+		}
+	}
+
+	DBGWRT_2((DBH, " SeqRun: %d ops, %d results\n",
+			  hdr->nOps, hdr->nResults));
+
+	/*--- execute ---*/
+	hdr->status = MMODPRG_SEQ_ST_OK;
+	hdr->steps  = 0;
+	hdr->failOp = 0;
+	error = ERR_SUCCESS;
+
+	for (pc=0; pc<hdr->nOps && !error; hdr->steps++) {
+		if (hdr->steps >= MMODPRG_SEQ_MAX_STEPS) {
+			hdr->status = MMODPRG_SEQ_ST_STEPS;
+			hdr->failOp = pc;
+			error = ERR_OSS_TIMEOUT;
+			break;
+		}
+
+		op = &ops[pc++];
+
+		switch (op->op) {
+		case MMODPRG_SEQ_END:
+			pc = hdr->nOps;
+			break;
+		case MMODPRG_SEQ_WRITE:
+			AccWrite(h, op->width, op->offset, op->value);
+			break;
+		case MMODPRG_SEQ_READ:
+			acc = AccRead(h, op->width, op->offset);
+			if (op->arg != MMODPRG_SEQ_NORES)
+				res[op->arg] = acc;
+			break;
+		case MMODPRG_SEQ_RMW:
+			/* no job write between read and write back */
+			OSS_SpinLockAcquire(h->osHdl, h->lock);
+			acc = (AccRead(h, op->width, op->offset) & ~op->mask) |
+				(op->value & op->mask);
+			AccWrite(h, op->width, op->offset, acc);
+			OSS_SpinLockRelease(h->osHdl, h->lock);
+			break;
+		case MMODPRG_SEQ_POLL:
+			for (n=0; ; n++) {
+				acc = AccRead(h, op->width, op->offset);
+				if ((acc & op->mask) == op->value || n >= op->arg)
+					break;
+				if (wait >= MMODPRG_SEQ_MAX_WAIT)
+					break;
+				OSS_MikroDelay(h->osHdl, 1);
+				wait++;
+			}
+			if ((acc & op->mask) != op->value && n < op->arg) {
+				DBGWRT_ERR((DBH, "*** SeqRun: wait budget exceeded at op %d\n",
+							pc-1));
+				hdr->status = MMODPRG_SEQ_ST_WAIT;
+				hdr->failOp = pc-1;
+				error = ERR_OSS_TIMEOUT;
+			}
+			else if ((acc & op->mask) != op->value) {
+				DBGWRT_ERR((DBH, "*** SeqRun: POLL timeout at op %d\n",
+							pc-1));
+				hdr->status = MMODPRG_SEQ_ST_TIMEOUT;
+				hdr->failOp = pc-1;
+				error = ERR_OSS_TIMEOUT;
+			}
+			break;
+		case MMODPRG_SEQ_DELAY:
+			if (wait + op->value > MMODPRG_SEQ_MAX_WAIT) {
+				DBGWRT_ERR((DBH, "*** SeqRun: wait budget exceeded at op %d\n",
+							pc-1));
+				hdr->status = MMODPRG_SEQ_ST_WAIT;
+				hdr->failOp = pc-1;
+				error = ERR_OSS_TIMEOUT;
+				break;
+			}
+			wait += op->value;
+			if (op->value >= 1000)
+				OSS_Delay(h->osHdl, op->value / 1000);
+			if (op->value % 1000)
+				OSS_MikroDelay(h->osHdl, op->value % 1000);
+			break;
+		case MMODPRG_SEQ_BEQ:
+			if ((acc & op->mask) == op->value)
+				pc = op->arg;
+			break;
+		case MMODPRG_SEQ_BNE:
+			if ((acc & op->mask) != op->value)
+				pc = op->arg;
+			break;
+		}
+	}
+
+	hdr->acc = acc;
+
+	return(error);
+}
+
+/********************************** Burst ***********************************
+ *
+ *  Description: Read or write consecutive elements of the address window
+ *
+ *               The block contains a MMODPRG_BURST_HDR followed by the
+ *               data. The range is checked before the first access.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               blk     block containing header and data
+ *               write   TRUE: write data to window, FALSE: read
+ *  Output.....: return  success (0) or error code
+ *  Globals....: -
+ ****************************************************************************/
+static int32 Burst(
+	MMODPRG_HANDLE *h,
+	M_SG_BLOCK *blk,
+	int write
+)
+{
+	MMODPRG_BURST_HDR *hdr = (MMODPRG_BURST_HDR*)blk->data;
+	MACCESS ma = h->ma;
+	u_int32 n, offs;
+	int32 error;
+
+	if (blk->size < (int32)sizeof(MMODPRG_BURST_HDR))
+		return(ERR_LL_USERBUF);
+
+	if ((error = CheckRange(h, hdr->offset, hdr->width, hdr->count)))
+		return(error);
+
+	if ((u_int32)blk->size < MMODPRG_BURST_SIZE(hdr->count, hdr->width))
+		return(ERR_LL_USERBUF);
+
+	DBGWRT_2((DBH, " Burst: %s offs=0x%x width=%d count=%d\n",
+			  write ? "write" : "read", hdr->offset, hdr->width, hdr->count));
+
+	offs = hdr->offset;
+
+	switch (hdr->width) {
+	case 1:
+	{
+		u_int8 *p = (u_int8*)(hdr + 1);
+
+		if (write)
+			for (n=0; n<hdr->count; n++, offs++)
+				MWRITE_D8(ma, offs, *p++);
+		else
+			for (n=0; n<hdr->count; n++, offs++)
+				*p++ = MREAD_D8(ma, offs);
+		break;
+	}
+	case 2:
+	{
+		u_int16 *p = (u_int16*)(hdr + 1);
+
+		if (write)
+			for (n=0; n<hdr->count; n++, offs+=2)
+				MWRITE_D16(ma, offs, *p++);
+		else
+			for (n=0; n<hdr->count; n++, offs+=2)
+				*p++ = MREAD_D16(ma, offs);
+		break;
+	}
+	default:
+	{
+		u_int32 *p = (u_int32*)(hdr + 1);
+
+		if (write)
+			for (n=0; n<hdr->count; n++, offs+=4)
+				MWRITE_D32(ma, offs, *p++);
+		else
+			for (n=0; n<hdr->count; n++, offs+=4)
+				*p++ = MREAD_D32(ma, offs);
+	}
+	}
+
+	return(ERR_SUCCESS);
+}
+
+/*********************************** Fifo ***********************************
+ *
+ *  Description: Read or write elements at one fixed offset (FIFO port)
+ *
+ *               The block contains a MMODPRG_FIFO_HDR followed by the
+ *               data. If a level register is given, it is read once and
+ *               limits the number of elements. The number of transferred
+ *               elements is stored in the header.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               blk     block containing header and data
+ *               write   TRUE: write data to FIFO, FALSE: read
+ *  Output.....: return  success (0) or error code
+ *  Globals....: -
+ ****************************************************************************/
+static int32 Fifo(
+	MMODPRG_HANDLE *h,
+	M_SG_BLOCK *blk,
+	int write
+)
+{
+	MMODPRG_FIFO_HDR *hdr = (MMODPRG_FIFO_HDR*)blk->data;
+	MACCESS ma = h->ma;
+	u_int32 n, count, level, offs;
+	int32 error;
+
+	if (blk->size < (int32)sizeof(MMODPRG_FIFO_HDR))
+		return(ERR_LL_USERBUF);
+
+	if ((error = CheckRange(h, hdr->offset, hdr->width, 1)))
+		return(error);
+
+	if (hdr->levelWidth &&
+		(error = CheckRange(h, hdr->levelOffset, hdr->levelWidth, 1)))
+		return(error);
+
+	if (hdr->count > (u_int32)blk->size / hdr->width ||
+		(u_int32)blk->size < MMODPRG_FIFO_SIZE(hdr->count, hdr->width))
+		return(ERR_LL_USERBUF);
+
+	count = hdr->count;
+
+	/*--- bound by FIFO level ---*/
+	if (hdr->levelWidth) {
+		level = AccRead(h, hdr->levelWidth, hdr->levelOffset);
+		if (hdr->levelMask)
+			level &= hdr->levelMask;
+		level >>= hdr->levelShift & 31;
+
+		if (count > level)
+			count = level;
+	}
+
+	DBGWRT_2((DBH, " Fifo: %s offs=0x%x width=%d count=%d/%d\n",
+			  write ? "write" : "read", hdr->offset, hdr->width, count,
+			  hdr->count));
+
+	offs = hdr->offset;
+
+	switch (hdr->width) {
+	case 1:
+	{
+		u_int8 *p = (u_int8*)(hdr + 1);
+
+		if (write)
+			for (n=0; n<count; n++)
+				MWRITE_D8(ma, offs, *p++);
+		else
+			for (n=0; n<count; n++)
+				*p++ = MREAD_D8(ma, offs);
+		break;
+	}
+	case 2:
+	{
+		u_int16 *p = (u_int16*)(hdr + 1);
+
+		if (write)
+			for (n=0; n<count; n++)
+				MWRITE_D16(ma, offs, *p++);
+		else
+			for (n=0; n<count; n++)
+				*p++ = MREAD_D16(ma, offs);
+		break;
+	}
+	default:
+	{
+		u_int32 *p = (u_int32*)(hdr + 1);
+
+		if (write)
+			for (n=0; n<count; n++)
+				MWRITE_D32(ma, offs, *p++);
+		else
+			for (n=0; n<count; n++)
+				*p++ = MREAD_D32(ma, offs);
+	}
+	}
+
+	hdr->done = count;
+
+	return(ERR_SUCCESS);
+}
+
+/********************************** Stride **********************************
+ *
+ *  Description: Read or write strided/2D elements of the address window
+ *
+ *               The block contains a MMODPRG_STRIDE_HDR followed by the
+ *               densely packed data. All elements must be aligned and
+ *               within the window; this is checked before the first
+ *               access.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               blk     block containing header and data
+ *               write   TRUE: unpack data to window, FALSE: pack from window
+ *  Output.....: return  success (0) or error code
+ *  Globals....: -
+ ****************************************************************************/
+static int32 Stride(
+	MMODPRG_HANDLE *h,
+	M_SG_BLOCK *blk,
+	int write
+)
+{
+	MMODPRG_STRIDE_HDR *hdr = (MMODPRG_STRIDE_HDR*)blk->data;
+	u_int8 *p;
+	u_int32 r, e, w, rowOffs, offs;
+	u_int64 end;
+	int32 error;
+
+	if (blk->size < (int32)sizeof(MMODPRG_STRIDE_HDR))
+		return(ERR_LL_USERBUF);
+
+	w = hdr->width;
+	if ((error = CheckRange(h, hdr->offset, w, 1)))
+		return(error);
+
+	if (hdr->rows == 0 || hdr->count == 0 ||
+		(hdr->stride & (w-1)) || (hdr->pitch & (w-1)))
+		return(ERR_LL_ILL_PARAM);
+
+	/* last element within window (64 bit to avoid overflows) */
+	end = (u_int64)hdr->offset + (u_int64)(hdr->rows - 1) * hdr->pitch +
+		  (u_int64)(hdr->count - 1) * hdr->stride + w;
+	if (end > h->winSize)
+		return(ERR_LL_ILL_PARAM);
+
+	if ((u_int64)blk->size <
+		sizeof(MMODPRG_STRIDE_HDR) + (u_int64)hdr->rows * hdr->count * w)
+		return(ERR_LL_USERBUF);
+
+	DBGWRT_2((DBH, " Stride: %s offs=0x%x width=%d count=%d stride=%d "
+			  "rows=%d pitch=%d\n", write ? "write" : "read", hdr->offset,
+			  w, hdr->count, hdr->stride, hdr->rows, hdr->pitch));
+
+	p = (u_int8*)(hdr + 1);
+
+	for (r=0, rowOffs=hdr->offset; r<hdr->rows; r++, rowOffs+=hdr->pitch) {
+		for (e=0, offs=rowOffs; e<hdr->count; e++, offs+=hdr->stride, p+=w) {
+			if (write)
+				AccWrite(h, w, offs, w == 1 ? *p :
+						 w == 2 ? *(u_int16*)p : *(u_int32*)p);
+			else if (w == 1)
+				*p = (u_int8)AccRead(h, w, offs);
+			else if (w == 2)
+				*(u_int16*)p = (u_int16)AccRead(h, w, offs);
+			else
+				*(u_int32*)p = AccRead(h, w, offs);
+		}
+	}
+
+	return(ERR_SUCCESS);
+}
+
+/*********************************** Copy ***********************************
+ *
+ *  Description: Copy a range of the address window to another offset
+ *
+ *               Overlapping ranges are copied backwards if the destination
+ *               lies above the source. The access width is 4 if source
+ *               and destination have the same alignment modulo 4, 2 if
+ *               they have the same alignment modulo 2, else 1; unaligned
+ *               head and tail bytes are copied with byte accesses.
+ *
+ *               If the width would be less than 4, the data is staged in
+ *               chunks through the context's staging buffer instead, so
+ *               both sides are accessed with aligned 32-bit accesses. If
+ *               the staging buffer can't be allocated, the copy is done
+ *               directly with the narrower width.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               ctx     context of calling path
+ *               blk     block containing MMODPRG_COPY_PB
+ *  Output.....: return  success (0) or error code
+ *  Globals....: -
+ ****************************************************************************/
+static int32 Copy(
+	MMODPRG_HANDLE *h,
+	MMODPRG_CTX *ctx,
+	M_SG_BLOCK *blk
+)
+{
+	MMODPRG_COPY_PB *pb = (MMODPRG_COPY_PB*)blk->data;
+	u_int32 src, dst, len, w, n;
+	int stage;
+
+	if (blk->size < (int32)sizeof(MMODPRG_COPY_PB))
+		return(ERR_LL_USERBUF);
+
+	src = pb->src;
+	dst = pb->dst;
+	len = pb->len;
+
+	/* written this way to avoid overflows */
+	if (src > h->winSize || len > h->winSize - src ||
+		dst > h->winSize || len > h->winSize - dst)
+		return(ERR_LL_ILL_PARAM);
+
+	if (len == 0 || src == dst)
+		return(ERR_SUCCESS);
+
+	w = !((src ^ dst) & 3) ? 4 : !((src ^ dst) & 1) ? 2 : 1;
+
+	DBGWRT_2((DBH, " Copy: src=0x%x dst=0x%x len=0x%x width=%d\n",
+			  src, dst, len, w));
+
+	/* allocate before taking the lock */
+	stage = w < 4 && len >= COPY_STAGE_MIN && CtxStage(h, ctx) == 0;
+
+	/* no job write between reads and writes of the same words */
+	OSS_SpinLockAcquire(h->osHdl, h->lock);
+
+	if (stage) {
+		/*--- staged, chunks in copy direction ---*/
+		if (dst < src || dst >= src + len) {
+			for (; len; len -= n, src += n, dst += n) {
+				n = len < ctx->stageAlloc ? len : ctx->stageAlloc;
+				WinRead(h, src, n, ctx->stage);
+				WinWrite(h, dst, n, ctx->stage);
+			}
+		}
+		else {
+			for (; len; len -= n) {
+				n = len < ctx->stageAlloc ? len : ctx->stageAlloc;
+				WinRead(h, src + len - n, n, ctx->stage);
+				WinWrite(h, dst + len - n, n, ctx->stage);
+			}
+		}
+	}
+	else if (dst < src || dst >= src + len) {
+		/*--- forward ---*/
+		for (; len && (src & (w-1)); len--)
+			AccWrite(h, 1, dst++, AccRead(h, 1, src++));
+		for (; len >= w; len -= w, src += w, dst += w)
+			AccWrite(h, w, dst, AccRead(h, w, src));
+		for (; len; len--)
+			AccWrite(h, 1, dst++, AccRead(h, 1, src++));
+	}
+	else {
+		/*--- backward, src/dst point behind the ranges ---*/
+		src += len;
+		dst += len;
+		for (; len && (src & (w-1)); len--)
+			AccWrite(h, 1, --dst, AccRead(h, 1, --src));
+		for (; len >= w; len -= w) {
+			src -= w;
+			dst -= w;
+			AccWrite(h, w, dst, AccRead(h, w, src));
+		}
+		for (; len; len--)
+			AccWrite(h, 1, --dst, AccRead(h, 1, --src));
+	}
+
+	OSS_SpinLockRelease(h->osHdl, h->lock);
+
+	return(ERR_SUCCESS);
+}
+
+/********************************** Search **********************************
+ *
+ *  Description: Search a value in a range of the address window
+ *
+ *               The block contains a MMODPRG_SEARCH_HDR followed by the
+ *               hit slots. The search stops after maxHits matches. The
+ *               compare loop is specialized per width so each element
+ *               costs one bus access and one compare.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               blk     block containing header and hit slots
+ *  Output.....: return  success (0) or error code
+ *  Globals....: -
+ ****************************************************************************/
+static int32 Search(
+	MMODPRG_HANDLE *h,
+	M_SG_BLOCK *blk
+)
+{
+	MMODPRG_SEARCH_HDR *hdr = (MMODPRG_SEARCH_HDR*)blk->data;
+	u_int32 *hit = (u_int32*)(hdr + 1);
+	MACCESS ma = h->ma;
+	u_int32 w, stride, mask, val, offs, n, k = 0;
+	int32 error;
+
+	if (blk->size < (int32)sizeof(MMODPRG_SEARCH_HDR))
+		return(ERR_LL_USERBUF);
+
+	w      = hdr->width;
+	stride = hdr->stride ? hdr->stride : w;
+
+	if ((error = CheckRange(h, hdr->offset, w, 0)) ||
+		(error = CheckRange(h, hdr->offset, 1, hdr->len)))
+		return(error);
+
+	if (stride & (w-1))
+		return(ERR_LL_ILL_PARAM);
+
+	if ((u_int32)blk->size < MMODPRG_SEARCH_SIZE(hdr->maxHits) ||
+		hdr->maxHits > (u_int32)blk->size / 4)
+		return(ERR_LL_USERBUF);
+
+	/* number of elements completely within the range */
+	n    = hdr->len < w ? 0 : (hdr->len - w) / stride + 1;
+	mask = hdr->mask ? hdr->mask : 0xffffffff;
+	val  = hdr->value & mask;
+	offs = hdr->offset;
+
+	DBGWRT_2((DBH, " Search: offs=0x%x len=0x%x width=%d stride=%d "
+			  "val=0x%x mask=0x%x\n", offs, hdr->len, w, stride,
+			  hdr->value, mask));
+
+	switch (w) {
+	case 1:
+		for (; n && k < hdr->maxHits; n--, offs += stride)
+			if ((MREAD_D8(ma, offs) & mask) == val)
+				hit[k++] = offs;
+		break;
+	case 2:
+		for (; n && k < hdr->maxHits; n--, offs += stride)
+			if ((MREAD_D16(ma, offs) & mask) == val)
+				hit[k++] = offs;
+		break;
+	default:
+		for (; n && k < hdr->maxHits; n--, offs += stride)
+			if ((MREAD_D32(ma, offs) & mask) == val)
+				hit[k++] = offs;
+	}
+
+	hdr->nHits = k;
+	return(ERR_SUCCESS);
+}
+
+/*********************************** Snap ***********************************
+ *
+ *  Description: Read a block consistently using a sequence register
+ *
+ *               The block contains a MMODPRG_SNAP_HDR followed by the
+ *               data. Sequence register and block are re-read until the
+ *               sequence value did not change during the block read
+ *               (seqlock reader). Retries are delayed by 1us, doubled up
+ *               to SNAP_BACKOFF_MAX, to give the writer time to finish.
+ *               The number of retries and the sequence value are stored
+ *               in the header.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               blk     block containing header and data
+ *  Output.....: return  success (0) or error code
+ *                       ERR_LL_DEV_BUSY if retry limit exceeded
+ *  Globals....: -
+ ****************************************************************************/
+static int32 Snap(
+	MMODPRG_HANDLE *h,
+	M_SG_BLOCK *blk
+)
+{
+	MMODPRG_SNAP_HDR *hdr = (MMODPRG_SNAP_HDR*)blk->data;
+	u_int8 *p;
+	u_int32 w, n, offs, seq, seq2, retry, maxRetry, backoff = 1;
+	int32 error;
+
+	if (blk->size < (int32)sizeof(MMODPRG_SNAP_HDR))
+		return(ERR_LL_USERBUF);
+
+	w = hdr->width;
+	if ((error = CheckRange(h, hdr->seqOffset, hdr->seqWidth, 1)) ||
+		(error = CheckRange(h, hdr->offset, w, hdr->count)))
+		return(error);
+
+	if ((u_int32)blk->size < MMODPRG_SNAP_SIZE(hdr->count, w))
+		return(ERR_LL_USERBUF);
+
+	maxRetry = hdr->maxRetry;
+	if (maxRetry == 0 || maxRetry > MMODPRG_SNAP_MAX_RETRY)
+		maxRetry = MMODPRG_SNAP_MAX_RETRY;
+
+	for (retry=0; retry <= maxRetry; retry++) {
+		if (retry) {
+			OSS_MikroDelay(h->osHdl, backoff);
+			if (backoff < SNAP_BACKOFF_MAX)
+				backoff <<= 1;
+		}
+
+		seq = AccRead(h, hdr->seqWidth, hdr->seqOffset);
+		if ((hdr->flags & MMODPRG_SNAP_ODD_BUSY) && (seq & 1))
+			continue;					/* update running */
+
+		p = (u_int8*)(hdr + 1);
+		for (n=0, offs=hdr->offset; n<hdr->count; n++, offs+=w, p+=w) {
+			if (w == 1)
+				*p = (u_int8)AccRead(h, w, offs);
+			else if (w == 2)
+				*(u_int16*)p = (u_int16)AccRead(h, w, offs);
+			else
+				*(u_int32*)p = AccRead(h, w, offs);
+		}
+
+		seq2 = AccRead(h, hdr->seqWidth, hdr->seqOffset);
+		if (seq2 == seq)
+			break;
+	}
+
+	hdr->retries = retry > maxRetry ? maxRetry : retry;
+	hdr->seq     = seq;
+
+	DBGWRT_2((DBH, " Snap: offs=0x%x width=%d count=%d seq=0x%x retries=%d\n",
+			  hdr->offset, w, hdr->count, seq, hdr->retries));
+
+	return(retry > maxRetry ? ERR_LL_DEV_BUSY : ERR_SUCCESS);
+}
+
+/********************************* WinRead **********************************
+ *
+ *  Description: Read a byte range of the address window into a buffer
+ *
+ *               Aligned 32-bit accesses are used for the inner part, byte
+ *               accesses for the unaligned head and tail. The buffer needs
+ *               no alignment.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               offs    start offset
+ *               len     number of bytes
+ *  Output.....: buf     data
+ *  Globals....: -
+ ****************************************************************************/
+static void WinRead(
+	MMODPRG_HANDLE *h,
+	u_int32 offs,
+	u_int32 len,
+	u_int8 *buf
+)
+{
+	MACCESS ma = h->ma;
+	union { u_int32 l; u_int8 b[4]; } u;
+
+	for (; len && (offs & 3); len--)
+		*buf++ = MREAD_D8(ma, offs++);
+
+	for (; len >= 4; len -= 4, offs += 4, buf += 4) {
+		u.l = MREAD_D32(ma, offs);
+		buf[0] = u.b[0];
+		buf[1] = u.b[1];
+		buf[2] = u.b[2];
+		buf[3] = u.b[3];
+	}
+
+	for (; len; len--)
+		*buf++ = MREAD_D8(ma, offs++);
+}
+
+/********************************* WinWrite *********************************
+ *
+ *  Description: Write a buffer to a byte range of the address window
+ *
+ *               Counterpart of WinRead().
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               offs    start offset
+ *               len     number of bytes
+ *               buf     data
+ *  Output.....: -
+ *  Globals....: -
+ ****************************************************************************/
+static void WinWrite(
+	MMODPRG_HANDLE *h,
+	u_int32 offs,
+	u_int32 len,
+	const u_int8 *buf
+)
+{
+	MACCESS ma = h->ma;
+	union { u_int32 l; u_int8 b[4]; } u;
+
+	for (; len && (offs & 3); len--)
+		MWRITE_D8(ma, offs++, *buf++);
+
+	for (; len >= 4; len -= 4, offs += 4, buf += 4) {
+		u.b[0] = buf[0];
+		u.b[1] = buf[1];
+		u.b[2] = buf[2];
+		u.b[3] = buf[3];
+		MWRITE_D32(ma, offs, u.l);
+	}
+
+	for (; len; len--)
+		MWRITE_D8(ma, offs++, *buf++);
+}
+
+/******************************** SramAlias *********************************
+ *
+ *  Description: Check whether offset offs is no usable SRAM, i.e. it
+ *               aliases offset 0 or does not hold a written value
+ *
+ *               The original contents of both words are restored.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               offs    offset to check (> 0, 32-bit aligned)
+ *  Output.....: return  TRUE if offs is not usable
+ *  Globals....: -
+ ****************************************************************************/
+static int SramAlias(
+	MMODPRG_HANDLE *h,
+	u_int32 offs
+)
+{
+	MACCESS ma = h->ma;
+	u_int32 save0, saveN, val0, valN;
+
+	save0 = MREAD_D32( ma, 0 );
+	saveN = MREAD_D32( ma, offs );
+
+	MWRITE_D32( ma, 0, 0x5aa5c33c );
+	MWRITE_D32( ma, offs, 0xa55a3cc3 );
+	val0 = MREAD_D32( ma, 0 );
+	valN = MREAD_D32( ma, offs );
+
+	/* restore in reverse order, so an alias ends up with save0 */
+	MWRITE_D32( ma, offs, saveN );
+	MWRITE_D32( ma, 0, save0 );
+
+	return( val0 != 0x5aa5c33c || valN != 0xa55a3cc3 );
+}
+
+/********************************* SramSize *********************************
+ *
+ *  Description: Probe the usable SRAM size within the address window
+ *
+ *               An SRAM of size S decodes only the lower address lines,
+ *               so offset S (and every larger power of two) aliases
+ *               offset 0. A binary search over the power-of-two
+ *               boundaries below the window size finds the smallest
+ *               aliasing boundary with marker words. The contents of all
+ *               probed words are restored.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *  Output.....: return  usable size [bytes]
+ *  Globals....: -
+ ****************************************************************************/
+static u_int32 SramSize(
+	MMODPRG_HANDLE *h
+)
+{
+	u_int32 lo, hi, mid;
+
+	/* boundaries 2^lo..2^(hi-1) lie within the window */
+	for (hi=2; hi<32 && (1UL<<hi) < h->winSize; hi++)
+		;
+	lo = 2;
+
+	/* find smallest boundary that is not usable */
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (SramAlias(h, 1UL<<mid))
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	DBGWRT_2((DBH, " SramSize: window 0x%x, boundary 2^%d\n",
+			  h->winSize, lo));
+
+	/* no alias below window: whole window is usable */
+	if ((1UL<<lo) >= h->winSize)
+		return(h->winSize & ~3);
+
+	return(1UL<<lo);
+}
+
+/********************************* SmpStart *********************************
+ *
+ *  Description: Load a sampling plan and start the sampling timer
+ *
+ *               A running sampler is stopped and its ring buffer is
+ *               replaced. All entries are checked before anything is
+ *               changed.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               blk     block containing MMODPRG_SMP_PLAN and entries
+ *  Output.....: return  success (0) or error code
+ *  Globals....: -
+ ****************************************************************************/
+static int32 SmpStart(
+	MMODPRG_HANDLE *h,
+	M_SG_BLOCK *blk
+)
+{
+	MMODPRG_SMP_PLAN *plan = (MMODPRG_SMP_PLAN*)blk->data;
+	MMODPRG_SMP_ENTRY *ent = (MMODPRG_SMP_ENTRY*)(plan + 1);
+	u_int32 n, recSize;
+	int32 error;
+
+	if (blk->size < (int32)sizeof(MMODPRG_SMP_PLAN))
+		return(ERR_LL_USERBUF);
+
+	if (plan->nEntries == 0 || plan->nEntries > MMODPRG_SMP_MAX_ENTRIES ||
+		plan->periodMs == 0 || plan->nSamples == 0)
+		return(ERR_LL_ILL_PARAM);
+
+	if ((u_int32)blk->size < MMODPRG_SMP_PLAN_SIZE(plan->nEntries))
+		return(ERR_LL_USERBUF);
+
+	for (n=0; n<plan->nEntries; n++)
+		if ((error = CheckRange(h, ent[n].offset, ent[n].width, 1)))
+			return(error);
+
+	recSize = MMODPRG_SMP_REC_SIZE(plan->nEntries);
+	if (plan->nSamples > MMODPRG_SMP_MAX_BUF / recSize)
+		return(ERR_LL_ILL_PARAM);
+
+	DBGWRT_2((DBH, " SmpStart: %d entries, period %dms, %d samples\n",
+			  plan->nEntries, plan->periodMs, plan->nSamples));
+
+	/*--- replace previous plan and buffer (timer is quiescent) ---*/
+	SmpStop(h);
+
+	if (h->smpBuf) {
+		OSS_MemFree(h->osHdl, (int8*)h->smpBuf, h->smpBufAlloc);
+		h->smpBuf = NULL;
+	}
+
+	if ((h->smpBuf = (u_int8*)OSS_MemGet(h->osHdl, plan->nSamples * recSize,
+										 &h->smpBufAlloc)) == NULL)
+		return(ERR_OSS_MEM_ALLOC);
+
+	for (n=0; n<plan->nEntries; n++)
+		h->smpEnt[n] = ent[n];
+
+	h->smpNEnt    = plan->nEntries;
+	h->smpRecSize = recSize;
+	h->smpNRec    = plan->nSamples;
+	h->smpIn      = 0;
+	h->smpOut     = 0;
+	h->smpWr      = 0;
+	h->smpRd      = 0;
+	h->smpSeq     = 0;
+	h->smpOverrun = 0;
+	h->smpRun     = TRUE;
+
+	/*--- start cyclic timer ---*/
+	if ((error = OSS_AlarmCreate(h->osHdl, SmpAlarm, (void*)h,
+								 &h->smpAlarm))) {
+		h->smpAlarm = NULL;
+		h->smpRun   = FALSE;
+		return(error);
+	}
+
+	if ((error = OSS_AlarmSet(h->osHdl, h->smpAlarm, plan->periodMs, 1,
+							  &h->smpRealMs))) {
+		OSS_AlarmRemove(h->osHdl, &h->smpAlarm);
+		h->smpAlarm = NULL;
+		h->smpRun   = FALSE;
+		return(error);
+	}
+
+	return(ERR_SUCCESS);
+}
+
+/********************************** SmpStop *********************************
+ *
+ *  Description: Stop the sampling timer
+ *
+ *               The ring buffer is kept, so buffered samples can still be
+ *               read. smpRun is cleared under the lock first: a timer
+ *               routine still running on another CPU has either finished
+ *               its sample or sees smpRun cleared and doesn't touch the
+ *               buffer, so the buffer may be freed on return.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *  Output.....: -
+ *  Globals....: -
+ ****************************************************************************/
+static void SmpStop(
+	MMODPRG_HANDLE *h
+)
+{
+	if (h->smpAlarm == NULL)
+		return;
+
+	OSS_SpinLockAcquire(h->osHdl, h->lock);
+	h->smpRun = FALSE;
+	OSS_SpinLockRelease(h->osHdl, h->lock);
+
+	OSS_AlarmClear(h->osHdl, h->smpAlarm);
+	OSS_AlarmRemove(h->osHdl, &h->smpAlarm);
+	h->smpAlarm = NULL;
+}
+
+/********************************* SmpAlarm *********************************
+ *
+ *  Description: Sampling timer routine
+ *
+ *               Reads all registers of the plan into the next free ring
+ *               buffer slot. If the buffer is full, the sample is dropped
+ *               and counted as overrun. Runs with h->lock held, so the
+ *               samples are also consistent with register updates of
+ *               driver calls.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: arg     low-level handle
+ *  Output.....: -
+ *  Globals....: -
+ ****************************************************************************/
+static void SmpAlarm(
+	void *arg
+)
+{
+	MMODPRG_HANDLE *h = (MMODPRG_HANDLE*)arg;
+	MMODPRG_SMP_REC *rec;
+	u_int32 *val, n;
+
+	OSS_SpinLockAcquire(h->osHdl, h->lock);
+
+	/* stopped meanwhile, buffer may be gone */
+	if (!h->smpRun)
+		goto UNLOCK;
+
+	h->smpSeq++;
+
+	if (h->smpIn - h->smpOut >= h->smpNRec) {
+		h->smpOverrun++;
+		goto UNLOCK;
+	}
+
+	rec = (MMODPRG_SMP_REC*)(h->smpBuf + h->smpWr * h->smpRecSize);
+	rec->seq  = h->smpSeq - 1;
+	rec->tick = OSS_TickGet(h->osHdl);
+
+	val = (u_int32*)(rec + 1);
+	for (n=0; n<h->smpNEnt; n++)
+		val[n] = AccRead(h, h->smpEnt[n].width, h->smpEnt[n].offset);
+
+	if (++h->smpWr == h->smpNRec)
+		h->smpWr = 0;
+	h->smpIn++;
+
+ UNLOCK:
+	OSS_SpinLockRelease(h->osHdl, h->lock);
+}
+
+/********************************* SmpDrain *********************************
+ *
+ *  Description: Copy buffered samples to a user buffer
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               buf     destination buffer
+ *               size    size of buf [bytes]
+ *  Output.....: return  number of bytes copied
+ *  Globals....: -
+ ****************************************************************************/
+static int32 SmpDrain(
+	MMODPRG_HANDLE *h,
+	u_int8 *buf,
+	int32 size
+)
+{
+	u_int32 n, i;
+
+	OSS_SpinLockAcquire(h->osHdl, h->lock);
+
+	n = h->smpIn - h->smpOut;
+	if (n > (u_int32)size / h->smpRecSize)
+		n = (u_int32)size / h->smpRecSize;
+
+	for (i=0; i<n; i++, buf += h->smpRecSize) {
+		OSS_MemCopy(h->osHdl, h->smpRecSize,
+					(char*)(h->smpBuf + h->smpRd * h->smpRecSize),
+					(char*)buf);
+		if (++h->smpRd == h->smpNRec)
+			h->smpRd = 0;
+	}
+	h->smpOut += n;
+
+	OSS_SpinLockRelease(h->osHdl, h->lock);
+
+	DBGWRT_3((DBH, " SmpDrain: %d samples\n", n));
+
+	return(n * h->smpRecSize);
+}
+
+/********************************* TrcStart *********************************
+ *
+ *  Description: Discard the trace and start recording into a new ring
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               nEnt    ring capacity [records] (1..MMODPRG_TRC_MAX_ENT)
+ *  Output.....: return  success (0) or error code
+ *  Globals....: -
+ ****************************************************************************/
+static int32 TrcStart(
+	MMODPRG_HANDLE *h,
+	u_int32 nEnt
+)
+{
+	u_int32 gotsize;
+
+	h->trcOn = FALSE;
+
+	if (nEnt == 0 || nEnt > MMODPRG_TRC_MAX_ENT)
+		return(ERR_LL_ILL_PARAM);
+
+	if (h->trcBuf && h->trcNEnt != nEnt) {
+		OSS_MemFree(h->osHdl, (int8*)h->trcBuf, h->trcAlloc);
+		h->trcBuf = NULL;
+	}
+
+	if (h->trcBuf == NULL) {
+		if ((h->trcBuf = (MMODPRG_TRC_ENT*)OSS_MemGet(
+				 h->osHdl, nEnt * sizeof(MMODPRG_TRC_ENT), &gotsize)) == NULL)
+			return(ERR_OSS_MEM_ALLOC);
+		h->trcAlloc = gotsize;
+		h->trcNEnt  = nEnt;
+	}
+
+	h->trcWr   = 0;
+	h->trcRd   = 0;
+	h->trcCnt  = 0;
+	h->trcLost = 0;
+	h->trcRes  = 1000000 / OSS_TickRateGet(h->osHdl);
+	if (h->trcRes == 0)
+		h->trcRes = 1;
+	h->trcOn   = TRUE;
+
+	DBGWRT_2((DBH, " TrcStart: nEnt=%d\n", nEnt));
+
+	return(ERR_SUCCESS);
+}
+
+/********************************** TrcTime *********************************
+ *
+ *  Description: Get a trace timestamp
+ *
+ *               OSS tick scaled to h->trcRes. The value wraps after
+ *               ~71 minutes.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *  Output.....: return  timestamp [us]
+ *  Globals....: -
+ ****************************************************************************/
+static u_int32 TrcTime(
+	MMODPRG_HANDLE *h
+)
+{
+	return(OSS_TickGet(h->osHdl) * h->trcRes);
+}
+
+/********************************** TrcAdd **********************************
+ *
+ *  Description: Append a record to the trace ring
+ *
+ *               Driver calls are serialized (LL_LOCK_CALL), so no further
+ *               locking is needed.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               ch      current channel
+ *               op      MMODPRG_TRC_OP_xxx
+ *               code    status code
+ *               width   access width in bytes, 0=no single access
+ *               offs    offset within address window
+ *               val     value written or read, or block length
+ *  Output.....: -
+ *  Globals....: -
+ ****************************************************************************/
+static void TrcAdd(
+	MMODPRG_HANDLE *h,
+	int32 ch,
+	u_int32 op,
+	u_int32 code,
+	u_int32 width,
+	u_int32 offs,
+	u_int32 val
+)
+{
+	MMODPRG_TRC_ENT *e;
+
+	if (h->trcCnt == h->trcNEnt) {
+		h->trcLost++;
+		return;
+	}
+
+	e = &h->trcBuf[h->trcWr];
+	e->usec     = TrcTime(h);
+	e->code     = code;
+	e->offset   = offs;
+	e->value    = val;
+	e->width    = (u_int8)width;
+	e->op       = (u_int8)op;
+	e->ch       = (u_int8)ch;
+	e->reserved = 0;
+
+	if (++h->trcWr == h->trcNEnt)
+		h->trcWr = 0;
+	h->trcCnt++;
+}
+
+/********************************** TrcRead *********************************
+ *
+ *  Description: Move the oldest trace records to a MMODPRG_BLK_TRC block
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               blk     block containing MMODPRG_TRC_HDR and slots
+ *  Output.....: return  success (0) or error code
+ *  Globals....: -
+ ****************************************************************************/
+static int32 TrcRead(
+	MMODPRG_HANDLE *h,
+	M_SG_BLOCK *blk
+)
+{
+	MMODPRG_TRC_HDR *hdr = (MMODPRG_TRC_HDR*)blk->data;
+	MMODPRG_TRC_ENT *dst = (MMODPRG_TRC_ENT*)(hdr + 1);
+	u_int32 n, k;
+
+	if (blk->size < (int32)sizeof(MMODPRG_TRC_HDR))
+		return(ERR_LL_USERBUF);
+
+	/* slots available in block */
+	n = (blk->size - sizeof(MMODPRG_TRC_HDR)) / sizeof(MMODPRG_TRC_ENT);
+	if (n > hdr->maxEnt)
+		n = hdr->maxEnt;
+	if (n > h->trcCnt)
+		n = h->trcCnt;
+
+	hdr->nEnt = n;
+	hdr->lost = h->trcLost;
+
+	while (n) {
+		/* contiguous part up to ring end */
+		k = h->trcNEnt - h->trcRd;
+		if (k > n)
+			k = n;
+
+		OSS_MemCopy(h->osHdl, k * sizeof(MMODPRG_TRC_ENT),
+					(char*)&h->trcBuf[h->trcRd], (char*)dst);
+
+		dst       += k;
+		n         -= k;
+		h->trcCnt -= k;
+		h->trcRd  += k;
+		if (h->trcRd == h->trcNEnt)
+			h->trcRd = 0;
+	}
+
+	return(ERR_SUCCESS);
+}
+
+/********************************* JobStart *********************************
+ *
+ *  Description: Start a periodic write job
+ *
+ *               A job running in the same slot is stopped first. The job
+ *               definition is checked before anything is changed. Missed
+ *               deadlines are measured in OSS ticks, so periods shorter
+ *               than two ticks are rejected.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               blk     block containing MMODPRG_JOB
+ *  Output.....: return  success (0) or error code
+ *  Globals....: -
+ ****************************************************************************/
+static int32 JobStart(
+	MMODPRG_HANDLE *h,
+	M_SG_BLOCK *blk
+)
+{
+	MMODPRG_JOB *def = (MMODPRG_JOB*)blk->data;
+	JOB_SLOT *job;
+	u_int32 tickRate, minMs;
+	int32 error;
+
+	if (blk->size < (int32)sizeof(MMODPRG_JOB))
+		return(ERR_LL_USERBUF);
+
+	/* deadlines are checked in ticks: at least two ticks per period */
+	tickRate = OSS_TickRateGet(h->osHdl);
+	minMs = (2000 + tickRate - 1) / tickRate;
+
+	if (def->id >= MMODPRG_JOB_MAX || def->periodMs < minMs ||
+		(def->mode == MMODPRG_JOB_SEQ &&
+		 (def->nValues == 0 || def->nValues > MMODPRG_JOB_MAX_VAL)) ||
+		(def->mode != MMODPRG_JOB_SEQ && def->mode != MMODPRG_JOB_XOR))
+		return(ERR_LL_ILL_PARAM);
+
+	if ((error = CheckRange(h, def->offset, def->width, 1)))
+		return(error);
+
+	DBGWRT_2((DBH, " JobStart: id=%d offs=0x%x width=%d period=%dms "
+			  "mode=%d\n", def->id, def->offset, def->width, def->periodMs, def->mode));
+
+	job = &h->job[def->id];
+	JobStop(h, job);
+
+	job->h        = h;
+	job->def      = *def;
+	job->idx      = 0;
+	job->value    = def->values[0];
+	job->runs     = 0;
+	job->missed   = 0;
+	job->tickRate = tickRate;
+	job->run      = TRUE;
+
+	if ((error = OSS_AlarmCreate(h->osHdl, JobAlarm, (void*)job,
+								 &job->alarm))) {
+		job->alarm = NULL;
+		job->run   = FALSE;
+		return(error);
+	}
+
+	if ((error = OSS_AlarmSet(h->osHdl, job->alarm, def->periodMs, 1,
+							  &job->realMs))) {
+		OSS_AlarmRemove(h->osHdl, &job->alarm);
+		job->alarm = NULL;
+		job->run   = FALSE;
+		return(error);
+	}
+
+	return(ERR_SUCCESS);
+}
+
+/********************************** JobStop *********************************
+ *
+ *  Description: Stop a periodic write job
+ *
+ *               The counters are kept for MMODPRG_BLK_JOB_STAT.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               job     job slot
+ *  Output.....: -
+ *  Globals....: -
+ ****************************************************************************/
+static void JobStop(
+	MMODPRG_HANDLE *h,
+	JOB_SLOT *job
+)
+{
+	if (job->alarm == NULL)
+		return;
+
+	OSS_SpinLockAcquire(h->osHdl, h->lock);
+	job->run = FALSE;
+	OSS_SpinLockRelease(h->osHdl, h->lock);
+
+	OSS_AlarmClear(h->osHdl, job->alarm);
+	OSS_AlarmRemove(h->osHdl, &job->alarm);
+	job->alarm = NULL;
+}
+
+/********************************* JobAlarm *********************************
+ *
+ *  Description: Periodic job timer routine
+ *
+ *               Writes the next value. If more than one period passed
+ *               since the previous write (measured in OSS ticks), the
+ *               skipped periods are counted as missed deadlines. Runs with
+ *               h->lock held, so the write can't fall between the read
+ *               and write of a driver call's read-modify-write or copy.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: arg     job slot
+ *  Output.....: -
+ *  Globals....: -
+ ****************************************************************************/
+static void JobAlarm(
+	void *arg
+)
+{
+	JOB_SLOT *job = (JOB_SLOT*)arg;
+	MMODPRG_HANDLE *h = job->h;
+	u_int32 tick, ms;
+
+	OSS_SpinLockAcquire(h->osHdl, h->lock);
+
+	/* stopped meanwhile */
+	if (!job->run)
+		goto UNLOCK;
+
+	tick = OSS_TickGet(h->osHdl);
+
+	if (job->runs && job->realMs) {
+		ms = (tick - job->lastTick) * 1000 / job->tickRate;
+		if (ms >= 2 * job->realMs)
+			job->missed += ms / job->realMs - 1;
+	}
+	job->lastTick = tick;
+
+	AccWrite(h, job->def.width, job->def.offset, job->value);
+	job->lastValue = job->value;
+	job->runs++;
+
+	/* next value */
+	if (job->def.mode == MMODPRG_JOB_XOR)
+		job->value ^= job->def.mask;
+	else {
+		if (++job->idx == job->def.nValues)
+			job->idx = 0;
+		job->value = job->def.values[job->idx];
+	}
+
+ UNLOCK:
+	OSS_SpinLockRelease(h->osHdl, h->lock);
+}
+
+/********************************** JobStat *********************************
+ *
+ *  Description: Get the status of a periodic write job
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               blk     block containing MMODPRG_JOB_STAT (id set)
+ *  Output.....: return  success (0) or error code
+ *  Globals....: -
+ ****************************************************************************/
+static int32 JobStat(
+	MMODPRG_HANDLE *h,
+	M_SG_BLOCK *blk
+)
+{
+	MMODPRG_JOB_STAT *st = (MMODPRG_JOB_STAT*)blk->data;
+	JOB_SLOT *job;
+
+	if (blk->size < (int32)sizeof(MMODPRG_JOB_STAT))
+		return(ERR_LL_USERBUF);
+
+	if (st->id >= MMODPRG_JOB_MAX)
+		return(ERR_LL_ILL_PARAM);
+
+	job = &h->job[st->id];
+	st->running   = job->alarm != NULL;
+	st->realMs    = job->alarm ? job->realMs : 0;
+
+	OSS_SpinLockAcquire(h->osHdl, h->lock);
+	st->runs      = job->runs;
+	st->missed    = job->missed;
+	st->lastValue = job->lastValue;
+	OSS_SpinLockRelease(h->osHdl, h->lock);
+
+	return(ERR_SUCCESS);
+}
+
+/********************************* CtxStage *********************************
+ *
+ *  Description: Allocate the copy staging buffer of a context on first use
+ *
+ *               The buffer is kept until the device is closed, so later
+ *               calls don't allocate memory.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: h       low-level handle
+ *               ctx     context of calling path
+ *  Output.....: return  success (0) or error code
+ *  Globals....: -
+ ****************************************************************************/
+static int32 CtxStage(
+	MMODPRG_HANDLE *h,
+	MMODPRG_CTX *ctx
+)
+{
+	u_int32 gotsize;
+
+	if (ctx->stage)
+		return(ERR_SUCCESS);
+
+	if ((ctx->stage = (u_int8*)OSS_MemGet(
+					h->osHdl, MMODPRG_COPY_STAGE, &gotsize)) == NULL)
+		return(ERR_OSS_MEM_ALLOC);
+
+	ctx->stageAlloc = gotsize;
+
+	DBGWRT_2((DBH, " CtxStage: staging buffer allocated\n"));
+
+	return(ERR_SUCCESS);
+}
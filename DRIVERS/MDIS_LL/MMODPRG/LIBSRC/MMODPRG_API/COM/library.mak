@@ -0,0 +1,44 @@
+#***************************  M a k e f i l e  *******************************
+#
+#         Author: kp
+#
+#    Description: Makefile definitions for the MMODPRG user space API library
+#
+#-----------------------------------------------------------------------------
+#   Copyright 2010-2019, MEN Mikro Elektronik GmbH
+#*****************************************************************************
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+MAK_NAME=mmodprg_api
+
+MAK_INCL=$(MEN_INC_DIR)/mmodprg_drv.h	\
+         $(MEN_INC_DIR)/mmodprg_api.h	\
+         $(MEN_INC_DIR)/men_typs.h	\
+         $(MEN_INC_DIR)/mdis_api.h	\
+         $(MEN_INC_DIR)/mdis_err.h	\
+         $(MEN_INC_DIR)/usr_oss.h	\
+
+MAK_INP1=mmodprg_api$(INP_SUFFIX)
+MAK_INP2=mmodprg_log$(INP_SUFFIX)
+MAK_INP3=mmodprg_kv$(INP_SUFFIX)
+MAK_INP4=mmodprg_txn$(INP_SUFFIX)
+MAK_INP5=mmodprg_part$(INP_SUFFIX)
+MAK_INP6=mmodprg_ecc$(INP_SUFFIX)
+
+MAK_INP=$(MAK_INP1) \
+        $(MAK_INP2) \
+        $(MAK_INP3) \
+        $(MAK_INP4) \
+        $(MAK_INP5) \
+        $(MAK_INP6)
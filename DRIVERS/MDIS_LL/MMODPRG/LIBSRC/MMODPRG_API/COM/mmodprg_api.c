@@ -0,0 +1,1027 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************
+ *
+ *         Name: mmodprg_api.c
+ *      Project: MMODPRG user space API library
+ *
+ *       Author: kp
+ *
+ *  Description: Batched and multi-device register access on top of the
+ *               MMODPRG driver status codes
+ *
+ *               Batches of register writes are converted to micro-sequence
+ *               programs (MMODPRG_BLK_SEQ) so that a whole batch costs one
+ *               driver call per device. Fan-out operations run one worker
+ *               thread per device and wait until all workers are done.
+ *               Burst transfers are split into chunks of
+ *               MMODPRG_API_BURST_CHUNK bytes (MMODPRG_BLK_BURST).
+ *               FIFO port transfers (MMODPRG_BLK_FIFO) are chunked the
+ *               same way, writes read the FIFO level first.
+ *               Strided/2D transfers (MMODPRG_BLK_STRIDE) are split into
+ *               groups of rows, or into groups of elements if a single
+ *               row exceeds a chunk.
+ *               MMODPRG_Copy() moves data within the window without
+ *               passing it through user space (MMODPRG_BLK_COPY).
+ *               MMODPRG_Search() scans a range inside the driver
+ *               (MMODPRG_BLK_SEARCH).
+ *               MMODPRG_SnapRead() reads a block protected by a firmware
+ *               sequence register (MMODPRG_BLK_SNAP).
+ *               MMODPRG_CtxSelect()/MMODPRG_CtxStat() select and query
+ *               the driver's per-path context (channel).
+ *               MMODPRG_SamplerStart() builds the sampling plan block
+ *               (MMODPRG_BLK_SMP_PLAN).
+ *               MMODPRG_JobStart/Stop/Stat() control the driver's periodic
+ *               write jobs (MMODPRG_BLK_JOB_START).
+ *
+ *     Required: MDIS API, usr_oss, pthread
+ *     Switches: -
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2010-2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_api.h>
+#include <MEN/mdis_err.h>
+#include <MEN/usr_oss.h>
+#include <MEN/mmodprg_drv.h>
+#include <MEN/mmodprg_api.h>
+
+/*-----------------------------------------+
+|  TYPEDEFS                                |
++-----------------------------------------*/
+/* list of micro-sequence blocks making up one batch */
+typedef struct {
+    int         nBlk;           /* number of blocks */
+    M_SG_BLOCK  *blk;           /* blocks (data allocated separately) */
+} SEQ_LIST;
+
+/* worker context of a fan-out operation */
+typedef struct {
+    MMODPRG_FANOUT_DEV  *dev;   /* device to work on */
+    const SEQ_LIST      *seq;   /* shared, read only */
+    pthread_t           tid;    /* worker thread */
+    int                 started;/* thread has been created */
+} FANOUT_JOB;
+
+/*-----------------------------------------+
+|  PROTOTYPES                              |
++-----------------------------------------*/
+static int32 SeqListBuild( SEQ_LIST *seq, const MMODPRG_WR *wr, int nWr );
+static void  SeqListFree( SEQ_LIST *seq );
+static int32 SeqListRun( MDIS_PATH path, const SEQ_LIST *seq );
+static void* FanOutWorker( void *arg );
+static int32 BurstXfer( MDIS_PATH path, u_int32 offset, u_int32 width,
+                        u_int32 count, u_int8 *data, int write );
+static int32 FifoXfer( MDIS_PATH path, const MMODPRG_FIFO_HDR *port,
+                       u_int8 *data, u_int32 *doneP, int write );
+static int32 StrideXfer( MDIS_PATH path, const MMODPRG_STRIDE_HDR *desc,
+                         u_int8 *data, int write );
+
+/***************************** MMODPRG_WriteBatch ***************************
+ *
+ *  Description:  Write a batch of registers of one device
+ *
+ *                The writes are executed in the given order. The batch is
+ *                passed to the driver as micro-sequence, i.e. one call per
+ *                MMODPRG_SEQ_MAX_OPS writes.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                wr     register writes
+ *                nWr    number of writes
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_WriteBatch(
+    MDIS_PATH path,
+    const MMODPRG_WR *wr,
+    int nWr
+)
+{
+    SEQ_LIST seq;
+    int32 error;
+
+    if( (error = SeqListBuild( &seq, wr, nWr )) )
+        return( error );
+
+    error = SeqListRun( path, &seq );
+    SeqListFree( &seq );
+
+    return( error );
+}
+
+/**************************** MMODPRG_FanOutWrite ***************************
+ *
+ *  Description:  Write the same batch of registers to several devices
+ *
+ *                Each device is handled by its own worker thread, so
+ *                devices are programmed concurrently. The function returns
+ *                when all workers have completed. The result of each
+ *                device is stored in dev[n].result.
+ *
+ *                If a worker thread cannot be created, the device is
+ *                programmed from the calling thread instead.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  dev    devices (path set by caller)
+ *                nDev   number of devices
+ *                wr     register writes
+ *                nWr    number of writes
+ *  Output.....:  dev    result of each device
+ *                return success (0) or error code of first failed device
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_FanOutWrite(
+    MMODPRG_FANOUT_DEV *dev,
+    int nDev,
+    const MMODPRG_WR *wr,
+    int nWr
+)
+{
+    SEQ_LIST seq;
+    FANOUT_JOB *job;
+    int32 error;
+    int n;
+
+    if( nDev <= 0 )
+        return( ERR_SUCCESS );
+
+    if( (error = SeqListBuild( &seq, wr, nWr )) )
+        return( error );
+
+    if( (job = (FANOUT_JOB*)calloc( nDev, sizeof(FANOUT_JOB) )) == NULL ) {
+        SeqListFree( &seq );
+        return( ERR_OSS_MEM_ALLOC );
+    }
+
+    /*--- start one worker per device ---*/
+    for( n=0; n<nDev; n++ ) {
+        job[n].dev = &dev[n];
+        job[n].seq = &seq;
+
+        if( pthread_create( &job[n].tid, NULL, FanOutWorker, &job[n] ) == 0 )
+            job[n].started = 1;
+        else
+            FanOutWorker( &job[n] );
+    }
+
+    /*--- completion barrier ---*/
+    error = ERR_SUCCESS;
+
+    for( n=0; n<nDev; n++ ) {
+        if( job[n].started )
+            pthread_join( job[n].tid, NULL );
+
+        if( dev[n].result && !error )
+            error = dev[n].result;
+    }
+
+    free( job );
+    SeqListFree( &seq );
+
+    return( error );
+}
+
+/******************************* FanOutWorker *******************************
+ *
+ *  Description:  Worker thread of MMODPRG_FanOutWrite
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  arg    FANOUT_JOB
+ *  Output.....:  return NULL
+ *  Globals....:  ---
+ ****************************************************************************/
+static void* FanOutWorker( void *arg )
+{
+    FANOUT_JOB *job = (FANOUT_JOB*)arg;
+
+    job->dev->result = SeqListRun( job->dev->path, job->seq );
+
+    return( NULL );
+}
+
+/******************************* SeqListBuild *******************************
+ *
+ *  Description:  Convert a batch of writes into micro-sequence blocks
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  seq    list to build
+ *                wr     register writes
+ *                nWr    number of writes
+ *  Output.....:  seq    list of blocks, free with SeqListFree()
+ *                return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 SeqListBuild(
+    SEQ_LIST *seq,
+    const MMODPRG_WR *wr,
+    int nWr
+)
+{
+    MMODPRG_SEQ_HDR *hdr;
+    MMODPRG_SEQ_OP *op;
+    int b, n, nOps;
+
+    seq->nBlk = (nWr + MMODPRG_SEQ_MAX_OPS - 1) / MMODPRG_SEQ_MAX_OPS;
+    seq->blk  = NULL;
+
+    if( nWr < 0 )
+        return( ERR_LL_ILL_PARAM );
+
+    if( seq->nBlk == 0 )
+        return( ERR_SUCCESS );
+
+    if( (seq->blk = (M_SG_BLOCK*)calloc( seq->nBlk, sizeof(M_SG_BLOCK) ))
+        == NULL )
+        return( ERR_OSS_MEM_ALLOC );
+
+    for( b=0; b<seq->nBlk; b++ ) {
+        nOps = nWr - b * MMODPRG_SEQ_MAX_OPS;
+        if( nOps > MMODPRG_SEQ_MAX_OPS )
+            nOps = MMODPRG_SEQ_MAX_OPS;
+
+        seq->blk[b].size = MMODPRG_SEQ_SIZE( nOps, 0 );
+        if( (seq->blk[b].data = calloc( 1, seq->blk[b].size )) == NULL ) {
+            SeqListFree( seq );
+            return( ERR_OSS_MEM_ALLOC );
+        }
+
+        hdr = (MMODPRG_SEQ_HDR*)seq->blk[b].data;
+        hdr->nOps = nOps;
+        op = (MMODPRG_SEQ_OP*)(hdr + 1);
+
+        for( n=0; n<nOps; n++, op++, wr++ ) {
+            op->op     = MMODPRG_SEQ_WRITE;
+            op->width  = (u_int8)wr->width;
+            op->offset = wr->offset;
+            op->value  = wr->value;
+        }
+    }
+
+    return( ERR_SUCCESS );
+}
+
+/******************************** SeqListFree *******************************
+ *
+ *  Description:  Free blocks of a micro-sequence list
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  seq    list
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void SeqListFree( SEQ_LIST *seq )
+{
+    int b;
+
+    if( seq->blk ) {
+        for( b=0; b<seq->nBlk; b++ )
+            free( seq->blk[b].data );
+        free( seq->blk );
+    }
+    seq->blk  = NULL;
+    seq->nBlk = 0;
+}
+
+/******************************** SeqListRun ********************************
+ *
+ *  Description:  Execute all blocks of a micro-sequence list on one device
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                seq    list
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 SeqListRun(
+    MDIS_PATH path,
+    const SEQ_LIST *seq
+)
+{
+    int b;
+
+    for( b=0; b<seq->nBlk; b++ ) {
+        if( M_setstat( path, MMODPRG_BLK_SEQ,
+                       (INT32_OR_64)&seq->blk[b] ) < 0 )
+            return( UOS_ErrnoGet() );
+    }
+
+    return( ERR_SUCCESS );
+}
+
+/***************************** MMODPRG_BurstRead ****************************
+ *
+ *  Description:  Read consecutive elements from the address window
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                offset start offset (aligned to width)
+ *                width  access width in bytes (1, 2 or 4)
+ *                count  number of elements
+ *  Output.....:  data   elements read (u_int8/u_int16/u_int32 array)
+ *                return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_BurstRead(
+    MDIS_PATH path,
+    u_int32 offset,
+    u_int32 width,
+    u_int32 count,
+    void *data
+)
+{
+    return( BurstXfer( path, offset, width, count, (u_int8*)data, 0 ) );
+}
+
+/**************************** MMODPRG_BurstWrite ****************************
+ *
+ *  Description:  Write consecutive elements to the address window
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                offset start offset (aligned to width)
+ *                width  access width in bytes (1, 2 or 4)
+ *                count  number of elements
+ *                data   elements to write (u_int8/u_int16/u_int32 array)
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_BurstWrite(
+    MDIS_PATH path,
+    u_int32 offset,
+    u_int32 width,
+    u_int32 count,
+    const void *data
+)
+{
+    return( BurstXfer( path, offset, width, count, (u_int8*)data, 1 ) );
+}
+
+/********************************* BurstXfer ********************************
+ *
+ *  Description:  Transfer elements in chunks of MMODPRG_API_BURST_CHUNK
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                offset start offset
+ *                width  access width in bytes (1, 2 or 4)
+ *                count  number of elements
+ *                data   data buffer
+ *                write  0=read, 1=write
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 BurstXfer(
+    MDIS_PATH path,
+    u_int32 offset,
+    u_int32 width,
+    u_int32 count,
+    u_int8 *data,
+    int write
+)
+{
+    u_int32 buf[(sizeof(MMODPRG_BURST_HDR) + MMODPRG_API_BURST_CHUNK) / 4];
+    MMODPRG_BURST_HDR *hdr = (MMODPRG_BURST_HDR*)buf;
+    M_SG_BLOCK blk;
+    u_int32 n, nBytes;
+
+    if( width != 1 && width != 2 && width != 4 )
+        return( ERR_LL_ILL_PARAM );
+
+    blk.data = (void*)buf;
+
+    while( count ) {
+        n = MMODPRG_API_BURST_CHUNK / width;
+        if( n > count )
+            n = count;
+        nBytes = n * width;
+
+        hdr->offset = offset;
+        hdr->width  = width;
+        hdr->count  = n;
+        blk.size    = MMODPRG_BURST_SIZE( n, width );
+
+        if( write ) {
+            memcpy( hdr + 1, data, nBytes );
+            if( M_setstat( path, MMODPRG_BLK_BURST, (INT32_OR_64)&blk ) < 0 )
+                return( UOS_ErrnoGet() );
+        }
+        else {
+            if( M_getstat( path, MMODPRG_BLK_BURST, (int32*)&blk ) < 0 )
+                return( UOS_ErrnoGet() );
+            memcpy( data, hdr + 1, nBytes );
+        }
+
+        offset += nBytes;
+        data   += nBytes;
+        count  -= n;
+    }
+
+    return( ERR_SUCCESS );
+}
+
+/****************************** MMODPRG_FifoRead ****************************
+ *
+ *  Description:  Read elements from a FIFO port
+ *
+ *                If the port has a level register, reading stops as soon
+ *                as the FIFO had fewer entries than requested.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                port   port description: offset, width, count and
+ *                       optional level register (done is ignored)
+ *  Output.....:  data   elements read (u_int8/u_int16/u_int32 array)
+ *                doneP  number of elements read
+ *                return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_FifoRead(
+    MDIS_PATH path,
+    const MMODPRG_FIFO_HDR *port,
+    void *data,
+    u_int32 *doneP
+)
+{
+    return( FifoXfer( path, port, (u_int8*)data, doneP, 0 ) );
+}
+
+/***************************** MMODPRG_FifoWrite ****************************
+ *
+ *  Description:  Write elements to a FIFO port
+ *
+ *                If the port has a level register, it is read before each
+ *                chunk and writing stops as soon as the FIFO had less
+ *                free entries than requested. The count of written
+ *                elements is only exact if no other path writes to the
+ *                same FIFO port.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                port   port description (see MMODPRG_FifoRead)
+ *                data   elements to write (u_int8/u_int16/u_int32 array)
+ *  Output.....:  doneP  number of elements written
+ *                return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_FifoWrite(
+    MDIS_PATH path,
+    const MMODPRG_FIFO_HDR *port,
+    const void *data,
+    u_int32 *doneP
+)
+{
+    return( FifoXfer( path, port, (u_int8*)data, doneP, 1 ) );
+}
+
+/********************************* FifoXfer *********************************
+ *
+ *  Description:  Transfer FIFO elements in chunks of MMODPRG_API_BURST_CHUNK
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                port   port description
+ *                data   data buffer
+ *                write  0=read, 1=write
+ *  Output.....:  doneP  number of elements transferred
+ *                return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 FifoXfer(
+    MDIS_PATH path,
+    const MMODPRG_FIFO_HDR *port,
+    u_int8 *data,
+    u_int32 *doneP,
+    int write
+)
+{
+    u_int32 buf[(sizeof(MMODPRG_FIFO_HDR) + MMODPRG_API_BURST_CHUNK) / 4];
+    MMODPRG_FIFO_HDR *hdr = (MMODPRG_FIFO_HDR*)buf;
+    M_SG_BLOCK blk;
+    u_int32 n, want, left, done, level;
+    int levelCode = 0;
+
+    *doneP = 0;
+
+    if( port->width != 1 && port->width != 2 && port->width != 4 )
+        return( ERR_LL_ILL_PARAM );
+
+    if( write && port->levelWidth ) {
+        switch( port->levelWidth ) {
+        case 1:  levelCode = MMODPRG_BLK_D8;  break;
+        case 2:  levelCode = MMODPRG_BLK_D16; break;
+        case 4:  levelCode = MMODPRG_BLK_D32; break;
+        default: return( ERR_LL_ILL_PARAM );
+        }
+    }
+
+    blk.data = (void*)buf;
+
+    for( left = port->count; left; left -= done ) {
+        n = MMODPRG_API_BURST_CHUNK / port->width;
+        if( n > left )
+            n = left;
+        want = n;
+
+        /*--- writes: bound by free entries (SetStat returns no count) ---*/
+        if( levelCode ) {
+            if( MMODPRG_GetValue( path, levelCode, port->levelOffset,
+                                  &level ) < 0 )
+                return( UOS_ErrnoGet() );
+
+            if( port->levelMask )
+                level &= port->levelMask;
+            level >>= port->levelShift & 31;
+
+            if( n > level )
+                n = level;
+            if( n == 0 )
+                break;          /* FIFO full */
+        }
+
+        *hdr       = *port;
+        hdr->count = n;
+        blk.size   = MMODPRG_FIFO_SIZE( n, port->width );
+
+        if( write ) {
+            memcpy( hdr + 1, data, n * port->width );
+
+            if( M_setstat( path, MMODPRG_BLK_FIFO, (INT32_OR_64)&blk ) < 0 )
+                return( UOS_ErrnoGet() );
+
+            done = n;
+        }
+        else {
+            if( M_getstat( path, MMODPRG_BLK_FIFO, (int32*)&blk ) < 0 )
+                return( UOS_ErrnoGet() );
+
+            done = hdr->done;
+            memcpy( data, hdr + 1, done * port->width );
+        }
+
+        data   += done * port->width;
+        *doneP += done;
+
+        if( done < want )
+            break;              /* FIFO level reached */
+    }
+
+    return( ERR_SUCCESS );
+}
+
+/***************************** MMODPRG_StrideRead ***************************
+ *
+ *  Description:  Read strided/2D elements into a dense buffer
+ *
+ *                Element e of row r is read from
+ *                offset + r*pitch + e*stride and stored at
+ *                data[r*count + e].
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                desc   transfer description
+ *  Output.....:  data   rows*count elements (u_int8/u_int16/u_int32 array)
+ *                return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_StrideRead(
+    MDIS_PATH path,
+    const MMODPRG_STRIDE_HDR *desc,
+    void *data
+)
+{
+    return( StrideXfer( path, desc, (u_int8*)data, 0 ) );
+}
+
+/**************************** MMODPRG_StrideWrite ***************************
+ *
+ *  Description:  Write strided/2D elements from a dense buffer
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                desc   transfer description (see MMODPRG_StrideRead)
+ *                data   rows*count elements (u_int8/u_int16/u_int32 array)
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_StrideWrite(
+    MDIS_PATH path,
+    const MMODPRG_STRIDE_HDR *desc,
+    const void *data
+)
+{
+    return( StrideXfer( path, desc, (u_int8*)data, 1 ) );
+}
+
+/******************************** StrideXfer ********************************
+ *
+ *  Description:  Transfer strided/2D elements in chunks of
+ *                MMODPRG_API_BURST_CHUNK
+ *
+ *                Whole rows are grouped into one chunk; rows larger than
+ *                a chunk are split into groups of elements.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                desc   transfer description
+ *                data   data buffer
+ *                write  0=read, 1=write
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 StrideXfer(
+    MDIS_PATH path,
+    const MMODPRG_STRIDE_HDR *desc,
+    u_int8 *data,
+    int write
+)
+{
+    u_int32 buf[(sizeof(MMODPRG_STRIDE_HDR) + MMODPRG_API_BURST_CHUNK) / 4];
+    MMODPRG_STRIDE_HDR *hdr = (MMODPRG_STRIDE_HDR*)buf;
+    M_SG_BLOCK blk;
+    u_int32 w = desc->width, r, e, nRows, nElem, len;
+
+    if( (w != 1 && w != 2 && w != 4) || desc->count == 0 || desc->rows == 0 )
+        return( ERR_LL_ILL_PARAM );
+
+    blk.data = (void*)buf;
+
+    /* compare counts, not byte sizes: count*w may exceed 32 bits */
+    for( r = 0; r < desc->rows; r += nRows ) {
+        if( desc->count <= MMODPRG_API_BURST_CHUNK / w ) {
+            /* group of whole rows */
+            nRows = MMODPRG_API_BURST_CHUNK / (desc->count * w);
+            if( nRows > desc->rows - r )
+                nRows = desc->rows - r;
+        }
+        else
+            nRows = 1;
+
+        for( e = 0; e < desc->count; e += nElem ) {
+            nElem = desc->count - e;
+            if( nElem > MMODPRG_API_BURST_CHUNK / w )
+                nElem = MMODPRG_API_BURST_CHUNK / w;
+
+            *hdr        = *desc;
+            hdr->offset = desc->offset + r * desc->pitch + e * desc->stride;
+            hdr->count  = nElem;
+            hdr->rows   = nRows;
+            len         = nRows * nElem * w;
+            blk.size    = MMODPRG_STRIDE_SIZE( nRows, nElem, w );
+
+            if( write ) {
+                memcpy( hdr + 1, data, len );
+                if( M_setstat( path, MMODPRG_BLK_STRIDE,
+                               (INT32_OR_64)&blk ) < 0 )
+                    return( UOS_ErrnoGet() );
+            }
+            else {
+                if( M_getstat( path, MMODPRG_BLK_STRIDE, (int32*)&blk ) < 0 )
+                    return( UOS_ErrnoGet() );
+                memcpy( data, hdr + 1, len );
+            }
+            data += len;
+        }
+    }
+
+    return( ERR_SUCCESS );
+}
+
+/******************************** MMODPRG_Copy ******************************
+ *
+ *  Description:  Copy a range of the address window inside the driver
+ *
+ *                Overlapping ranges are handled like memmove().
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                dst    destination offset
+ *                src    source offset
+ *                len    number of bytes
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_Copy(
+    MDIS_PATH path,
+    u_int32 dst,
+    u_int32 src,
+    u_int32 len
+)
+{
+    MMODPRG_COPY_PB pb;
+    M_SG_BLOCK blk;
+
+    pb.src = src;
+    pb.dst = dst;
+    pb.len = len;
+
+    blk.size = sizeof(pb);
+    blk.data = (void*)&pb;
+
+    if( M_setstat( path, MMODPRG_BLK_COPY, (INT32_OR_64)&blk ) < 0 )
+        return( UOS_ErrnoGet() );
+
+    return( ERR_SUCCESS );
+}
+
+/******************************* MMODPRG_Search *****************************
+ *
+ *  Description:  Search a (masked) value in a range of the address window
+ *
+ *                The whole range is scanned with one driver call.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path    path of opened device
+ *                desc    search description: offset, len, width, stride,
+ *                        value, mask and maxHits (nHits is ignored)
+ *  Output.....:  hits    offsets of the first matches (maxHits slots)
+ *                nHitsP  number of matches stored
+ *                return  success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_Search(
+    MDIS_PATH path,
+    const MMODPRG_SEARCH_HDR *desc,
+    u_int32 *hits,
+    u_int32 *nHitsP
+)
+{
+    MMODPRG_SEARCH_HDR *hdr;
+    M_SG_BLOCK blk;
+    int32 error = ERR_SUCCESS;
+
+    *nHitsP = 0;
+
+    blk.size = MMODPRG_SEARCH_SIZE( desc->maxHits );
+    if( (hdr = (MMODPRG_SEARCH_HDR*)calloc( 1, blk.size )) == NULL )
+        return( ERR_OSS_MEM_ALLOC );
+
+    *hdr     = *desc;
+    blk.data = (void*)hdr;
+
+    if( M_getstat( path, MMODPRG_BLK_SEARCH, (int32*)&blk ) < 0 )
+        error = UOS_ErrnoGet();
+    else {
+        memcpy( hits, hdr + 1, hdr->nHits * 4 );
+        *nHitsP = hdr->nHits;
+    }
+
+    free( hdr );
+    return( error );
+}
+
+/****************************** MMODPRG_SnapRead ****************************
+ *
+ *  Description:  Read a consistent snapshot of a block updated by firmware
+ *
+ *                The driver retries the read until the sequence register
+ *                did not change during the read (see MMODPRG_SNAP_HDR).
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path     path of opened device
+ *                desc     snapshot description (retries, seq are ignored)
+ *  Output.....:  data     count elements (u_int8/u_int16/u_int32 array)
+ *                retriesP number of retries, 0 on error (may be NULL)
+ *                return   success (0) or error code
+ *                         ERR_LL_DEV_BUSY: retry limit exceeded
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_SnapRead(
+    MDIS_PATH path,
+    const MMODPRG_SNAP_HDR *desc,
+    void *data,
+    u_int32 *retriesP
+)
+{
+    MMODPRG_SNAP_HDR *hdr;
+    M_SG_BLOCK blk;
+    int32 error = ERR_SUCCESS;
+
+    if( (desc->width != 1 && desc->width != 2 && desc->width != 4) ||
+        desc->count > (0x7fffffff - sizeof(*hdr)) / desc->width )
+        return( ERR_LL_ILL_PARAM );
+
+    blk.size = MMODPRG_SNAP_SIZE( desc->count, desc->width );
+    if( (hdr = (MMODPRG_SNAP_HDR*)calloc( 1, blk.size )) == NULL )
+        return( ERR_OSS_MEM_ALLOC );
+
+    *hdr     = *desc;
+    blk.data = (void*)hdr;
+
+    /* block is not returned on error, retries unknown */
+    if( M_getstat( path, MMODPRG_BLK_SNAP, (int32*)&blk ) < 0 )
+        error = UOS_ErrnoGet();
+    else
+        memcpy( data, hdr + 1, desc->count * desc->width );
+
+    if( retriesP )
+        *retriesP = error ? 0 : hdr->retries;
+
+    free( hdr );
+    return( error );
+}
+
+/****************************** MMODPRG_CtxSelect ***************************
+ *
+ *  Description:  Select the driver context used by a path
+ *
+ *                Paths using different contexts have their own counters
+ *                and copy staging buffer in the driver. Isolation is
+ *                opt-in: every path starts with context 0, so paths that
+ *                never call this function share one context. Contexts are channels (M_MK_CH_CURRENT); the
+ *                driver reports MMODPRG_CTX_NUM channels.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                ctx    context number (0..MMODPRG_CTX_NUM-1)
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_CtxSelect(
+    MDIS_PATH path,
+    u_int32 ctx
+)
+{
+    if( ctx >= MMODPRG_CTX_NUM )
+        return( ERR_LL_ILL_PARAM );
+
+    if( M_setstat( path, M_MK_CH_CURRENT, ctx ) < 0 )
+        return( UOS_ErrnoGet() );
+
+    return( ERR_SUCCESS );
+}
+
+/******************************* MMODPRG_CtxStat ****************************
+ *
+ *  Description:  Get the counters of the path's driver context
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                clear  clear counters after reading
+ *  Output.....:  stat   counters
+ *                return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_CtxStat(
+    MDIS_PATH path,
+    MMODPRG_CTX_STAT *stat,
+    int clear
+)
+{
+    M_SG_BLOCK blk;
+
+    blk.size = sizeof(*stat);
+    blk.data = (void*)stat;
+
+    if( M_getstat( path, MMODPRG_BLK_CTX_STAT, (int32*)&blk ) < 0 ||
+        (clear && M_setstat( path, MMODPRG_CTX_CLR, 0 ) < 0) )
+        return( UOS_ErrnoGet() );
+
+    return( ERR_SUCCESS );
+}
+
+/**************************** MMODPRG_SamplerStart **************************
+ *
+ *  Description:  Start the driver's fixed-rate register sampler
+ *
+ *                Samples are read with M_getblock() as MMODPRG_SMP_REC
+ *                followed by nEntries u_int32 values each. Stop the
+ *                sampler with M_setstat(path, MMODPRG_SMP_STOP, 0).
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path     path of opened device
+ *                periodMs sampling period [ms]
+ *                nSamples ring buffer capacity [samples]
+ *                ent      registers to sample
+ *                nEntries number of registers
+ *  Output.....:  return   success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_SamplerStart(
+    MDIS_PATH path,
+    u_int32 periodMs,
+    u_int32 nSamples,
+    const MMODPRG_SMP_ENTRY *ent,
+    u_int32 nEntries
+)
+{
+    u_int32 buf[MMODPRG_SMP_PLAN_SIZE(MMODPRG_SMP_MAX_ENTRIES) / 4];
+    MMODPRG_SMP_PLAN *plan = (MMODPRG_SMP_PLAN*)buf;
+    M_SG_BLOCK blk;
+
+    if( nEntries > MMODPRG_SMP_MAX_ENTRIES )
+        return( ERR_LL_ILL_PARAM );
+
+    plan->periodMs = periodMs;
+    plan->nEntries = nEntries;
+    plan->nSamples = nSamples;
+    memcpy( plan + 1, ent, nEntries * sizeof(*ent) );
+
+    blk.size = MMODPRG_SMP_PLAN_SIZE( nEntries );
+    blk.data = (void*)buf;
+
+    if( M_setstat( path, MMODPRG_BLK_SMP_PLAN, (INT32_OR_64)&blk ) < 0 )
+        return( UOS_ErrnoGet() );
+
+    return( ERR_SUCCESS );
+}
+
+/****************************** MMODPRG_JobStart ****************************
+ *
+ *  Description:  Start a periodic write job in the driver
+ *
+ *                The driver writes the job's values from a cyclic timer,
+ *                e.g. to toggle a heartbeat or retrigger a watchdog.
+ *                A job running in the same slot is replaced.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                job    job definition (see MMODPRG_JOB)
+ *  Output.....:  return success (0) or error code
+ *                       ERR_LL_ILL_PARAM: e.g. period below two OSS ticks
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_JobStart(
+    MDIS_PATH path,
+    const MMODPRG_JOB *job
+)
+{
+    M_SG_BLOCK blk;
+
+    blk.size = sizeof(*job);
+    blk.data = (void*)job;
+
+    if( M_setstat( path, MMODPRG_BLK_JOB_START, (INT32_OR_64)&blk ) < 0 )
+        return( UOS_ErrnoGet() );
+
+    return( ERR_SUCCESS );
+}
+
+/****************************** MMODPRG_JobStop *****************************
+ *
+ *  Description:  Stop a periodic write job
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                id     job slot or MMODPRG_JOB_ALL
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_JobStop(
+    MDIS_PATH path,
+    u_int32 id
+)
+{
+    if( M_setstat( path, MMODPRG_JOB_STOP, (INT32_OR_64)id ) < 0 )
+        return( UOS_ErrnoGet() );
+
+    return( ERR_SUCCESS );
+}
+
+/****************************** MMODPRG_JobStat *****************************
+ *
+ *  Description:  Get the status of a periodic write job
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                id     job slot
+ *  Output.....:  stat   job status (running, period, runs, missed
+ *                       deadlines, last value)
+ *                return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_JobStat(
+    MDIS_PATH path,
+    u_int32 id,
+    MMODPRG_JOB_STAT *stat
+)
+{
+    M_SG_BLOCK blk;
+
+    stat->id = id;
+    blk.size = sizeof(*stat);
+    blk.data = (void*)stat;
+
+    if( M_getstat( path, MMODPRG_BLK_JOB_STAT, (int32*)&blk ) < 0 )
+        return( UOS_ErrnoGet() );
+
+    return( ERR_SUCCESS );
+}
@@ -0,0 +1,674 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************
+ *
+ *         Name: mmodprg_ecc.c
+ *      Project: MMODPRG user space API library
+ *
+ *       Author: kp
+ *
+ *  Description: Software SECDED ECC for data in the address window
+ *
+ *               Each 32 bit data word is protected by one check byte
+ *               (extended Hamming code (39,32)): bits 0..5 hold the
+ *               Hamming check bits, bit 6 the overall parity. The check
+ *               bytes of a data region [dataBase, dataBase+size) are
+ *               stored in a separate region [chkBase, chkBase+size/4).
+ *
+ *               Encoding and syndrome computation use four 256-entry
+ *               tables (one per data byte), i.e. four lookups and XORs
+ *               per word. Each data bit has a distinct 6-bit column code
+ *               with at least two bits set, so single bit errors in data
+ *               and check bits can be told apart.
+ *
+ *               Reads correct single bit errors in the returned data and
+ *               report double bit errors. The optional scrubber thread
+ *               walks the region and rewrites corrected words.
+ *
+ *               Calls on one handle are serialized by a mutex, including
+ *               the scrubber.
+ *
+ *     Required: MDIS API, usr_oss, pthread
+ *     Switches: -
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2010-2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_api.h>
+#include <MEN/mdis_err.h>
+#include <MEN/usr_oss.h>
+#include <MEN/mmodprg_drv.h>
+#include <MEN/mmodprg_api.h>
+
+/*-----------------------------------------+
+|  DEFINES                                 |
++-----------------------------------------*/
+#define ECC_CHUNK       256             /* words per driver call */
+
+#define ECC_P_MASK      0x3f            /* Hamming check bits */
+#define ECC_OVERALL     0x40            /* overall parity bit */
+#define ECC_DPAR        0x80            /* table only: data byte parity */
+
+/*-----------------------------------------+
+|  TYPEDEFS                                |
++-----------------------------------------*/
+/* ECC handle */
+struct MMODPRG_ECC {
+    MDIS_PATH       path;
+    u_int32         dataBase;   /* start of data region */
+    u_int32         nWords;     /* data words */
+    u_int32         chkBase;    /* start of check byte region */
+    pthread_mutex_t lock;
+    MMODPRG_ECC_STAT stat;
+    /* scrubber */
+    pthread_t       tid;
+    pthread_cond_t  cond;
+    int             scrubRun;   /* thread running */
+    int             scrubStop;  /* stop request */
+    u_int32         scrubPos;   /* next word to scrub */
+    u_int32         scrubWords; /* words per step */
+    u_int32         scrubMs;    /* delay between steps */
+};
+
+/*-----------------------------------------+
+|  GLOBALS                                 |
++-----------------------------------------*/
+static u_int8  G_encTbl[4][256];        /* check bits per data byte */
+static int8    G_synBit[64];            /* syndrome -> data bit or -1 */
+static pthread_once_t G_tblOnce = PTHREAD_ONCE_INIT;
+
+/*-----------------------------------------+
+|  PROTOTYPES                              |
++-----------------------------------------*/
+static void  TblInit( void );
+static u_int8 EncRaw( u_int32 data );
+static u_int8 Parity( u_int8 v );
+static int32 Xfer( MMODPRG_ECC *ecc, u_int32 word, u_int32 n,
+                   u_int32 *data, u_int8 *chk, int write );
+static int32 ReadLocked( MMODPRG_ECC *ecc, u_int32 word, u_int32 *data,
+                         u_int32 nWords, int scrub, u_int32 *badP );
+static void* Scrubber( void *arg );
+
+/******************************** MMODPRG_EccEncode *************************
+ *
+ *  Description:  Compute check byte of a data word
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  data   data word
+ *  Output.....:  return check byte
+ *  Globals....:  ---
+ ****************************************************************************/
+u_int8 MMODPRG_EccEncode( u_int32 data )
+{
+    u_int8 c;
+
+    pthread_once( &G_tblOnce, TblInit );
+
+    c = EncRaw( data );
+
+    /* overall parity: data parity ^ parity of Hamming bits */
+    c &= ECC_P_MASK | ECC_DPAR;
+    return( (c & ECC_P_MASK) | (Parity( c ) ? ECC_OVERALL : 0) );
+}
+
+/******************************** MMODPRG_EccDecode *************************
+ *
+ *  Description:  Check and correct a data word
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  dataP  data word
+ *                chk    stored check byte
+ *  Output.....:  dataP  corrected data word
+ *                return MMODPRG_ECC_OK, MMODPRG_ECC_CORR (single bit error
+ *                       corrected, in data or check byte) or
+ *                       MMODPRG_ECC_UNCORR (double bit error)
+ *  Globals....:  ---
+ ****************************************************************************/
+int MMODPRG_EccDecode(
+    u_int32 *dataP,
+    u_int8 chk
+)
+{
+    u_int8 c, syn, par;
+    int bit;
+
+    pthread_once( &G_tblOnce, TblInit );
+
+    c   = EncRaw( *dataP );
+    syn = (c ^ chk) & ECC_P_MASK;
+
+    /* parity over data and all 7 stored check bits */
+    par = (c >> 7) ^ Parity( chk & (ECC_P_MASK | ECC_OVERALL) );
+
+    if( syn == 0 )
+        return( par ? MMODPRG_ECC_CORR : MMODPRG_ECC_OK ); /* overall bit */
+
+    if( !par )
+        return( MMODPRG_ECC_UNCORR );                  /* double error */
+
+    if( (syn & (syn - 1)) == 0 )
+        return( MMODPRG_ECC_CORR );                    /* check bit */
+
+    if( (bit = G_synBit[syn]) < 0 )
+        return( MMODPRG_ECC_UNCORR );                  /* >2 bits */
+
+    *dataP ^= 1U << bit;
+    return( MMODPRG_ECC_CORR );
+}
+
+/********************************** TblInit *********************************
+ *
+ *  Description:  Build encode and syndrome tables
+ *
+ *                Column code of data bit i is the i-th 6-bit value with at
+ *                least two bits set.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  ---
+ *  Output.....:  ---
+ *  Globals....:  G_encTbl, G_synBit
+ ****************************************************************************/
+static void TblInit( void )
+{
+    u_int8 code[32];
+    u_int32 v, b, i, n;
+
+    memset( G_synBit, -1, sizeof(G_synBit) );
+
+    for( v=3, n=0; n<32; v++ ) {
+        if( v & (v - 1) ) {
+            G_synBit[v] = (int8)n;
+            code[n++] = (u_int8)v;
+        }
+    }
+
+    for( b=0; b<4; b++ ) {
+        for( v=0; v<256; v++ ) {
+            G_encTbl[b][v] = 0;
+            for( i=0; i<8; i++ ) {
+                if( v & (1 << i) )
+                    G_encTbl[b][v] ^= code[b*8 + i] | ECC_DPAR;
+            }
+        }
+    }
+}
+
+/*********************************** EncRaw *********************************
+ *
+ *  Description:  Table lookup: Hamming bits (0..5) and data parity (7)
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  data   data word
+ *  Output.....:  return raw check byte
+ *  Globals....:  G_encTbl
+ ****************************************************************************/
+static u_int8 EncRaw( u_int32 data )
+{
+    return( G_encTbl[0][data & 0xff] ^ G_encTbl[1][(data >> 8) & 0xff] ^
+            G_encTbl[2][(data >> 16) & 0xff] ^ G_encTbl[3][data >> 24] );
+}
+
+/*********************************** Parity *********************************
+ *
+ *  Description:  Parity of a byte
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  v      byte
+ *  Output.....:  return 1 if odd number of bits set
+ *  Globals....:  ---
+ ****************************************************************************/
+static u_int8 Parity( u_int8 v )
+{
+    v ^= v >> 4;
+    return( (0x6996 >> (v & 0xf)) & 1 );
+}
+
+/********************************* MMODPRG_EccOpen **************************
+ *
+ *  Description:  Open ECC protection of a data region
+ *
+ *                The check region must not overlap the data region. Use
+ *                MMODPRG_EccRebuild() to initialize the check bytes of
+ *                existing data.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path     path of opened device
+ *                dataBase start of data region (aligned to 4)
+ *                size     size of data region (multiple of 4)
+ *                chkBase  start of check region (size/4 bytes)
+ *  Output.....:  eccP     ECC handle
+ *                return   success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_EccOpen(
+    MDIS_PATH path,
+    u_int32 dataBase,
+    u_int32 size,
+    u_int32 chkBase,
+    MMODPRG_ECC **eccP
+)
+{
+    MMODPRG_ECC *ecc;
+
+    *eccP = NULL;
+
+    if( (dataBase & 3) || (size & 3) || size == 0 ||
+        (chkBase < dataBase + size && chkBase + size / 4 > dataBase) )
+        return( ERR_LL_ILL_PARAM );
+
+    if( (ecc = (MMODPRG_ECC*)calloc( 1, sizeof(*ecc) )) == NULL )
+        return( ERR_OSS_MEM_ALLOC );
+
+    pthread_once( &G_tblOnce, TblInit );
+
+    ecc->path     = path;
+    ecc->dataBase = dataBase;
+    ecc->nWords   = size / 4;
+    ecc->chkBase  = chkBase;
+    pthread_mutex_init( &ecc->lock, NULL );
+    pthread_cond_init( &ecc->cond, NULL );
+
+    *eccP = ecc;
+    return( ERR_SUCCESS );
+}
+
+/******************************** MMODPRG_EccClose **************************
+ *
+ *  Description:  Close ECC handle (stops scrubber)
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  ecc    ECC handle
+ *  Output.....:  return success (0)
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_EccClose( MMODPRG_ECC *ecc )
+{
+    MMODPRG_EccScrubStop( ecc );
+
+    pthread_cond_destroy( &ecc->cond );
+    pthread_mutex_destroy( &ecc->lock );
+    free( ecc );
+
+    return( ERR_SUCCESS );
+}
+
+/******************************* MMODPRG_EccRebuild *************************
+ *
+ *  Description:  Compute check bytes of the whole data region
+ *
+ *                Existing data is taken as correct.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  ecc    ECC handle
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_EccRebuild( MMODPRG_ECC *ecc )
+{
+    u_int32 data[ECC_CHUNK];
+    u_int8 chk[ECC_CHUNK];
+    u_int32 w, n, i;
+    int32 error = ERR_SUCCESS;
+
+    pthread_mutex_lock( &ecc->lock );
+
+    for( w=0; w<ecc->nWords && !error; w+=n ) {
+        n = ecc->nWords - w < ECC_CHUNK ? ecc->nWords - w : ECC_CHUNK;
+
+        if( (error = MMODPRG_BurstRead( ecc->path, ecc->dataBase + w * 4, 4,
+                                        n, data )) )
+            break;
+
+        for( i=0; i<n; i++ )
+            chk[i] = MMODPRG_EccEncode( data[i] );
+
+        error = MMODPRG_BurstWrite( ecc->path, ecc->chkBase + w, 1, n, chk );
+    }
+
+    pthread_mutex_unlock( &ecc->lock );
+    return( error );
+}
+
+/******************************** MMODPRG_EccWrite **************************
+ *
+ *  Description:  Write data words with check bytes
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  ecc    ECC handle
+ *                offset offset in data region (aligned to 4)
+ *                data   data words
+ *                nWords number of words
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_EccWrite(
+    MMODPRG_ECC *ecc,
+    u_int32 offset,
+    const u_int32 *data,
+    u_int32 nWords
+)
+{
+    u_int8 chk[ECC_CHUNK];
+    u_int32 w, n, i;
+    int32 error = ERR_SUCCESS;
+
+    if( (offset & 3) || offset / 4 + nWords > ecc->nWords ||
+        offset / 4 + nWords < nWords )
+        return( ERR_LL_ILL_PARAM );
+
+    pthread_mutex_lock( &ecc->lock );
+
+    for( w=offset/4; nWords && !error; w+=n, data+=n, nWords-=n ) {
+        n = nWords < ECC_CHUNK ? nWords : ECC_CHUNK;
+
+        for( i=0; i<n; i++ )
+            chk[i] = MMODPRG_EccEncode( data[i] );
+
+        error = Xfer( ecc, w, n, (u_int32*)data, chk, 1 );
+    }
+
+    pthread_mutex_unlock( &ecc->lock );
+    return( error );
+}
+
+/********************************* MMODPRG_EccRead **************************
+ *
+ *  Description:  Read and check data words
+ *
+ *                Single bit errors are corrected in the returned data
+ *                (the SRAM is left unchanged, see scrubber).
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  ecc    ECC handle
+ *                offset offset in data region (aligned to 4)
+ *                data   data buffer
+ *                nWords number of words
+ *  Output.....:  data   corrected data words
+ *                badP   offset of first uncorrectable word (may be NULL)
+ *                return success (0), MMODPRG_ECC_UNCORR or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_EccRead(
+    MMODPRG_ECC *ecc,
+    u_int32 offset,
+    u_int32 *data,
+    u_int32 nWords,
+    u_int32 *badP
+)
+{
+    int32 error;
+
+    if( (offset & 3) || offset / 4 + nWords > ecc->nWords ||
+        offset / 4 + nWords < nWords )
+        return( ERR_LL_ILL_PARAM );
+
+    pthread_mutex_lock( &ecc->lock );
+    error = ReadLocked( ecc, offset / 4, data, nWords, 0, badP );
+    pthread_mutex_unlock( &ecc->lock );
+
+    return( error );
+}
+
+/****************************** MMODPRG_EccGetStat **************************
+ *
+ *  Description:  Get error counters
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  ecc    ECC handle
+ *  Output.....:  stat   counters
+ *  Globals....:  ---
+ ****************************************************************************/
+void MMODPRG_EccGetStat(
+    MMODPRG_ECC *ecc,
+    MMODPRG_ECC_STAT *stat
+)
+{
+    pthread_mutex_lock( &ecc->lock );
+    *stat = ecc->stat;
+    pthread_mutex_unlock( &ecc->lock );
+}
+
+/***************************** MMODPRG_EccScrubStart ************************
+ *
+ *  Description:  Start background scrubber
+ *
+ *                Every periodMs milliseconds, the next nWords words are
+ *                checked; words with a single bit error are rewritten with
+ *                corrected data and check byte. The scrubber wraps around
+ *                at the end of the region.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  ecc      ECC handle
+ *                nWords   words per step (1..)
+ *                periodMs delay between steps [ms]
+ *  Output.....:  return   success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_EccScrubStart(
+    MMODPRG_ECC *ecc,
+    u_int32 nWords,
+    u_int32 periodMs
+)
+{
+    if( nWords == 0 )
+        return( ERR_LL_ILL_PARAM );
+
+    /* check and set atomically, the scrubber waits for the unlock */
+    pthread_mutex_lock( &ecc->lock );
+    if( ecc->scrubRun ) {
+        pthread_mutex_unlock( &ecc->lock );
+        return( ERR_LL_DEV_BUSY );
+    }
+
+    ecc->scrubWords = nWords;
+    ecc->scrubMs    = periodMs;
+    ecc->scrubStop  = 0;
+
+    if( pthread_create( &ecc->tid, NULL, Scrubber, ecc ) ) {
+        pthread_mutex_unlock( &ecc->lock );
+        return( ERR_OSS_MEM_ALLOC );
+    }
+
+    ecc->scrubRun = 1;
+    pthread_mutex_unlock( &ecc->lock );
+    return( ERR_SUCCESS );
+}
+
+/***************************** MMODPRG_EccScrubStop *************************
+ *
+ *  Description:  Stop background scrubber and wait for its termination
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  ecc    ECC handle
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+void MMODPRG_EccScrubStop( MMODPRG_ECC *ecc )
+{
+    /* scrubRun stays set until joined, so no start can interfere */
+    pthread_mutex_lock( &ecc->lock );
+    if( !ecc->scrubRun || ecc->scrubStop ) {
+        pthread_mutex_unlock( &ecc->lock );
+        return;                 /* not running or already stopping */
+    }
+    ecc->scrubStop = 1;
+    pthread_cond_signal( &ecc->cond );
+    pthread_mutex_unlock( &ecc->lock );
+
+    pthread_join( ecc->tid, NULL );
+
+    pthread_mutex_lock( &ecc->lock );
+    ecc->scrubRun = 0;
+    pthread_mutex_unlock( &ecc->lock );
+}
+
+/********************************** Scrubber ********************************
+ *
+ *  Description:  Scrubber thread
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  arg    ECC handle
+ *  Output.....:  return NULL
+ *  Globals....:  ---
+ ****************************************************************************/
+static void* Scrubber( void *arg )
+{
+    MMODPRG_ECC *ecc = (MMODPRG_ECC*)arg;
+    u_int32 data[ECC_CHUNK];
+    u_int32 left, n, bad;
+    struct timespec ts;
+
+    pthread_mutex_lock( &ecc->lock );
+
+    while( !ecc->scrubStop ) {
+        for( left = ecc->scrubWords; left; left -= n ) {
+            n = ecc->nWords - ecc->scrubPos;
+            if( n > left )
+                n = left;
+            if( n > ECC_CHUNK )
+                n = ECC_CHUNK;
+
+            ReadLocked( ecc, ecc->scrubPos, data, n, 1, &bad );
+
+            if( (ecc->scrubPos += n) == ecc->nWords ) {
+                ecc->scrubPos = 0;
+                ecc->stat.scrubPasses++;
+            }
+        }
+
+        /* wait period (or stop request) */
+        clock_gettime( CLOCK_REALTIME, &ts );
+        ts.tv_sec  += ecc->scrubMs / 1000;
+        ts.tv_nsec += (ecc->scrubMs % 1000) * 1000000;
+        if( ts.tv_nsec >= 1000000000 ) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+
+        while( !ecc->scrubStop &&
+               pthread_cond_timedwait( &ecc->cond, &ecc->lock, &ts ) == 0 )
+            ;
+    }
+
+    pthread_mutex_unlock( &ecc->lock );
+    return( NULL );
+}
+
+/******************************** ReadLocked ********************************
+ *
+ *  Description:  Read and check data words (lock held)
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  ecc    ECC handle
+ *                word   first word index
+ *                data   data buffer
+ *                nWords number of words
+ *                scrub  rewrite corrected words
+ *  Output.....:  data   corrected data words
+ *                badP   offset of first uncorrectable word (may be NULL)
+ *                return success (0), MMODPRG_ECC_UNCORR or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 ReadLocked(
+    MMODPRG_ECC *ecc,
+    u_int32 word,
+    u_int32 *data,
+    u_int32 nWords,
+    int scrub,
+    u_int32 *badP
+)
+{
+    u_int8 chk[ECC_CHUNK];
+    u_int32 n, i;
+    int32 error, result = ERR_SUCCESS;
+
+    for( ; nWords; word+=n, data+=n, nWords-=n ) {
+        n = nWords < ECC_CHUNK ? nWords : ECC_CHUNK;
+
+        if( (error = Xfer( ecc, word, n, data, chk, 0 )) )
+            return( error );
+
+        for( i=0; i<n; i++ ) {
+            switch( MMODPRG_EccDecode( &data[i], chk[i] ) ) {
+            case MMODPRG_ECC_OK:
+                break;
+            case MMODPRG_ECC_CORR:
+                ecc->stat.corrected++;
+                if( scrub ) {
+                    chk[i] = MMODPRG_EccEncode( data[i] );
+                    if( Xfer( ecc, word + i, 1, &data[i], &chk[i], 1 ) == 0 )
+                        ecc->stat.scrubbed++;
+                }
+                break;
+            default:
+                ecc->stat.uncorrectable++;
+                if( result == ERR_SUCCESS ) {
+                    result = MMODPRG_ECC_UNCORR;
+                    if( badP )
+                        *badP = (word + i) * 4;
+                }
+                break;
+            }
+        }
+    }
+
+    return( result );
+}
+
+/*********************************** Xfer ***********************************
+ *
+ *  Description:  Transfer data words and their check bytes
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  ecc    ECC handle
+ *                word   first word index
+ *                n      number of words (<= ECC_CHUNK)
+ *                data   data words
+ *                chk    check bytes
+ *                write  0=read, 1=write
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 Xfer(
+    MMODPRG_ECC *ecc,
+    u_int32 word,
+    u_int32 n,
+    u_int32 *data,
+    u_int8 *chk,
+    int write
+)
+{
+    int32 error;
+
+    if( write ) {
+        if( (error = MMODPRG_BurstWrite( ecc->path, ecc->dataBase + word * 4,
+                                         4, n, data )) )
+            return( error );
+        return( MMODPRG_BurstWrite( ecc->path, ecc->chkBase + word, 1, n,
+                                    chk ) );
+    }
+
+    if( (error = MMODPRG_BurstRead( ecc->path, ecc->dataBase + word * 4, 4, n,
+                                    data )) )
+        return( error );
+    return( MMODPRG_BurstRead( ecc->path, ecc->chkBase + word, 1, n, chk ) );
+}
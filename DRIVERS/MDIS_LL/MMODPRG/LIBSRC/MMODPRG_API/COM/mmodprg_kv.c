@@ -0,0 +1,635 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************
+ *
+ *         Name: mmodprg_kv.c
+ *      Project: MMODPRG user space API library
+ *
+ *       Author: kp
+ *
+ *  Description: Persistent key-value store in the address window
+ *
+ *               Layout of a store region [base, base+size):
+ *
+ *               base+0x00  KV_HDR (geometry, 32 bytes)
+ *               base+0x20  nSlots fixed-size slots
+ *
+ *               A slot is a KV_SLOT header (generation, key and value
+ *               length, CRC-32 over header fields, key and value)
+ *               followed by keyMax key bytes and valMax value bytes, both
+ *               padded to 4. A slot with generation 0, key length 0 or a
+ *               bad CRC is free. The generation is incremented on each
+ *               write of a slot, including deletion.
+ *
+ *               An update writes the key with the next generation into a
+ *               free slot and then frees the old slot, so a power loss
+ *               during the update leaves either the old or the new value.
+ *               If both slots survive, open keeps the newer generation.
+ *               One slot is therefore kept free for updates; inserts fail
+ *               with MMODPRG_KV_FULL when only one free slot is left.
+ *
+ *               On open, all slots are read with one bulk transfer into a
+ *               host copy, and a hash index (FNV-1a, chained) is built over
+ *               the used slots. Lookups are served from the host copy
+ *               without bus accesses; updates write only the changed slot.
+ *
+ *               A store handle must not be used by several threads at the
+ *               same time. The store must not be opened by several
+ *               processes at the same time.
+ *
+ *     Required: MDIS API, usr_oss
+ *     Switches: -
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2010-2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_api.h>
+#include <MEN/mdis_err.h>
+#include <MEN/usr_oss.h>
+#include <MEN/mmodprg_drv.h>
+#include <MEN/mmodprg_api.h>
+
+/*-----------------------------------------+
+|  DEFINES                                 |
++-----------------------------------------*/
+#define KV_MAGIC        0x4b565331      /* "KVS1" */
+#define KV_SLOT_OFFS    sizeof(KV_HDR)
+
+#define PAD4(n)         (((n) + 3) & ~3)
+
+/* slot image in host copy */
+#define SLOT(kv,i)      ((KV_SLOT*)((kv)->img + (i) * (kv)->slotSize))
+#define SLOT_KEY(s)     ((char*)((s) + 1))
+#define SLOT_VAL(kv,s)  ((u_int8*)((s) + 1) + PAD4((kv)->hdr.keyMax))
+
+/*-----------------------------------------+
+|  TYPEDEFS                                |
++-----------------------------------------*/
+/* region header */
+typedef struct {
+    u_int32 magic;          /* KV_MAGIC */
+    u_int32 nSlots;         /* number of slots */
+    u_int32 keyMax;         /* max. key length [bytes] */
+    u_int32 valMax;         /* max. value length [bytes] */
+    u_int32 reserved[3];
+    u_int32 crc;            /* CRC-32 of the fields above */
+} KV_HDR;
+
+/* slot header */
+typedef struct {
+    u_int32 gen;            /* generation, 0=never written */
+    u_int16 keyLen;         /* key length, 0=free */
+    u_int16 valLen;         /* value length */
+    u_int32 crc;            /* CRC-32 of gen, lengths, key and value */
+} KV_SLOT;
+
+/* store handle */
+struct MMODPRG_KV {
+    MDIS_PATH   path;
+    u_int32     base;       /* start of store region */
+    KV_HDR      hdr;
+    u_int32     slotSize;   /* bytes per slot */
+    u_int8      *img;       /* host copy of all slots */
+    u_int32     nBuckets;   /* hash buckets (power of 2) */
+    int32       *bucket;    /* first slot per bucket, -1=none */
+    int32       *next;      /* next slot in bucket chain per slot */
+    int32       *freeStk;   /* free slots */
+    u_int32     nFree;
+    u_int32     invalid;    /* slots with bad CRC found on open */
+};
+
+/*-----------------------------------------+
+|  PROTOTYPES                              |
++-----------------------------------------*/
+static u_int32 KeyHash( const char *key, u_int32 keyLen );
+static int32   SlotFind( MMODPRG_KV *kv, const char *key, u_int32 keyLen );
+static int32   SlotWrite( MMODPRG_KV *kv, u_int32 idx );
+static u_int32 SlotCrc( MMODPRG_KV *kv, KV_SLOT *s );
+static void    IndexInsert( MMODPRG_KV *kv, u_int32 idx );
+static void    IndexRemove( MMODPRG_KV *kv, u_int32 idx );
+
+/******************************** MMODPRG_KvFormat **************************
+ *
+ *  Description:  Create an empty key-value store in the address window
+ *
+ *                The number of slots is derived from the region size and
+ *                must be at least 2 (one is reserved for updates).
+ *                Any previous content of the region is lost.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                base   start offset of store region (aligned to 4)
+ *                size   size of store region
+ *                keyMax max. key length [bytes] (1..0xffff)
+ *                valMax max. value length [bytes] (0..0xffff)
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_KvFormat(
+    MDIS_PATH path,
+    u_int32 base,
+    u_int32 size,
+    u_int32 keyMax,
+    u_int32 valMax
+)
+{
+    KV_HDR hdr;
+    u_int32 zero[64];
+    u_int32 slotSize, offs, end, n;
+    int32 error;
+
+    if( (base & 3) || keyMax == 0 || keyMax > 0xffff || valMax > 0xffff )
+        return( ERR_LL_ILL_PARAM );
+
+    slotSize = sizeof(KV_SLOT) + PAD4(keyMax) + PAD4(valMax);
+    if( size < KV_SLOT_OFFS + 2 * slotSize )
+        return( ERR_LL_ILL_PARAM );
+
+    memset( &hdr, 0, sizeof(hdr) );
+    hdr.magic  = KV_MAGIC;
+    hdr.nSlots = (size - KV_SLOT_OFFS) / slotSize;
+    hdr.keyMax = keyMax;
+    hdr.valMax = valMax;
+    hdr.crc    = MMODPRG_Crc32( 0, &hdr, offsetof(KV_HDR, crc) );
+
+    /*--- clear all slots, then write header ---*/
+    memset( zero, 0, sizeof(zero) );
+    end = base + KV_SLOT_OFFS + hdr.nSlots * slotSize;
+
+    for( offs = base + KV_SLOT_OFFS; offs < end; offs += n ) {
+        n = end - offs < sizeof(zero) ? end - offs : sizeof(zero);
+        if( (error = MMODPRG_BurstWrite( path, offs, 4, n / 4, zero )) )
+            return( error );
+    }
+
+    return( MMODPRG_BurstWrite( path, base, 4, sizeof(hdr) / 4, &hdr ) );
+}
+
+/********************************* MMODPRG_KvOpen ***************************
+ *
+ *  Description:  Open a key-value store and build the host index
+ *
+ *                All slots are read with one bulk transfer. Slots with bad
+ *                CRC (e.g. torn write) are treated as free. If a key is
+ *                found in two slots (update interrupted before the old
+ *                slot was freed), the one with the higher generation is
+ *                used and the other one is treated as free.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                base   start offset of store region
+ *  Output.....:  kvP    store handle
+ *                return success (0) or error code
+ *                       ERR_LL_READ: no valid store in region
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_KvOpen(
+    MDIS_PATH path,
+    u_int32 base,
+    MMODPRG_KV **kvP
+)
+{
+    MMODPRG_KV *kv;
+    KV_SLOT *s;
+    int32 error, dup;
+    u_int32 i;
+
+    *kvP = NULL;
+
+    if( (kv = (MMODPRG_KV*)calloc( 1, sizeof(*kv) )) == NULL )
+        return( ERR_OSS_MEM_ALLOC );
+
+    kv->path = path;
+    kv->base = base;
+
+    if( (error = MMODPRG_BurstRead( path, base, 4, sizeof(kv->hdr) / 4,
+                                    &kv->hdr )) )
+        goto ABORT;
+
+    if( kv->hdr.magic != KV_MAGIC || kv->hdr.nSlots == 0 ||
+        kv->hdr.crc != MMODPRG_Crc32( 0, &kv->hdr,
+                                      offsetof(KV_HDR, crc) ) ) {
+        error = ERR_LL_READ;
+        goto ABORT;
+    }
+
+    kv->slotSize = sizeof(KV_SLOT) + PAD4(kv->hdr.keyMax) +
+                   PAD4(kv->hdr.valMax);
+
+    for( kv->nBuckets = 1; kv->nBuckets < kv->hdr.nSlots; kv->nBuckets <<= 1 )
+        ;
+
+    kv->img     = (u_int8*)malloc( kv->hdr.nSlots * kv->slotSize );
+    kv->bucket  = (int32*)malloc( kv->nBuckets * sizeof(int32) );
+    kv->next    = (int32*)malloc( kv->hdr.nSlots * sizeof(int32) );
+    kv->freeStk = (int32*)malloc( kv->hdr.nSlots * sizeof(int32) );
+
+    if( !kv->img || !kv->bucket || !kv->next || !kv->freeStk ) {
+        error = ERR_OSS_MEM_ALLOC;
+        goto ABORT;
+    }
+
+    /*--- one bulk scan of all slots ---*/
+    if( (error = MMODPRG_BurstRead( path, base + KV_SLOT_OFFS, 4,
+                                    kv->hdr.nSlots * kv->slotSize / 4,
+                                    kv->img )) )
+        goto ABORT;
+
+    memset( kv->bucket, 0xff, kv->nBuckets * sizeof(int32) );
+
+    for( i=kv->hdr.nSlots; i-- > 0; ) {
+        s = SLOT(kv, i);
+
+        if( s->gen != 0 && s->crc != SlotCrc( kv, s ) ) {
+            kv->invalid++;
+            s->keyLen = 0;
+        }
+
+        if( s->gen == 0 || s->keyLen == 0 || s->keyLen > kv->hdr.keyMax ||
+            s->valLen > kv->hdr.valMax ) {
+            s->keyLen = 0;
+            kv->freeStk[kv->nFree++] = i;
+            continue;
+        }
+
+        /* duplicate key (interrupted update): keep newer generation */
+        if( (dup = SlotFind( kv, SLOT_KEY(s), s->keyLen )) >= 0 ) {
+            if( (int32)(s->gen - SLOT(kv, dup)->gen) <= 0 ) {
+                s->keyLen = 0;
+                kv->freeStk[kv->nFree++] = i;
+                continue;
+            }
+            IndexRemove( kv, dup );
+            SLOT(kv, dup)->keyLen = 0;
+            kv->freeStk[kv->nFree++] = dup;
+        }
+
+        IndexInsert( kv, i );
+    }
+
+    *kvP = kv;
+    return( ERR_SUCCESS );
+
+ ABORT:
+    MMODPRG_KvClose( kv );
+    return( error );
+}
+
+/******************************** MMODPRG_KvClose ***************************
+ *
+ *  Description:  Close a key-value store handle
+ *
+ *                All updates are already persistent, nothing is written.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  kv     store handle
+ *  Output.....:  return success (0)
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_KvClose( MMODPRG_KV *kv )
+{
+    free( kv->img );
+    free( kv->bucket );
+    free( kv->next );
+    free( kv->freeStk );
+    free( kv );
+
+    return( ERR_SUCCESS );
+}
+
+/********************************* MMODPRG_KvGet ****************************
+ *
+ *  Description:  Look up a key
+ *
+ *                Served from the host copy, no bus access.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  kv     store handle
+ *                key    key (NUL terminated)
+ *                val    value buffer
+ *                maxLen size of val
+ *  Output.....:  val    value
+ *                lenP   value length
+ *                return success (0), MMODPRG_KV_NOTFOUND or error code
+ *                       ERR_LL_USERBUF: val too small
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_KvGet(
+    MMODPRG_KV *kv,
+    const char *key,
+    void *val,
+    u_int32 maxLen,
+    u_int32 *lenP
+)
+{
+    KV_SLOT *s;
+    int32 idx;
+
+    if( (idx = SlotFind( kv, key, strlen(key) )) < 0 )
+        return( MMODPRG_KV_NOTFOUND );
+
+    s = SLOT(kv, idx);
+    if( s->valLen > maxLen )
+        return( ERR_LL_USERBUF );
+
+    memcpy( val, SLOT_VAL(kv, s), s->valLen );
+    *lenP = s->valLen;
+
+    return( ERR_SUCCESS );
+}
+
+/********************************* MMODPRG_KvSet ****************************
+ *
+ *  Description:  Insert or update a key
+ *
+ *                An insert writes a free slot (one burst). An update
+ *                writes the new value with the next generation into a free
+ *                slot and then frees the old slot (two bursts), so a power
+ *                loss leaves either the old or the new value.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  kv     store handle
+ *                key    key (NUL terminated)
+ *                val    value
+ *                len    value length
+ *  Output.....:  return success (0), MMODPRG_KV_FULL or error code
+ *                       ERR_LL_ILL_PARAM: key or value too long
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_KvSet(
+    MMODPRG_KV *kv,
+    const char *key,
+    const void *val,
+    u_int32 len
+)
+{
+    u_int32 keyLen = strlen( key );
+    KV_SLOT *s, *o;
+    int32 idx, old;
+    u_int32 gen;
+    int32 error;
+
+    if( keyLen == 0 || keyLen > kv->hdr.keyMax || len > kv->hdr.valMax )
+        return( ERR_LL_ILL_PARAM );
+
+    old = SlotFind( kv, key, keyLen );
+
+    /* an insert must leave one free slot for updates */
+    if( kv->nFree == 0 || (old < 0 && kv->nFree < 2) )
+        return( MMODPRG_KV_FULL );
+
+    idx = kv->freeStk[--kv->nFree];
+    s = SLOT(kv, idx);
+    gen = s->gen;
+    s->gen    = old < 0 ? s->gen : SLOT(kv, old)->gen;
+    s->keyLen = (u_int16)keyLen;
+    s->valLen = (u_int16)len;
+    memset( SLOT_KEY(s), 0, PAD4(kv->hdr.keyMax) + PAD4(kv->hdr.valMax) );
+    memcpy( SLOT_KEY(s), key, keyLen );
+    memcpy( SLOT_VAL(kv, s), val, len );
+
+    /* failed: keep the free slot's own generation in the host copy */
+    if( (error = SlotWrite( kv, idx )) ) {
+        s->gen    = gen;
+        s->keyLen = 0;
+        kv->freeStk[kv->nFree++] = idx;
+        return( error );
+    }
+
+    if( old < 0 ) {
+        IndexInsert( kv, idx );
+        return( ERR_SUCCESS );
+    }
+
+    /*--- new value persistent, free old slot ---*/
+    IndexRemove( kv, old );
+    IndexInsert( kv, idx );
+
+    o = SLOT(kv, old);
+    o->keyLen = 0;
+    o->valLen = 0;
+    memset( SLOT_KEY(o), 0, PAD4(kv->hdr.keyMax) + PAD4(kv->hdr.valMax) );
+    kv->freeStk[kv->nFree++] = old;
+
+    return( SlotWrite( kv, old ) );
+}
+
+/******************************* MMODPRG_KvDelete ***************************
+ *
+ *  Description:  Delete a key
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  kv     store handle
+ *                key    key (NUL terminated)
+ *  Output.....:  return success (0), MMODPRG_KV_NOTFOUND or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_KvDelete(
+    MMODPRG_KV *kv,
+    const char *key
+)
+{
+    KV_SLOT *s;
+    int32 idx;
+
+    if( (idx = SlotFind( kv, key, strlen(key) )) < 0 )
+        return( MMODPRG_KV_NOTFOUND );
+
+    IndexRemove( kv, idx );
+
+    s = SLOT(kv, idx);
+    s->keyLen = 0;
+    s->valLen = 0;
+    memset( SLOT_KEY(s), 0, PAD4(kv->hdr.keyMax) + PAD4(kv->hdr.valMax) );
+    kv->freeStk[kv->nFree++] = idx;
+
+    return( SlotWrite( kv, idx ) );
+}
+
+/******************************* MMODPRG_KvGetInfo **************************
+ *
+ *  Description:  Get store state
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  kv     store handle
+ *  Output.....:  info   state
+ *  Globals....:  ---
+ ****************************************************************************/
+void MMODPRG_KvGetInfo(
+    MMODPRG_KV *kv,
+    MMODPRG_KV_INFO *info
+)
+{
+    info->nSlots  = kv->hdr.nSlots;
+    info->used    = kv->hdr.nSlots - kv->nFree;
+    info->keyMax  = kv->hdr.keyMax;
+    info->valMax  = kv->hdr.valMax;
+    info->invalid = kv->invalid;
+}
+
+/********************************* KeyHash **********************************
+ *
+ *  Description:  FNV-1a hash of a key
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  key    key
+ *                keyLen key length
+ *  Output.....:  return hash
+ *  Globals....:  ---
+ ****************************************************************************/
+static u_int32 KeyHash(
+    const char *key,
+    u_int32 keyLen
+)
+{
+    u_int32 h = 0x811c9dc5;
+
+    while( keyLen-- )
+        h = (h ^ (u_int8)*key++) * 0x01000193;
+
+    return( h );
+}
+
+/********************************* SlotFind *********************************
+ *
+ *  Description:  Find slot of a key in host index
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  kv     store handle
+ *                key    key
+ *                keyLen key length
+ *  Output.....:  return slot index or -1
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 SlotFind(
+    MMODPRG_KV *kv,
+    const char *key,
+    u_int32 keyLen
+)
+{
+    KV_SLOT *s;
+    int32 i;
+
+    for( i = kv->bucket[KeyHash( key, keyLen ) & (kv->nBuckets - 1)];
+         i >= 0; i = kv->next[i] ) {
+        s = SLOT(kv, i);
+        if( s->keyLen == keyLen && !memcmp( SLOT_KEY(s), key, keyLen ) )
+            return( i );
+    }
+
+    return( -1 );
+}
+
+/********************************* SlotWrite ********************************
+ *
+ *  Description:  Write slot from host copy with next generation
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  kv     store handle
+ *                idx    slot index
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 SlotWrite(
+    MMODPRG_KV *kv,
+    u_int32 idx
+)
+{
+    KV_SLOT *s = SLOT(kv, idx);
+
+    if( ++s->gen == 0 )
+        s->gen = 1;
+    s->crc = SlotCrc( kv, s );
+
+    return( MMODPRG_BurstWrite( kv->path,
+                                kv->base + KV_SLOT_OFFS + idx * kv->slotSize,
+                                4, kv->slotSize / 4, s ) );
+}
+
+/********************************** SlotCrc *********************************
+ *
+ *  Description:  Compute CRC of a slot
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  kv     store handle
+ *                s      slot
+ *  Output.....:  return CRC
+ *  Globals....:  ---
+ ****************************************************************************/
+static u_int32 SlotCrc(
+    MMODPRG_KV *kv,
+    KV_SLOT *s
+)
+{
+    u_int32 crc;
+
+    crc = MMODPRG_Crc32( 0, s, offsetof(KV_SLOT, crc) );
+    return( MMODPRG_Crc32( crc, s + 1, kv->slotSize - sizeof(KV_SLOT) ) );
+}
+
+/******************************** IndexInsert *******************************
+ *
+ *  Description:  Add slot to host index
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  kv     store handle
+ *                idx    slot index
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void IndexInsert(
+    MMODPRG_KV *kv,
+    u_int32 idx
+)
+{
+    KV_SLOT *s = SLOT(kv, idx);
+    u_int32 b = KeyHash( SLOT_KEY(s), s->keyLen ) & (kv->nBuckets - 1);
+
+    kv->next[idx] = kv->bucket[b];
+    kv->bucket[b] = idx;
+}
+
+/******************************** IndexRemove *******************************
+ *
+ *  Description:  Remove slot from host index
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  kv     store handle
+ *                idx    slot index
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void IndexRemove(
+    MMODPRG_KV *kv,
+    u_int32 idx
+)
+{
+    KV_SLOT *s = SLOT(kv, idx);
+    int32 *pp;
+
+    pp = &kv->bucket[KeyHash( SLOT_KEY(s), s->keyLen ) & (kv->nBuckets - 1)];
+
+    while( *pp >= 0 && *pp != (int32)idx )
+        pp = &kv->next[*pp];
+
+    if( *pp >= 0 )
+        *pp = kv->next[idx];
+}
@@ -0,0 +1,700 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************
+ *
+ *         Name: mmodprg_log.c
+ *      Project: MMODPRG user space API library
+ *
+ *       Author: kp
+ *
+ *  Description: Persistent append-only record log in the address window
+ *
+ *               Layout of a log region [base, base+size):
+ *
+ *               base+0x00  checkpoint slot 0   (LOG_CKPT, 32 bytes)
+ *               base+0x20  checkpoint slot 1
+ *               base+0x40  circular data area (records)
+ *
+ *               A record is a LOG_REC header (length, sequence number,
+ *               CRC-32 over length, sequence number and data) followed by
+ *               the data, padded to 4 bytes. Records may wrap around the
+ *               end of the data area.
+ *
+ *               A checkpoint holds head/tail offsets and sequence numbers.
+ *               Checkpoints are written alternately to both slots with an
+ *               increasing generation number and a CRC, so a torn
+ *               checkpoint write leaves the previous one valid.
+ *
+ *               An append writes the records (one burst, two on wrap) and
+ *               then one checkpoint. If old records must be evicted, a
+ *               checkpoint with the new head is written before the data.
+ *               On open, the newest valid checkpoint is loaded and only
+ *               the area behind its tail is scanned for records that were
+ *               written but not yet checkpointed.
+ *
+ *               A log handle must not be used by several threads at the
+ *               same time.
+ *
+ *     Required: MDIS API, usr_oss, pthread
+ *     Switches: -
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2010-2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_api.h>
+#include <MEN/mdis_err.h>
+#include <MEN/usr_oss.h>
+#include <MEN/mmodprg_drv.h>
+#include <MEN/mmodprg_api.h>
+
+/*-----------------------------------------+
+|  DEFINES                                 |
++-----------------------------------------*/
+#define LOG_MAGIC       0x4c4f4731      /* "LOG1" */
+#define LOG_CKPT_SLOTS  2
+#define LOG_DATA_OFFS   (LOG_CKPT_SLOTS * sizeof(LOG_CKPT))
+#define LOG_GAP         4               /* keeps tail != head if full */
+
+#define PAD4(n)         (((n) + 3) & ~3)
+#define REC_SIZE(len)   (sizeof(LOG_REC) + PAD4(len))
+
+/*-----------------------------------------+
+|  TYPEDEFS                                |
++-----------------------------------------*/
+/* checkpoint slot */
+typedef struct {
+    u_int32 magic;          /* LOG_MAGIC */
+    u_int32 gen;            /* generation, incremented per checkpoint */
+    u_int32 dataSize;       /* size of data area */
+    u_int32 head;           /* offset of oldest record */
+    u_int32 tail;           /* offset of next record */
+    u_int32 seqHead;        /* sequence number of oldest record */
+    u_int32 seqTail;        /* sequence number of next record */
+    u_int32 crc;            /* CRC-32 of the fields above */
+} LOG_CKPT;
+
+/* record header */
+typedef struct {
+    u_int32 len;            /* data length [bytes] */
+    u_int32 seq;            /* sequence number */
+    u_int32 crc;            /* CRC-32 of len, seq and data */
+} LOG_REC;
+
+/* log handle */
+struct MMODPRG_LOG {
+    MDIS_PATH   path;
+    u_int32     base;       /* start of log region */
+    u_int32     dataSize;   /* size of data area */
+    LOG_CKPT    ck;         /* current state (last checkpoint written) */
+    u_int32     used;       /* bytes between head and tail */
+    u_int32     recovered;  /* records found behind checkpoint on open */
+};
+
+/*-----------------------------------------+
+|  GLOBALS                                 |
++-----------------------------------------*/
+static u_int32 G_crcTbl[256];
+static pthread_once_t G_crcOnce = PTHREAD_ONCE_INIT;
+
+/*-----------------------------------------+
+|  PROTOTYPES                              |
++-----------------------------------------*/
+static void  CrcTblInit( void );
+static int32 CkptWrite( MMODPRG_LOG *log );
+static int32 DataXfer( MMODPRG_LOG *log, u_int32 pos, void *buf,
+                       u_int32 n, int write );
+static int32 RecCheck( MMODPRG_LOG *log, u_int32 pos, u_int32 maxRec,
+                       u_int32 seq, LOG_REC *rec );
+static u_int32 RecCrc( const LOG_REC *rec, const void *data );
+
+/******************************** MMODPRG_Crc32 *****************************
+ *
+ *  Description:  Compute CRC-32 (IEEE 802.3)
+ *
+ *                Start with crc=0; to continue over several buffers, pass
+ *                the result of the previous call.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  crc    previous CRC or 0
+ *                data   data
+ *                len    number of bytes
+ *  Output.....:  return CRC
+ *  Globals....:  G_crcTbl
+ ****************************************************************************/
+u_int32 MMODPRG_Crc32(
+    u_int32 crc,
+    const void *data,
+    u_int32 len
+)
+{
+    const u_int8 *p = (const u_int8*)data;
+
+    pthread_once( &G_crcOnce, CrcTblInit );
+
+    crc = ~crc;
+    while( len-- )
+        crc = G_crcTbl[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+    return( ~crc );
+}
+
+/********************************* CrcTblInit *******************************
+ *
+ *  Description:  Build CRC-32 table (reflected polynomial 0xedb88320)
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  ---
+ *  Output.....:  ---
+ *  Globals....:  G_crcTbl
+ ****************************************************************************/
+static void CrcTblInit( void )
+{
+    u_int32 n, c, k;
+
+    for( n=0; n<256; n++ ) {
+        for( c=n, k=0; k<8; k++ )
+            c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        G_crcTbl[n] = c;
+    }
+}
+
+/******************************* MMODPRG_LogFormat **************************
+ *
+ *  Description:  Create an empty log in the address window
+ *
+ *                Any previous log in the region is lost.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                base   start offset of log region (aligned to 4)
+ *                size   size of log region
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_LogFormat(
+    MDIS_PATH path,
+    u_int32 base,
+    u_int32 size
+)
+{
+    MMODPRG_LOG log;
+    LOG_CKPT empty;
+    int32 error;
+
+    if( (base & 3) || size < LOG_DATA_OFFS + sizeof(LOG_REC) + LOG_GAP )
+        return( ERR_LL_ILL_PARAM );
+
+    memset( &log, 0, sizeof(log) );
+    log.path        = path;
+    log.base        = base;
+    log.dataSize    = (size - LOG_DATA_OFFS) & ~3;
+    log.ck.magic    = LOG_MAGIC;
+    log.ck.dataSize = log.dataSize;
+
+    /* invalidate slot 1, then write first checkpoint to slot 0 */
+    memset( &empty, 0, sizeof(empty) );
+    if( (error = MMODPRG_BurstWrite( path, base + sizeof(LOG_CKPT), 4,
+                                     sizeof(empty) / 4, &empty )) )
+        return( error );
+
+    log.ck.gen = (u_int32)-1;
+    return( CkptWrite( &log ) );
+}
+
+/******************************** MMODPRG_LogOpen ***************************
+ *
+ *  Description:  Open a log and recover its state
+ *
+ *                The newest valid checkpoint is loaded. Records behind
+ *                the checkpointed tail with valid CRC and consecutive
+ *                sequence numbers are taken over and a new checkpoint is
+ *                written.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                base   start offset of log region
+ *                size   size of log region (as passed to MMODPRG_LogFormat)
+ *  Output.....:  logP   log handle
+ *                return success (0) or error code
+ *                       ERR_LL_READ: no valid log in region
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_LogOpen(
+    MDIS_PATH path,
+    u_int32 base,
+    u_int32 size,
+    MMODPRG_LOG **logP
+)
+{
+    MMODPRG_LOG *log;
+    LOG_CKPT ck[LOG_CKPT_SLOTS];
+    LOG_REC rec;
+    int32 error;
+    int s, best = -1;
+
+    *logP = NULL;
+
+    if( (base & 3) || size < LOG_DATA_OFFS + sizeof(LOG_REC) + LOG_GAP )
+        return( ERR_LL_ILL_PARAM );
+
+    if( (error = MMODPRG_BurstRead( path, base, 4, sizeof(ck) / 4, ck )) )
+        return( error );
+
+    /*--- newest valid checkpoint ---*/
+    for( s=0; s<LOG_CKPT_SLOTS; s++ ) {
+        if( ck[s].magic != LOG_MAGIC ||
+            ck[s].dataSize != ((size - LOG_DATA_OFFS) & ~3) ||
+            ck[s].crc != MMODPRG_Crc32( 0, &ck[s],
+                                        offsetof(LOG_CKPT, crc) ) ||
+            ck[s].head >= ck[s].dataSize || ck[s].tail >= ck[s].dataSize )
+            continue;
+
+        if( best < 0 || (int32)(ck[s].gen - ck[best].gen) > 0 )
+            best = s;
+    }
+
+    if( best < 0 )
+        return( ERR_LL_READ );
+
+    if( (log = (MMODPRG_LOG*)calloc( 1, sizeof(*log) )) == NULL )
+        return( ERR_OSS_MEM_ALLOC );
+
+    log->path     = path;
+    log->base     = base;
+    log->dataSize = ck[best].dataSize;
+    log->ck       = ck[best];
+    log->used     = (log->ck.tail + log->dataSize - log->ck.head)
+                    % log->dataSize;
+
+    /*--- take over records written after the checkpoint ---*/
+    while( (error = RecCheck( log, log->ck.tail,
+                              log->dataSize - log->used - LOG_GAP,
+                              log->ck.seqTail, &rec )) == ERR_SUCCESS ) {
+        log->ck.tail = (log->ck.tail + REC_SIZE(rec.len)) % log->dataSize;
+        log->ck.seqTail++;
+        log->used += REC_SIZE(rec.len);
+        log->recovered++;
+    }
+
+    if( error == ERR_LL_READ )          /* no further valid record */
+        error = ERR_SUCCESS;
+
+    if( !error && log->recovered )
+        error = CkptWrite( log );
+
+    if( error ) {
+        free( log );
+        return( error );
+    }
+
+    *logP = log;
+    return( ERR_SUCCESS );
+}
+
+/******************************* MMODPRG_LogClose ***************************
+ *
+ *  Description:  Close a log handle
+ *
+ *                All appends are already persistent, nothing is written.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  log    log handle
+ *  Output.....:  return success (0)
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_LogClose( MMODPRG_LOG *log )
+{
+    free( log );
+    return( ERR_SUCCESS );
+}
+
+/******************************* MMODPRG_LogAppend **************************
+ *
+ *  Description:  Append one record
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  log    log handle
+ *                data   record data
+ *                len    data length [bytes]
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_LogAppend(
+    MMODPRG_LOG *log,
+    const void *data,
+    u_int32 len
+)
+{
+    MMODPRG_LOG_REC rec;
+
+    rec.data = data;
+    rec.len  = len;
+
+    return( MMODPRG_LogAppendBatch( log, &rec, 1 ) );
+}
+
+/**************************** MMODPRG_LogAppendBatch ************************
+ *
+ *  Description:  Append several records in one ordered write
+ *
+ *                The records get consecutive sequence numbers. They are
+ *                written to the data area in order, followed by one
+ *                checkpoint. Oldest records are evicted if there is not
+ *                enough free space; a checkpoint with the new head is then
+ *                written before their space is reused.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  log    log handle
+ *                rec    records
+ *                nRec   number of records
+ *  Output.....:  return success (0) or error code
+ *                       ERR_LL_ILL_PARAM: batch larger than data area
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_LogAppendBatch(
+    MMODPRG_LOG *log,
+    const MMODPRG_LOG_REC *rec,
+    int nRec
+)
+{
+    LOG_REC hdr;
+    u_int8 *buf, *p;
+    u_int32 total = 0, evicted = 0;
+    int32 error;
+    int n;
+
+    if( nRec <= 0 )
+        return( ERR_SUCCESS );
+
+    /* checked per record, the sum of many records could wrap */
+    for( n=0; n<nRec; n++ ) {
+        if( rec[n].len > log->dataSize ||
+            REC_SIZE(rec[n].len) > log->dataSize - LOG_GAP - total )
+            return( ERR_LL_ILL_PARAM );
+        total += REC_SIZE(rec[n].len);
+    }
+
+    /*--- evict oldest records until the batch fits ---*/
+    while( total > log->dataSize - log->used - LOG_GAP ) {
+        if( (error = DataXfer( log, log->ck.head, &hdr, sizeof(hdr), 0 )) )
+            return( error );
+
+        if( hdr.seq != log->ck.seqHead || REC_SIZE(hdr.len) > log->used )
+            return( ERR_LL_READ );      /* log corrupted */
+
+        log->ck.head = (log->ck.head + REC_SIZE(hdr.len)) % log->dataSize;
+        log->ck.seqHead++;
+        log->used -= REC_SIZE(hdr.len);
+        evicted++;
+    }
+
+    if( evicted && (error = CkptWrite( log )) )
+        return( error );
+
+    /*--- build all records in one buffer ---*/
+    if( (buf = (u_int8*)calloc( 1, total )) == NULL )
+        return( ERR_OSS_MEM_ALLOC );
+
+    for( n=0, p=buf; n<nRec; n++ ) {
+        hdr.len = rec[n].len;
+        hdr.seq = log->ck.seqTail + n;
+        hdr.crc = RecCrc( &hdr, rec[n].data );
+
+        memcpy( p, &hdr, sizeof(hdr) );
+        memcpy( p + sizeof(hdr), rec[n].data, rec[n].len );
+        p += REC_SIZE(rec[n].len);
+    }
+
+    error = DataXfer( log, log->ck.tail, buf, total, 1 );
+    free( buf );
+
+    if( error )
+        return( error );
+
+    /*--- publish ---*/
+    log->ck.tail     = (log->ck.tail + total) % log->dataSize;
+    log->ck.seqTail += nRec;
+    log->used       += total;
+
+    return( CkptWrite( log ) );
+}
+
+/******************************* MMODPRG_LogRewind **************************
+ *
+ *  Description:  Set cursor to oldest record
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  log    log handle
+ *  Output.....:  cur    cursor
+ *  Globals....:  ---
+ ****************************************************************************/
+void MMODPRG_LogRewind(
+    MMODPRG_LOG *log,
+    MMODPRG_LOG_CURSOR *cur
+)
+{
+    cur->pos = log->ck.head;
+    cur->seq = log->ck.seqHead;
+}
+
+/****************************** MMODPRG_LogReadNext *************************
+ *
+ *  Description:  Read record at cursor and advance cursor
+ *
+ *                If the record at the cursor has been evicted meanwhile,
+ *                reading continues at the oldest record.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  log    log handle
+ *                cur    cursor
+ *                buf    data buffer
+ *                maxLen size of buf
+ *  Output.....:  cur    advanced cursor
+ *                buf    record data
+ *                lenP   data length
+ *                seqP   sequence number (may be NULL)
+ *                return success (0), MMODPRG_LOG_EOF or error code
+ *                       ERR_LL_USERBUF: buf too small, cursor not advanced
+ *                       ERR_LL_READ:    record corrupted
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_LogReadNext(
+    MMODPRG_LOG *log,
+    MMODPRG_LOG_CURSOR *cur,
+    void *buf,
+    u_int32 maxLen,
+    u_int32 *lenP,
+    u_int32 *seqP
+)
+{
+    LOG_REC hdr;
+    u_int32 pos, rest;
+    u_int32 last;
+    int32 error;
+
+    if( (int32)(cur->seq - log->ck.seqHead) < 0 )
+        MMODPRG_LogRewind( log, cur );
+
+    if( (int32)(cur->seq - log->ck.seqTail) >= 0 )
+        return( MMODPRG_LOG_EOF );
+
+    if( (error = DataXfer( log, cur->pos, &hdr, sizeof(hdr), 0 )) )
+        return( error );
+
+    if( hdr.seq != cur->seq || REC_SIZE(hdr.len) > log->used )
+        return( ERR_LL_READ );
+
+    if( hdr.len > maxLen )
+        return( ERR_LL_USERBUF );
+
+    /* whole words directly, last partial word via temp. */
+    pos  = (cur->pos + sizeof(hdr)) % log->dataSize;
+    rest = hdr.len & 3;
+
+    if( (error = DataXfer( log, pos, buf, hdr.len - rest, 0 )) )
+        return( error );
+
+    if( rest ) {
+        pos = (pos + hdr.len - rest) % log->dataSize;
+        if( (error = DataXfer( log, pos, &last, 4, 0 )) )
+            return( error );
+        memcpy( (u_int8*)buf + hdr.len - rest, &last, rest );
+    }
+
+    if( RecCrc( &hdr, buf ) != hdr.crc )
+        return( ERR_LL_READ );
+
+    cur->pos = (cur->pos + REC_SIZE(hdr.len)) % log->dataSize;
+    cur->seq++;
+
+    *lenP = hdr.len;
+    if( seqP )
+        *seqP = hdr.seq;
+
+    return( ERR_SUCCESS );
+}
+
+/******************************* MMODPRG_LogGetInfo *************************
+ *
+ *  Description:  Get log state
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  log    log handle
+ *  Output.....:  info   state
+ *  Globals....:  ---
+ ****************************************************************************/
+void MMODPRG_LogGetInfo(
+    MMODPRG_LOG *log,
+    MMODPRG_LOG_INFO *info
+)
+{
+    info->seqFirst  = log->ck.seqHead;
+    info->seqNext   = log->ck.seqTail;
+    info->used      = log->used;
+    info->avail     = log->dataSize - log->used - LOG_GAP;
+    info->recovered = log->recovered;
+}
+
+/********************************* CkptWrite ********************************
+ *
+ *  Description:  Write current state as next checkpoint
+ *
+ *                The slot not holding the newest checkpoint is written,
+ *                so a torn write leaves the newest checkpoint intact.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  log    log handle
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 CkptWrite( MMODPRG_LOG *log )
+{
+    log->ck.gen++;
+    log->ck.crc = MMODPRG_Crc32( 0, &log->ck, offsetof(LOG_CKPT, crc) );
+
+    return( MMODPRG_BurstWrite( log->path,
+                                log->base + (log->ck.gen % LOG_CKPT_SLOTS) *
+                                sizeof(LOG_CKPT),
+                                4, sizeof(LOG_CKPT) / 4, &log->ck ) );
+}
+
+/********************************** DataXfer ********************************
+ *
+ *  Description:  Transfer bytes from/to circular data area
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  log    log handle
+ *                pos    offset in data area (aligned to 4)
+ *                buf    data buffer
+ *                n      number of bytes (multiple of 4)
+ *                write  0=read, 1=write
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 DataXfer(
+    MMODPRG_LOG *log,
+    u_int32 pos,
+    void *buf,
+    u_int32 n,
+    int write
+)
+{
+    u_int32 addr = log->base + LOG_DATA_OFFS;
+    u_int32 first = log->dataSize - pos;
+    int32 error;
+
+    if( first > n )
+        first = n;
+
+    error = write ?
+        MMODPRG_BurstWrite( log->path, addr + pos, 4, first / 4, buf ) :
+        MMODPRG_BurstRead( log->path, addr + pos, 4, first / 4, buf );
+
+    if( error || first == n )
+        return( error );
+
+    /* wrapped part */
+    buf = (u_int8*)buf + first;
+    n  -= first;
+
+    return( write ? MMODPRG_BurstWrite( log->path, addr, 4, n / 4, buf ) :
+                    MMODPRG_BurstRead( log->path, addr, 4, n / 4, buf ) );
+}
+
+/********************************** RecCheck ********************************
+ *
+ *  Description:  Check for a valid record at a position
+ *
+ *                Used on open to find records behind the checkpoint. Data
+ *                is read in small chunks to compute the CRC.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  log    log handle
+ *                pos    offset in data area
+ *                maxRec max. record size (free space)
+ *                seq    expected sequence number
+ *  Output.....:  rec    record header
+ *                return success (0), ERR_LL_READ if no valid record or
+ *                       error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 RecCheck(
+    MMODPRG_LOG *log,
+    u_int32 pos,
+    u_int32 maxRec,
+    u_int32 seq,
+    LOG_REC *rec
+)
+{
+    u_int32 chunk[64];
+    u_int32 crc, done, n;
+    int32 error;
+
+    if( maxRec < sizeof(LOG_REC) )
+        return( ERR_LL_READ );
+
+    if( (error = DataXfer( log, pos, rec, sizeof(*rec), 0 )) )
+        return( error );
+
+    if( rec->seq != seq || rec->len > maxRec ||
+        REC_SIZE(rec->len) > maxRec )
+        return( ERR_LL_READ );
+
+    crc = MMODPRG_Crc32( 0, rec, offsetof(LOG_REC, crc) );
+    pos = (pos + sizeof(*rec)) % log->dataSize;
+
+    for( done=0; done < rec->len; done += n ) {
+        n = PAD4(rec->len - done);
+        if( n > sizeof(chunk) )
+            n = sizeof(chunk);
+
+        if( (error = DataXfer( log, pos, chunk, n, 0 )) )
+            return( error );
+
+        if( n > rec->len - done )
+            n = rec->len - done;
+
+        crc = MMODPRG_Crc32( crc, chunk, n );
+        pos = (pos + PAD4(n)) % log->dataSize;
+    }
+
+    return( crc == rec->crc ? ERR_SUCCESS : ERR_LL_READ );
+}
+
+/*********************************** RecCrc *********************************
+ *
+ *  Description:  Compute CRC of a record
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  rec    record header (len, seq)
+ *                data   record data
+ *  Output.....:  return CRC
+ *  Globals....:  ---
+ ****************************************************************************/
+static u_int32 RecCrc(
+    const LOG_REC *rec,
+    const void *data
+)
+{
+    return( MMODPRG_Crc32( MMODPRG_Crc32( 0, rec, offsetof(LOG_REC, crc) ),
+                           data, rec->len ) );
+}
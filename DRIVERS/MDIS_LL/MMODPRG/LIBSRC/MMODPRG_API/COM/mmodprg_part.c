@@ -0,0 +1,623 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************
+ *
+ *         Name: mmodprg_part.c
+ *      Project: MMODPRG user space API library
+ *
+ *       Author: kp
+ *
+ *  Description: Partition directory for sharing the SRAM between
+ *               applications
+ *
+ *               Layout of the SRAM:
+ *
+ *               0x0000            directory copy 0
+ *               dirSize           directory copy 1
+ *               2*dirSize         data area (partitions)
+ *
+ *               A directory copy is a PART_HDR (generation, geometry,
+ *               CRC-32 over header and entries) followed by maxEnt
+ *               MMODPRG_PART_ENT entries. Entries with an empty name are
+ *               unused. Updates are written to the copy not holding the
+ *               newest directory with the next generation number, so a
+ *               torn write leaves the previous directory valid.
+ *
+ *               Free space is the set of gaps between partitions, so it
+ *               is coalesced implicitly. Allocation is first fit.
+ *               Partitions are aligned to MMODPRG_PART_ALIGN bytes.
+ *
+ *               The directory is cached in the handle; lookups are served
+ *               from the cache. Each modifying call reloads the directory
+ *               first. Directory modifications of several processes must
+ *               be serialized by the applications.
+ *
+ *     Required: MDIS API, usr_oss
+ *     Switches: -
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2010-2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_api.h>
+#include <MEN/mdis_err.h>
+#include <MEN/usr_oss.h>
+#include <MEN/mmodprg_drv.h>
+#include <MEN/mmodprg_api.h>
+
+/*-----------------------------------------+
+|  DEFINES                                 |
++-----------------------------------------*/
+#define PART_MAGIC      0x50415231      /* "PAR1" */
+
+#define ALIGN(n)        (((n) + MMODPRG_PART_ALIGN - 1) & \
+                         ~(MMODPRG_PART_ALIGN - 1))
+#define DIR_SIZE(m)     ALIGN(sizeof(PART_HDR) + \
+                              (m) * sizeof(MMODPRG_PART_ENT))
+
+/*-----------------------------------------+
+|  TYPEDEFS                                |
++-----------------------------------------*/
+/* directory header */
+typedef struct {
+    u_int32 magic;          /* PART_MAGIC */
+    u_int32 gen;            /* generation, incremented per update */
+    u_int32 sramSize;       /* end of data area */
+    u_int32 maxEnt;         /* number of entries */
+    u_int32 reserved[3];
+    u_int32 crc;            /* CRC-32 of header fields above and entries */
+} PART_HDR;
+
+/* partition directory handle */
+struct MMODPRG_PART {
+    MDIS_PATH        path;
+    PART_HDR         hdr;       /* header of newest directory */
+    MMODPRG_PART_ENT *ent;      /* cached entries */
+    u_int32          dirSize;   /* bytes per directory copy */
+    u_int8           *buf;      /* directory copy buffer */
+};
+
+/*-----------------------------------------+
+|  PROTOTYPES                              |
++-----------------------------------------*/
+static int32 DirLoad( MMODPRG_PART *pt );
+static int32 DirStore( MMODPRG_PART *pt );
+static u_int32 DirCrc( const PART_HDR *hdr, const MMODPRG_PART_ENT *ent );
+static int32 EntFind( MMODPRG_PART *pt, const char *name );
+static int32 FirstFit( MMODPRG_PART *pt, u_int32 size, u_int32 *offsP );
+
+/******************************* MMODPRG_PartFormat *************************
+ *
+ *  Description:  Create an empty partition directory at SRAM start
+ *
+ *                All partitions are lost. The data area starts at
+ *                2 * directory size.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path     path of opened device
+ *                sramSize size of SRAM (e.g. from MMODPRG_SRAM_SIZE)
+ *                maxEnt   max. number of partitions
+ *                         (1..MMODPRG_PART_MAX_ENT)
+ *  Output.....:  return   success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_PartFormat(
+    MDIS_PATH path,
+    u_int32 sramSize,
+    u_int32 maxEnt
+)
+{
+    MMODPRG_PART pt;
+    PART_HDR empty;
+    int32 error;
+
+    if( maxEnt == 0 || maxEnt > MMODPRG_PART_MAX_ENT ||
+        sramSize <= 2 * DIR_SIZE(maxEnt) )
+        return( ERR_LL_ILL_PARAM );
+
+    memset( &pt, 0, sizeof(pt) );
+    pt.path         = path;
+    pt.dirSize      = DIR_SIZE(maxEnt);
+    pt.hdr.magic    = PART_MAGIC;
+    pt.hdr.sramSize = sramSize & ~(MMODPRG_PART_ALIGN - 1);
+    pt.hdr.maxEnt   = maxEnt;
+    pt.hdr.gen      = (u_int32)-1;
+
+    if( (pt.ent = (MMODPRG_PART_ENT*)calloc( maxEnt,
+                                             sizeof(MMODPRG_PART_ENT) ))
+        == NULL ||
+        (pt.buf = (u_int8*)malloc( pt.dirSize )) == NULL ) {
+        error = ERR_OSS_MEM_ALLOC;
+        goto CLEANUP;
+    }
+
+    /* invalidate copy 1, then write empty directory to copy 0 */
+    memset( &empty, 0, sizeof(empty) );
+    empty.maxEnt = maxEnt;
+    if( (error = MMODPRG_BurstWrite( path, pt.dirSize, 4, sizeof(empty) / 4,
+                                     &empty )) )
+        goto CLEANUP;
+
+    error = DirStore( &pt );
+
+ CLEANUP:
+    free( pt.ent );
+    free( pt.buf );
+    return( error );
+}
+
+/******************************** MMODPRG_PartOpen **************************
+ *
+ *  Description:  Open partition directory and load it into the cache
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *  Output.....:  ptP    directory handle
+ *                return success (0) or error code
+ *                       ERR_LL_READ: no valid directory
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_PartOpen(
+    MDIS_PATH path,
+    MMODPRG_PART **ptP
+)
+{
+    MMODPRG_PART *pt;
+    PART_HDR hdr;
+    int32 error;
+
+    *ptP = NULL;
+
+    /* geometry (maxEnt is never changed after format) */
+    if( (error = MMODPRG_BurstRead( path, 0, 4, sizeof(hdr) / 4, &hdr )) )
+        return( error );
+
+    if( hdr.maxEnt == 0 || hdr.maxEnt > MMODPRG_PART_MAX_ENT )
+        return( ERR_LL_READ );
+
+    if( (pt = (MMODPRG_PART*)calloc( 1, sizeof(*pt) )) == NULL )
+        return( ERR_OSS_MEM_ALLOC );
+
+    pt->path    = path;
+    pt->dirSize = DIR_SIZE(hdr.maxEnt);
+    pt->hdr     = hdr;
+    pt->ent     = (MMODPRG_PART_ENT*)calloc( hdr.maxEnt,
+                                             sizeof(MMODPRG_PART_ENT) );
+    pt->buf     = (u_int8*)malloc( pt->dirSize );
+
+    if( !pt->ent || !pt->buf )
+        error = ERR_OSS_MEM_ALLOC;
+    else
+        error = DirLoad( pt );
+
+    if( error ) {
+        MMODPRG_PartClose( pt );
+        return( error );
+    }
+
+    *ptP = pt;
+    return( ERR_SUCCESS );
+}
+
+/******************************* MMODPRG_PartClose **************************
+ *
+ *  Description:  Close partition directory handle
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  pt     directory handle
+ *  Output.....:  return success (0)
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_PartClose( MMODPRG_PART *pt )
+{
+    free( pt->ent );
+    free( pt->buf );
+    free( pt );
+
+    return( ERR_SUCCESS );
+}
+
+/****************************** MMODPRG_PartRefresh *************************
+ *
+ *  Description:  Reload directory cache
+ *
+ *                Needed only if other processes may have changed the
+ *                directory since open.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  pt     directory handle
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_PartRefresh( MMODPRG_PART *pt )
+{
+    return( DirLoad( pt ) );
+}
+
+/******************************* MMODPRG_PartLookup *************************
+ *
+ *  Description:  Look up a partition by name
+ *
+ *                Served from the cache, no bus access.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  pt     directory handle
+ *                name   partition name
+ *  Output.....:  ent    partition entry
+ *                return success (0) or MMODPRG_PART_NOTFOUND
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_PartLookup(
+    MMODPRG_PART *pt,
+    const char *name,
+    MMODPRG_PART_ENT *ent
+)
+{
+    int32 i;
+
+    if( (i = EntFind( pt, name )) < 0 )
+        return( MMODPRG_PART_NOTFOUND );
+
+    *ent = pt->ent[i];
+    return( ERR_SUCCESS );
+}
+
+/******************************* MMODPRG_PartCreate *************************
+ *
+ *  Description:  Create a partition
+ *
+ *                The partition is placed into the first gap that is large
+ *                enough. Its content is undefined.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  pt     directory handle
+ *                name   partition name (< MMODPRG_PART_NAME_LEN chars)
+ *                size   size [bytes], rounded up to MMODPRG_PART_ALIGN
+ *                owner  owner id (application defined)
+ *  Output.....:  ent    partition entry (may be NULL)
+ *                return success (0), MMODPRG_PART_EXISTS,
+ *                       MMODPRG_PART_NOSPACE or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_PartCreate(
+    MMODPRG_PART *pt,
+    const char *name,
+    u_int32 size,
+    u_int32 owner,
+    MMODPRG_PART_ENT *ent
+)
+{
+    u_int32 i, offs;
+    int32 error;
+
+    if( *name == '\0' || strlen(name) >= MMODPRG_PART_NAME_LEN || size == 0 )
+        return( ERR_LL_ILL_PARAM );
+
+    if( (error = DirLoad( pt )) )
+        return( error );
+
+    if( EntFind( pt, name ) >= 0 )
+        return( MMODPRG_PART_EXISTS );
+
+    for( i=0; i<pt->hdr.maxEnt && pt->ent[i].name[0]; i++ )
+        ;
+    if( i == pt->hdr.maxEnt )
+        return( MMODPRG_PART_NOSPACE );
+
+    size = ALIGN(size);
+    if( (error = FirstFit( pt, size, &offs )) )
+        return( error );
+
+    memset( &pt->ent[i], 0, sizeof(pt->ent[i]) );
+    strcpy( pt->ent[i].name, name );
+    pt->ent[i].offset  = offs;
+    pt->ent[i].size    = size;
+    pt->ent[i].owner   = owner;
+    pt->ent[i].version = 1;
+
+    if( (error = DirStore( pt )) )
+        return( error );
+
+    if( ent )
+        *ent = pt->ent[i];
+
+    return( ERR_SUCCESS );
+}
+
+/******************************* MMODPRG_PartResize *************************
+ *
+ *  Description:  Change size of a partition
+ *
+ *                If the partition can't grow in place, it is moved to the
+ *                first gap that is large enough and its content is copied
+ *                before the directory is updated. The version of the
+ *                partition is incremented, so users can detect moves.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  pt      directory handle
+ *                name    partition name
+ *                newSize new size [bytes], rounded up to MMODPRG_PART_ALIGN
+ *  Output.....:  ent     partition entry (may be NULL)
+ *                return  success (0), MMODPRG_PART_NOTFOUND,
+ *                        MMODPRG_PART_NOSPACE or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_PartResize(
+    MMODPRG_PART *pt,
+    const char *name,
+    u_int32 newSize,
+    MMODPRG_PART_ENT *ent
+)
+{
+    MMODPRG_PART_ENT *e;
+    u_int32 i, limit, offs;
+    int32 n, error;
+
+    if( newSize == 0 )
+        return( ERR_LL_ILL_PARAM );
+
+    if( (error = DirLoad( pt )) )
+        return( error );
+
+    if( (n = EntFind( pt, name )) < 0 )
+        return( MMODPRG_PART_NOTFOUND );
+
+    e = &pt->ent[n];
+    newSize = ALIGN(newSize);
+
+    /*--- end of gap behind the partition ---*/
+    limit = pt->hdr.sramSize;
+    for( i=0; i<pt->hdr.maxEnt; i++ ) {
+        if( pt->ent[i].name[0] && pt->ent[i].offset > e->offset &&
+            pt->ent[i].offset < limit )
+            limit = pt->ent[i].offset;
+    }
+
+    if( e->offset + newSize > limit ) {
+        /* move (old place stays occupied, so a crash keeps old data) */
+        if( (error = FirstFit( pt, newSize, &offs )) )
+            return( error );
+
+        if( (error = MMODPRG_Copy( pt->path, offs, e->offset, e->size )) )
+            return( error );
+
+        e->offset = offs;
+    }
+
+    e->size = newSize;
+    e->version++;
+
+    if( (error = DirStore( pt )) )
+        return( error );
+
+    if( ent )
+        *ent = *e;
+
+    return( ERR_SUCCESS );
+}
+
+/******************************* MMODPRG_PartDelete *************************
+ *
+ *  Description:  Delete a partition
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  pt     directory handle
+ *                name   partition name
+ *  Output.....:  return success (0), MMODPRG_PART_NOTFOUND or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_PartDelete(
+    MMODPRG_PART *pt,
+    const char *name
+)
+{
+    int32 n, error;
+
+    if( (error = DirLoad( pt )) )
+        return( error );
+
+    if( (n = EntFind( pt, name )) < 0 )
+        return( MMODPRG_PART_NOTFOUND );
+
+    memset( &pt->ent[n], 0, sizeof(pt->ent[n]) );
+
+    return( DirStore( pt ) );
+}
+
+/******************************* MMODPRG_PartList ***************************
+ *
+ *  Description:  Get cached partition entries
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  pt     directory handle
+ *                ent    entry buffer
+ *                maxEnt size of ent
+ *  Output.....:  ent    used entries
+ *                return number of entries stored
+ *  Globals....:  ---
+ ****************************************************************************/
+int MMODPRG_PartList(
+    MMODPRG_PART *pt,
+    MMODPRG_PART_ENT *ent,
+    int maxEnt
+)
+{
+    u_int32 i;
+    int n = 0;
+
+    for( i=0; i<pt->hdr.maxEnt && n<maxEnt; i++ )
+        if( pt->ent[i].name[0] )
+            ent[n++] = pt->ent[i];
+
+    return( n );
+}
+
+/********************************** DirLoad *********************************
+ *
+ *  Description:  Load newest valid directory copy into cache
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  pt     directory handle
+ *  Output.....:  return success (0) or error code
+ *                       ERR_LL_READ: no valid copy
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 DirLoad( MMODPRG_PART *pt )
+{
+    PART_HDR *hdr = (PART_HDR*)pt->buf;
+    MMODPRG_PART_ENT *ent = (MMODPRG_PART_ENT*)(hdr + 1);
+    u_int32 c, maxEnt = pt->hdr.maxEnt;
+    int32 error, found = 0;
+
+    for( c=0; c<2; c++ ) {
+        if( (error = MMODPRG_BurstRead( pt->path, c * pt->dirSize, 4,
+                                        pt->dirSize / 4, pt->buf )) )
+            return( error );
+
+        if( hdr->magic != PART_MAGIC || hdr->maxEnt != maxEnt ||
+            hdr->crc != DirCrc( hdr, ent ) )
+            continue;
+
+        if( !found || (int32)(hdr->gen - pt->hdr.gen) > 0 ) {
+            pt->hdr = *hdr;
+            memcpy( pt->ent, ent, maxEnt * sizeof(MMODPRG_PART_ENT) );
+            found = 1;
+        }
+    }
+
+    return( found ? ERR_SUCCESS : ERR_LL_READ );
+}
+
+/********************************** DirStore ********************************
+ *
+ *  Description:  Write cache as next directory generation
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  pt     directory handle
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 DirStore( MMODPRG_PART *pt )
+{
+    PART_HDR *hdr = (PART_HDR*)pt->buf;
+    MMODPRG_PART_ENT *ent = (MMODPRG_PART_ENT*)(hdr + 1);
+
+    pt->hdr.gen++;
+    pt->hdr.crc = DirCrc( &pt->hdr, pt->ent );
+
+    memset( pt->buf, 0, pt->dirSize );
+    *hdr = pt->hdr;
+    memcpy( ent, pt->ent, pt->hdr.maxEnt * sizeof(MMODPRG_PART_ENT) );
+
+    return( MMODPRG_BurstWrite( pt->path, (pt->hdr.gen & 1) * pt->dirSize, 4,
+                                pt->dirSize / 4, pt->buf ) );
+}
+
+/*********************************** DirCrc *********************************
+ *
+ *  Description:  Compute CRC of a directory copy
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  hdr    header
+ *                ent    entries (hdr->maxEnt)
+ *  Output.....:  return CRC
+ *  Globals....:  ---
+ ****************************************************************************/
+static u_int32 DirCrc(
+    const PART_HDR *hdr,
+    const MMODPRG_PART_ENT *ent
+)
+{
+    u_int32 crc;
+
+    crc = MMODPRG_Crc32( 0, hdr, offsetof(PART_HDR, crc) );
+    return( MMODPRG_Crc32( crc, ent, hdr->maxEnt * sizeof(*ent) ) );
+}
+
+/********************************** EntFind *********************************
+ *
+ *  Description:  Find entry of a partition in cache
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  pt     directory handle
+ *                name   partition name
+ *  Output.....:  return entry index or -1
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 EntFind(
+    MMODPRG_PART *pt,
+    const char *name
+)
+{
+    u_int32 i;
+
+    if( *name == '\0' )
+        return( -1 );
+
+    for( i=0; i<pt->hdr.maxEnt; i++ )
+        if( !strncmp( pt->ent[i].name, name, MMODPRG_PART_NAME_LEN ) )
+            return( i );
+
+    return( -1 );
+}
+
+/********************************** FirstFit ********************************
+ *
+ *  Description:  Find lowest gap between partitions of at least size bytes
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  pt     directory handle
+ *                size   required size (aligned)
+ *  Output.....:  offsP  start of gap
+ *                return success (0) or MMODPRG_PART_NOSPACE
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 FirstFit(
+    MMODPRG_PART *pt,
+    u_int32 size,
+    u_int32 *offsP
+)
+{
+    u_int32 cur = 2 * pt->dirSize, next, end, i;
+
+    /* visit partitions in address order, starting behind the directory */
+    for( ;; ) {
+        next = pt->hdr.sramSize;
+        end  = cur;
+
+        for( i=0; i<pt->hdr.maxEnt; i++ ) {
+            if( pt->ent[i].name[0] && pt->ent[i].offset >= cur &&
+                pt->ent[i].offset < next ) {
+                next = pt->ent[i].offset;
+                end  = next + pt->ent[i].size;
+            }
+        }
+
+        if( next - cur >= size ) {
+            *offsP = cur;
+            return( ERR_SUCCESS );
+        }
+
+        if( next == pt->hdr.sramSize )
+            return( MMODPRG_PART_NOSPACE );
+
+        cur = end;
+    }
+}
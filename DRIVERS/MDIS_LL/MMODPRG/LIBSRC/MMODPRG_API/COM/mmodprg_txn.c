@@ -0,0 +1,500 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************
+ *
+ *         Name: mmodprg_txn.c
+ *      Project: MMODPRG user space API library
+ *
+ *       Author: kp
+ *
+ *  Description: Atomic update of small structures in the address window
+ *
+ *               Layout of a transaction object at base
+ *               (MMODPRG_TXN_SIZE(maxLen) bytes):
+ *
+ *               base+0x00  control word: sequence number of active slot
+ *               base+0x04  lock word: pid of committing process, 0=free
+ *               base+0x08  TXN_MAGIC
+ *               base+0x0c  maxLen
+ *               base+0x10  slot 0
+ *               base+0x10+slotSize  slot 1
+ *
+ *               A slot is a TXN_SLOT header (sequence number, length,
+ *               CRC-32 over sequence number, length and data) followed by
+ *               maxLen data bytes, padded to 4. The active slot is the one
+ *               with index (sequence number & 1).
+ *
+ *               Commit writes the inactive slot with the next sequence
+ *               number in one burst and then flips the control word with
+ *               one 32 bit write. A power loss before the flip leaves the
+ *               previous state active.
+ *
+ *               Readers read the control word, the active slot and the
+ *               control word again and retry if it has changed, i.e. if a
+ *               commit happened meanwhile (seqlock). No lock is held
+ *               between these accesses.
+ *
+ *               Commits are serialized across handles and processes by
+ *               the lock word, which is claimed and released with a
+ *               compare-and-swap micro-sequence (MMODPRG_BLK_SEQ runs
+ *               without interruption by other driver calls). A lock left
+ *               by a terminated process is taken over. The flip is done
+ *               with the same compare-and-swap and fails with
+ *               ERR_LL_DEV_BUSY if the control word changed meanwhile,
+ *               e.g. by a writer that ignores the lock.
+ *
+ *     Required: MDIS API, usr_oss, pthread
+ *     Switches: -
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2010-2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_api.h>
+#include <MEN/mdis_err.h>
+#include <MEN/usr_oss.h>
+#include <MEN/mmodprg_drv.h>
+#include <MEN/mmodprg_api.h>
+
+/*-----------------------------------------+
+|  DEFINES                                 |
++-----------------------------------------*/
+#define PAD4(n)         (((n) + 3) & ~3)
+#define SLOT_SIZE(max)  (sizeof(TXN_SLOT) + PAD4(max))
+#define SLOT_OFFS(tx,i) ((tx)->base + sizeof(TXN_HDR) + \
+                         (i) * SLOT_SIZE((tx)->maxLen))
+
+#define TXN_MAGIC       0x54584e31      /* "TXN1" */
+#define OFFS_LOCK       offsetof(TXN_HDR, lock)
+
+/*-----------------------------------------+
+|  TYPEDEFS                                |
++-----------------------------------------*/
+/* object header */
+typedef struct {
+    u_int32 ctrl;           /* sequence number of active slot */
+    u_int32 lock;           /* pid of committing process, 0=free */
+    u_int32 magic;          /* TXN_MAGIC */
+    u_int32 maxLen;         /* max. data length */
+} TXN_HDR;
+
+/* slot header */
+typedef struct {
+    u_int32 seq;            /* sequence number of this state */
+    u_int32 len;            /* data length [bytes] */
+    u_int32 crc;            /* CRC-32 of seq, len and data */
+} TXN_SLOT;
+
+/* slot buffer */
+typedef struct {
+    TXN_SLOT hdr;
+    u_int32  data[MMODPRG_TXN_MAX_LEN / 4];
+} TXN_BUF;
+
+/* transaction object handle */
+struct MMODPRG_TXN {
+    MDIS_PATH       path;
+    u_int32         base;       /* start of object */
+    u_int32         maxLen;     /* max. data length */
+    pthread_mutex_t lock;       /* serializes commits */
+};
+
+/*-----------------------------------------+
+|  PROTOTYPES                              |
++-----------------------------------------*/
+static u_int32 SlotCrc( const TXN_BUF *slot );
+static int32 Cas32( MDIS_PATH path, u_int32 offs, u_int32 expect,
+                    u_int32 val, u_int32 *oldP );
+static int32 LockClaim( MMODPRG_TXN *tx );
+
+/******************************** MMODPRG_TxnFormat *************************
+ *
+ *  Description:  Initialize a transaction object with empty data
+ *
+ *                The object occupies MMODPRG_TXN_SIZE(maxLen) bytes.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                base   start offset of object (aligned to 4)
+ *                maxLen max. data length (1..MMODPRG_TXN_MAX_LEN)
+ *  Output.....:  return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_TxnFormat(
+    MDIS_PATH path,
+    u_int32 base,
+    u_int32 maxLen
+)
+{
+    TXN_HDR hdr;
+    TXN_BUF slot;
+    int32 error;
+
+    if( (base & 3) || maxLen == 0 || maxLen > MMODPRG_TXN_MAX_LEN )
+        return( ERR_LL_ILL_PARAM );
+
+    memset( &slot, 0, sizeof(slot) );
+    slot.hdr.crc = SlotCrc( &slot );
+
+    /* slot 0 with sequence number 0, then header (activates slot 0) */
+    if( (error = MMODPRG_BurstWrite( path, base + sizeof(hdr), 4,
+                                     SLOT_SIZE(maxLen) / 4, &slot )) )
+        return( error );
+
+    hdr.ctrl   = 0;
+    hdr.lock   = 0;
+    hdr.magic  = TXN_MAGIC;
+    hdr.maxLen = maxLen;
+
+    return( MMODPRG_BurstWrite( path, base, 4, sizeof(hdr) / 4, &hdr ) );
+}
+
+/********************************* MMODPRG_TxnOpen **************************
+ *
+ *  Description:  Open a transaction object
+ *
+ *                The object must lie within the address window and have
+ *                been formatted with the same maxLen.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                base   start offset of object
+ *                maxLen max. data length (as passed to MMODPRG_TxnFormat)
+ *  Output.....:  txP    object handle
+ *                return success (0) or error code
+ *                       ERR_LL_ILL_PARAM: object exceeds address window
+ *                       ERR_LL_READ:      no valid object at base
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_TxnOpen(
+    MDIS_PATH path,
+    u_int32 base,
+    u_int32 maxLen,
+    MMODPRG_TXN **txP
+)
+{
+    MMODPRG_TXN *tx;
+    TXN_HDR hdr;
+    int32 winSize, error;
+
+    *txP = NULL;
+
+    if( (base & 3) || maxLen == 0 || maxLen > MMODPRG_TXN_MAX_LEN )
+        return( ERR_LL_ILL_PARAM );
+
+    if( M_getstat( path, MMODPRG_WIN_SIZE, &winSize ) < 0 )
+        return( UOS_ErrnoGet() );
+
+    if( base > (u_int32)winSize ||
+        MMODPRG_TXN_SIZE(maxLen) > (u_int32)winSize - base )
+        return( ERR_LL_ILL_PARAM );
+
+    if( (error = MMODPRG_BurstRead( path, base, 4, sizeof(hdr) / 4, &hdr )) )
+        return( error );
+
+    if( hdr.magic != TXN_MAGIC || hdr.maxLen != maxLen )
+        return( ERR_LL_READ );
+
+    if( (tx = (MMODPRG_TXN*)calloc( 1, sizeof(*tx) )) == NULL )
+        return( ERR_OSS_MEM_ALLOC );
+
+    tx->path   = path;
+    tx->base   = base;
+    tx->maxLen = maxLen;
+    pthread_mutex_init( &tx->lock, NULL );
+
+    *txP = tx;
+    return( ERR_SUCCESS );
+}
+
+/******************************** MMODPRG_TxnClose **************************
+ *
+ *  Description:  Close a transaction object handle
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  tx     object handle
+ *  Output.....:  return success (0)
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_TxnClose( MMODPRG_TXN *tx )
+{
+    pthread_mutex_destroy( &tx->lock );
+    free( tx );
+
+    return( ERR_SUCCESS );
+}
+
+/******************************* MMODPRG_TxnCommit **************************
+ *
+ *  Description:  Atomically replace the data of a transaction object
+ *
+ *                The lock word is claimed, the inactive slot is written in
+ *                one burst and the control word is flipped with one 32 bit
+ *                compare-and-swap, then the lock word is released.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  tx     object handle
+ *                data   new data
+ *                len    data length (0..maxLen)
+ *  Output.....:  return success (0) or error code
+ *                       ERR_LL_DEV_BUSY: lock not free within
+ *                       MMODPRG_TXN_MAX_RETRY ms, or control word changed
+ *                       by another writer (data not committed)
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_TxnCommit(
+    MMODPRG_TXN *tx,
+    const void *data,
+    u_int32 len
+)
+{
+    TXN_BUF slot;
+    u_int32 seq, old;
+    int32 error, error2;
+
+    if( len > tx->maxLen )
+        return( ERR_LL_ILL_PARAM );
+
+    pthread_mutex_lock( &tx->lock );
+
+    if( (error = LockClaim( tx )) )
+        goto UNLOCK;
+
+    if( MMODPRG_GetD32( tx->path, tx->base, &seq ) ) {
+        error = UOS_ErrnoGet();
+        goto RELEASE;
+    }
+
+    memset( &slot, 0, SLOT_SIZE(tx->maxLen) );
+    slot.hdr.seq = ++seq;
+    slot.hdr.len = len;
+    memcpy( slot.data, data, len );
+    slot.hdr.crc = SlotCrc( &slot );
+
+    if( (error = MMODPRG_BurstWrite( tx->path, SLOT_OFFS(tx, seq & 1), 4,
+                                     SLOT_SIZE(tx->maxLen) / 4, &slot )) )
+        goto RELEASE;
+
+    /*--- flip, if nobody else did ---*/
+    if( (error = Cas32( tx->path, tx->base, seq - 1, seq, &old )) == 0 &&
+        old != seq - 1 )
+        error = ERR_LL_DEV_BUSY;
+
+ RELEASE:
+    error2 = Cas32( tx->path, tx->base + OFFS_LOCK, (u_int32)getpid(), 0,
+                    &old );
+    if( !error )
+        error = error2;
+
+ UNLOCK:
+    pthread_mutex_unlock( &tx->lock );
+    return( error );
+}
+
+/******************************** MMODPRG_TxnRead ***************************
+ *
+ *  Description:  Read consistent data of a transaction object
+ *
+ *                The active slot is read between two reads of the control
+ *                word. If a commit happened meanwhile, the read is
+ *                retried (up to MMODPRG_TXN_MAX_RETRY times).
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  tx       object handle
+ *                buf      data buffer
+ *                maxLen   size of buf
+ *  Output.....:  buf      data
+ *                lenP     data length
+ *                retriesP number of retries (may be NULL)
+ *                return   success (0) or error code
+ *                         ERR_LL_USERBUF:  buf too small
+ *                         ERR_LL_DEV_BUSY: no consistent read possible
+ *                         ERR_LL_READ:     active slot corrupted
+ *  Globals....:  ---
+ ****************************************************************************/
+int32 MMODPRG_TxnRead(
+    MMODPRG_TXN *tx,
+    void *buf,
+    u_int32 maxLen,
+    u_int32 *lenP,
+    u_int32 *retriesP
+)
+{
+    TXN_BUF slot;
+    u_int32 seq, seq2, retries;
+    int32 error;
+
+    for( retries=0; retries <= MMODPRG_TXN_MAX_RETRY; retries++ ) {
+        if( MMODPRG_GetD32( tx->path, tx->base, &seq ) )
+            return( UOS_ErrnoGet() );
+
+        if( (error = MMODPRG_BurstRead( tx->path, SLOT_OFFS(tx, seq & 1), 4,
+                                        SLOT_SIZE(tx->maxLen) / 4, &slot )) )
+            return( error );
+
+        if( MMODPRG_GetD32( tx->path, tx->base, &seq2 ) )
+            return( UOS_ErrnoGet() );
+
+        if( seq2 != seq )
+            continue;                   /* commit in between */
+
+        if( retriesP )
+            *retriesP = retries;
+
+        if( slot.hdr.seq != seq || slot.hdr.len > tx->maxLen ||
+            slot.hdr.crc != SlotCrc( &slot ) )
+            return( ERR_LL_READ );
+
+        if( slot.hdr.len > maxLen )
+            return( ERR_LL_USERBUF );
+
+        memcpy( buf, slot.data, slot.hdr.len );
+        *lenP = slot.hdr.len;
+
+        return( ERR_SUCCESS );
+    }
+
+    if( retriesP )
+        *retriesP = retries;
+
+    return( ERR_LL_DEV_BUSY );
+}
+
+/********************************* LockClaim ********************************
+ *
+ *  Description:  Claim the lock word of an object for this process
+ *
+ *                Retries every ms while another process holds the lock.
+ *                The lock of a process that no longer exists is taken
+ *                over.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  tx     object handle
+ *  Output.....:  return success (0) or error code
+ *                       ERR_LL_DEV_BUSY: lock not free
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 LockClaim( MMODPRG_TXN *tx )
+{
+    u_int32 me = (u_int32)getpid(), old, stale, retries;
+    int32 error;
+
+    for( retries=0; retries <= MMODPRG_TXN_MAX_RETRY; retries++ ) {
+        if( (error = Cas32( tx->path, tx->base + OFFS_LOCK, 0, me, &old )) )
+            return( error );
+        if( old == 0 )
+            return( ERR_SUCCESS );
+
+        /* owner terminated without release */
+        if( old != me && kill( (pid_t)old, 0 ) < 0 && errno == ESRCH ) {
+            stale = old;
+            if( (error = Cas32( tx->path, tx->base + OFFS_LOCK, stale, me,
+                                &old )) )
+                return( error );
+            if( old == stale )
+                return( ERR_SUCCESS );
+        }
+        UOS_Delay( 1 );
+    }
+
+    return( ERR_LL_DEV_BUSY );
+}
+
+/*********************************** Cas32 **********************************
+ *
+ *  Description:  Compare-and-swap a 32 bit word
+ *
+ *                Runs as one micro-sequence, i.e. without interruption by
+ *                other driver calls on the device:
+ *                  old = *offs; if( old == expect ) *offs = val;
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  path   path of opened device
+ *                offs   offset of word
+ *                expect expected value
+ *                val    new value
+ *  Output.....:  oldP   value read
+ *                return success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 Cas32(
+    MDIS_PATH path,
+    u_int32 offs,
+    u_int32 expect,
+    u_int32 val,
+    u_int32 *oldP
+)
+{
+    u_int32 buf[(MMODPRG_SEQ_SIZE(4, 1) + 3) / 4];
+    MMODPRG_SEQ_HDR *hdr = (MMODPRG_SEQ_HDR*)buf;
+    MMODPRG_SEQ_OP *op = (MMODPRG_SEQ_OP*)(hdr + 1);
+    M_SG_BLOCK blk;
+
+    memset( buf, 0, sizeof(buf) );
+    hdr->nOps     = 4;
+    hdr->nResults = 1;
+
+    op[0].op     = MMODPRG_SEQ_READ;
+    op[0].width  = 4;
+    op[0].arg    = 0;
+    op[0].offset = offs;
+
+    op[1].op     = MMODPRG_SEQ_BNE;
+    op[1].arg    = 3;
+    op[1].value  = expect;
+    op[1].mask   = 0xffffffff;
+
+    op[2].op     = MMODPRG_SEQ_WRITE;
+    op[2].width  = 4;
+    op[2].offset = offs;
+    op[2].value  = val;
+
+    op[3].op     = MMODPRG_SEQ_END;
+
+    blk.size = MMODPRG_SEQ_SIZE(4, 1);
+    blk.data = (void*)buf;
+
+    if( M_getstat( path, MMODPRG_BLK_SEQ, (int32*)&blk ) < 0 )
+        return( UOS_ErrnoGet() );
+
+    *oldP = *(u_int32*)(op + 4);
+    return( ERR_SUCCESS );
+}
+
+/********************************** SlotCrc *********************************
+ *
+ *  Description:  Compute CRC of a slot
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  slot   slot (header and data)
+ *  Output.....:  return CRC
+ *  Globals....:  ---
+ ****************************************************************************/
+static u_int32 SlotCrc( const TXN_BUF *slot )
+{
+    u_int32 crc;
+
+    crc = MMODPRG_Crc32( 0, &slot->hdr, offsetof(TXN_SLOT, crc) );
+    return( MMODPRG_Crc32( crc, slot->data, slot->hdr.len ) );
+}
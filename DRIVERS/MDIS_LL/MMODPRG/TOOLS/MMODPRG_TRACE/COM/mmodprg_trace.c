@@ -0,0 +1,536 @@
+/****************************************************************************
+ ************                                                    ************
+ ************                   MMODPRG_TRACE                    ************
+ ************                                                    ************
+ ****************************************************************************/
+/*!
+ *         \file mmodprg_trace.c
+ *       \author kp
+ *
+ *        \brief Capture and replay access traces of MMODPRG devices
+ *
+ *               Capture starts the driver's trace ring (MMODPRG_TRC_START),
+ *               drains it periodically (MMODPRG_BLK_TRC) and writes the
+ *               records to a trace file: a TRC_FHDR followed by the
+ *               MMODPRG_TRC_ENT records in the byte order of the capturing
+ *               host. Replay swaps files written on other endianness.
+ *
+ *               Replay re-issues the recorded single accesses against a
+ *               device (one path per recorded channel) or against a RAM
+ *               stand-in, as fast as possible or with the original timing,
+ *               and reports throughput and latency percentiles. Block
+ *               operations are recorded with code and length only; they
+ *               keep their place in the timing but are not re-issued.
+ *
+ *     Required: libraries: mdis_api, usr_oss, usr_utl
+ *               drivers:   mmodprg
+ *     \switches see usage()
+ */
+ /*
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <MEN/men_typs.h>
+#include <MEN/usr_oss.h>
+#include <MEN/usr_utl.h>
+#include <MEN/mdis_api.h>
+#include <MEN/mdis_err.h>
+#include <MEN/mmodprg_drv.h>
+
+static const char IdentString[]=MENT_XSTR(MAK_REVISION);
+
+/*--------------------------------------+
+|   DEFINES                             |
++--------------------------------------*/
+#define TRC_MAGIC        0x4d545243     /* "MTRC" */
+#define TRC_VERSION      2
+#define TRC_BYTEORDER    0x01020304     /* as written by capturing host */
+#define TRC_BYTEORDER_SW 0x04030201     /* captured on other endianness */
+
+#define DRAIN_ENT        256            /* records per MMODPRG_BLK_TRC */
+#define DRAIN_MS         10             /* capture poll interval [ms] */
+
+/*--------------------------------------+
+|   TYPDEFS                             |
++--------------------------------------*/
+/* trace file header */
+typedef struct {
+    u_int32 magic;                      /* TRC_MAGIC */
+    u_int32 version;                    /* TRC_VERSION */
+    u_int32 byteOrder;                  /* TRC_BYTEORDER */
+    u_int32 timeRes;                    /* timestamp resolution [us] */
+    u_int32 nEnt;                       /* number of records */
+    u_int32 lost;                       /* records lost during capture */
+    u_int32 reserved[2];
+} TRC_FHDR;
+
+/* replay target */
+typedef struct {
+    char       *device;                 /* device name, NULL=RAM stand-in */
+    MDIS_PATH  path[MMODPRG_CTX_NUM];   /* path per channel, -1=not open */
+    u_int8     *ram;                    /* RAM stand-in */
+    u_int32    ramSize;                 /* RAM stand-in size [bytes] */
+} TARGET;
+
+/*--------------------------------------+
+|   PROTOTYPES                          |
++--------------------------------------*/
+static int Capture( char *device, char *file, u_int32 nEnt, u_int32 sec );
+static int Replay( TARGET *tgt, char *file, int timed, u_int32 loops );
+static int Issue( TARGET *tgt, const MMODPRG_TRC_ENT *e, u_int32 *valP );
+
+/********************************* usage ************************************
+ *
+ *  Description: Print program usage
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: -
+ *  Output.....: -
+ *  Globals....: -
+ ****************************************************************************/
+static void usage(void)
+{
+    printf("Usage: mmodprg_trace [<opts>] [<device>] [<opts>]\n");
+    printf("Function: Capture/replay access traces of MMODPRG "
+           "devices\n");
+    printf("Options:\n");
+    printf("  -c=<file>    capture trace of <device> to file\n");
+    printf("  -n=<n>       capture: trace ring capacity [records]... [4096]\n");
+    printf("  -t=<sec>     capture: duration, 0=until key pressed... [10]\n");
+    printf("  -p=<file>    replay trace file against <device>\n");
+    printf("  -m=<size>    replay: use RAM stand-in of <size> bytes (hex)\n");
+    printf("               instead of <device>\n");
+    printf("  -o           replay: original timing.............. "
+           "[as fast as possible]\n");
+    printf("  -l=<n>       replay: number of passes............. [1]\n");
+    printf("\n");
+    printf("Copyright 2019, MEN Mikro Elektronik GmbH\n%s\n", IdentString);
+}
+
+/********************************* main *************************************
+ *
+ *  Description: Program main function
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: argc,argv  argument counter, data ..
+ *  Output.....: return     success (0) or error (1)
+ *  Globals....: -
+ ****************************************************************************/
+int main(int argc, char *argv[])
+{
+    TARGET  tgt;
+    char    buf[80];
+    char    *str, *errstr, *device = NULL, *capFile, *repFile;
+    u_int32 nEnt, sec;
+    int     n, ret;
+
+    /*--------------------+
+    |  check arguments    |
+    +--------------------*/
+    if ((errstr = UTL_ILLIOPT("c=n=t=p=m=ol=?", buf))) {
+        printf("*** %s\n", errstr);
+        return(1);
+    }
+
+    if (UTL_TSTOPT("?")) {
+        usage();
+        return(1);
+    }
+
+    for (n=1; n<argc; n++)
+        if (*argv[n] != '-')
+            device = argv[n];
+
+    capFile = UTL_TSTOPT("c=");
+    repFile = UTL_TSTOPT("p=");
+
+    memset( &tgt, 0, sizeof(tgt) );
+    if( (str = UTL_TSTOPT("m=")) )
+        tgt.ramSize = strtoul(str, NULL, 16);
+
+    if( !capFile == !repFile ||
+        (capFile && device == NULL) ||
+        (repFile && device == NULL && tgt.ramSize == 0) ) {
+        usage();
+        return(1);
+    }
+
+    if( capFile ) {
+        nEnt = (str = UTL_TSTOPT("n=")) ? atoi(str) : 4096;
+        sec  = (str = UTL_TSTOPT("t=")) ? atoi(str) : 10;
+        return( Capture( device, capFile, nEnt, sec ) );
+    }
+
+    /*--------------------+
+    |  replay             |
+    +--------------------*/
+    for( n=0; n<MMODPRG_CTX_NUM; n++ )
+        tgt.path[n] = -1;
+
+    if( tgt.ramSize ) {
+        if( (tgt.ram = calloc( 1, tgt.ramSize )) == NULL ) {
+            printf("*** can't alloc RAM stand-in\n");
+            return(1);
+        }
+    }
+    else
+        tgt.device = device;
+
+    ret = Replay( &tgt, repFile, !!UTL_TSTOPT("o"),
+                  (str = UTL_TSTOPT("l=")) ? atoi(str) : 1 );
+
+    for( n=0; n<MMODPRG_CTX_NUM; n++ )
+        if( tgt.path[n] >= 0 )
+            M_close( tgt.path[n] );
+    free( tgt.ram );
+
+    return( ret );
+}
+
+/*--------------------------------------------------------------------------*/
+/* monotonic time [ns] */
+/*--------------------------------------------------------------------------*/
+static u_int64
+NowNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return( (u_int64)ts.tv_sec * 1000000000 + ts.tv_nsec );
+}
+
+/*--------------------------------------------------------------------------*/
+/* byte swap n 32-bit words (trace from other endianness) */
+/*--------------------------------------------------------------------------*/
+static void
+SwapU32( u_int32 *p, u_int32 n )
+{
+    u_int32 v;
+
+    for( ; n; n--, p++ ) {
+        v  = *p;
+        *p = (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) |
+             (v << 24);
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/* move trace records from driver to file, returns -1 on error */
+/*--------------------------------------------------------------------------*/
+static int32
+Drain( MDIS_PATH path, FILE *fp, MMODPRG_TRC_HDR *hdr, u_int32 *lostP )
+{
+    M_SG_BLOCK blk;
+    int32 total = 0;
+
+    blk.size = MMODPRG_TRC_SIZE( DRAIN_ENT );
+    blk.data = (void*)hdr;
+
+    do {
+        hdr->maxEnt = DRAIN_ENT;
+        if( M_getstat( path, MMODPRG_BLK_TRC, (int32*)&blk ) < 0 ) {
+            printf("*** can't read trace: %s\n",
+                   M_errstring( UOS_ErrnoGet() ) );
+            return( -1 );
+        }
+        if( fwrite( hdr + 1, sizeof(MMODPRG_TRC_ENT), hdr->nEnt, fp )
+            != hdr->nEnt ) {
+            printf("*** can't write trace file\n");
+            return( -1 );
+        }
+        total  += hdr->nEnt;
+        *lostP  = hdr->lost;
+    } while( hdr->nEnt == DRAIN_ENT );
+
+    return( total );
+}
+
+/*--------------------------------------------------------------------------*/
+/* capture trace of device for sec seconds (0=until key pressed) */
+/*--------------------------------------------------------------------------*/
+static int
+Capture( char *device, char *file, u_int32 nEnt, u_int32 sec )
+{
+    MDIS_PATH path;
+    MMODPRG_TRC_HDR *hdr;
+    TRC_FHDR fh;
+    FILE *fp;
+    int32 n, timeRes;
+    u_int32 t0;
+    int err = 1;
+
+    if( (hdr = malloc( MMODPRG_TRC_SIZE( DRAIN_ENT ) )) == NULL )
+        return( 1 );
+
+    if( (path = M_open(device)) < 0 ) {
+        printf("*** can't open %s: %s\n", device, M_errstring(UOS_ErrnoGet()));
+        free( hdr );
+        return( 1 );
+    }
+
+    if( (fp = fopen( file, "wb" )) == NULL ) {
+        printf("*** can't create %s\n", file );
+        goto CLEANUP;
+    }
+
+    memset( &fh, 0, sizeof(fh) );
+    fh.magic     = TRC_MAGIC;
+    fh.version   = TRC_VERSION;
+    fh.byteOrder = TRC_BYTEORDER;
+
+    /* header is rewritten with record count at the end */
+    if( fwrite( &fh, sizeof(fh), 1, fp ) != 1 ) {
+        printf("*** can't write trace file\n");
+        goto CLEANUP;
+    }
+
+    if( M_setstat( path, MMODPRG_TRC_START, nEnt ) < 0 ||
+        M_getstat( path, MMODPRG_TRC_RES, &timeRes ) < 0 ) {
+        printf("*** can't start trace: %s\n", M_errstring(UOS_ErrnoGet()));
+        goto CLEANUP;
+    }
+    fh.timeRes = timeRes;
+
+    printf("capturing %s (ring %u records, %u us resolution) %s\n", device,
+           nEnt, fh.timeRes, sec ? "" : "- press any key to stop");
+
+    for( t0 = UOS_MsecTimerGet();; ) {
+        if( (n = Drain( path, fp, hdr, &fh.lost )) < 0 )
+            break;
+        fh.nEnt += n;
+
+        if( sec ? UOS_MsecTimerGet() - t0 >= sec * 1000 :
+                  UOS_KeyPressed() != -1 ) {
+            err = 0;
+            break;
+        }
+        UOS_Delay( DRAIN_MS );
+    }
+
+    M_setstat( path, MMODPRG_TRC_STOP, 0 );
+
+    /* records since last drain */
+    if( !err ) {
+        if( (n = Drain( path, fp, hdr, &fh.lost )) < 0 )
+            err = 1;
+        else
+            fh.nEnt += n;
+    }
+
+    if( !err && (fseek( fp, 0, SEEK_SET ) ||
+                 fwrite( &fh, sizeof(fh), 1, fp ) != 1) )
+        err = 1;
+
+    if( !err )
+        printf("captured %u records (%u lost) to %s\n",
+               fh.nEnt, fh.lost, file );
+
+ CLEANUP:
+    if( fp && fclose( fp ) )
+        err = 1;
+    M_close( path );
+    free( hdr );
+    return( err );
+}
+
+/*--------------------------------------------------------------------------*/
+/* issue one recorded single access, returns 0 or error code */
+/*--------------------------------------------------------------------------*/
+static int
+Issue( TARGET *tgt, const MMODPRG_TRC_ENT *e, u_int32 *valP )
+{
+    MDIS_PATH *pathP;
+    u_int8 *p;
+    int code = e->width == 1 ? MMODPRG_BLK_D8 :
+               e->width == 2 ? MMODPRG_BLK_D16 : MMODPRG_BLK_D32;
+
+    /*--- RAM stand-in ---*/
+    if( tgt->ram ) {
+        if( e->offset > tgt->ramSize || e->width > tgt->ramSize - e->offset )
+            return( ERR_LL_ILL_PARAM );
+
+        p = tgt->ram + e->offset;
+        if( e->op == MMODPRG_TRC_OP_WRITE ) {
+            if( e->width == 1 )
+                *p = (u_int8)e->value;
+            else if( e->width == 2 )
+                *(u_int16*)p = (u_int16)e->value;
+            else
+                *(u_int32*)p = e->value;
+        }
+        else
+            *valP = e->width == 1 ? *p :
+                    e->width == 2 ? *(u_int16*)p : *(u_int32*)p;
+        return( 0 );
+    }
+
+    /*--- device, one path per recorded channel ---*/
+    pathP = &tgt->path[e->ch % MMODPRG_CTX_NUM];
+    if( *pathP < 0 ) {
+        if( (*pathP = M_open( tgt->device )) < 0 )
+            return( UOS_ErrnoGet() );
+        if( M_setstat( *pathP, M_MK_CH_CURRENT, e->ch ) < 0 )
+            return( UOS_ErrnoGet() );
+    }
+
+    if( e->op == MMODPRG_TRC_OP_WRITE ?
+        MMODPRG_SetValue( *pathP, code, e->offset, e->value ) :
+        MMODPRG_GetValue( *pathP, code, e->offset, valP ) )
+        return( UOS_ErrnoGet() );
+
+    return( 0 );
+}
+
+/*--------------------------------------------------------------------------*/
+/* qsort compare of latencies */
+/*--------------------------------------------------------------------------*/
+static int
+CmpU32( const void *a, const void *b )
+{
+    u_int32 x = *(const u_int32*)a, y = *(const u_int32*)b;
+
+    return( x < y ? -1 : x > y );
+}
+
+/*--------------------------------------------------------------------------*/
+/* replay trace file loops times, print throughput and latencies */
+/*--------------------------------------------------------------------------*/
+static int
+Replay( TARGET *tgt, char *file, int timed, u_int32 loops )
+{
+    TRC_FHDR fh;
+    MMODPRG_TRC_ENT *ent = NULL;
+    u_int32 *lat = NULL;
+    u_int32 i, l, val, nOps = 0, nErr = 0, nDiff = 0, nBlk = 0;
+    u_int64 tStart, t0, ts, dueNs, total;
+    FILE *fp;
+    int swap, err = 1;
+
+    if( (fp = fopen( file, "rb" )) == NULL ) {
+        printf("*** can't open %s\n", file );
+        return( 1 );
+    }
+
+    if( fread( &fh, sizeof(fh), 1, fp ) != 1 )
+        fh.magic = 0;
+
+    /* trace captured on other endianness: header fields are swapped too */
+    swap = (fh.byteOrder == TRC_BYTEORDER_SW);
+    if( swap )
+        SwapU32( (u_int32*)&fh, sizeof(fh) / 4 );
+
+    if( fh.magic != TRC_MAGIC || fh.version != TRC_VERSION ||
+        fh.byteOrder != TRC_BYTEORDER ) {
+        printf("*** %s: no valid trace file\n", file );
+        goto CLEANUP;
+    }
+
+    if( fh.nEnt == 0 || loops == 0 ) {
+        printf("nothing to replay\n");
+        err = 0;
+        goto CLEANUP;
+    }
+
+    if( fh.nEnt > 0xffffffff / sizeof(*lat) / loops ||
+        (ent = malloc( fh.nEnt * sizeof(*ent) )) == NULL ||
+        (lat = malloc( fh.nEnt * loops * sizeof(*lat) )) == NULL ) {
+        printf("*** can't alloc %u records\n", fh.nEnt );
+        goto CLEANUP;
+    }
+
+    if( fread( ent, sizeof(*ent), fh.nEnt, fp ) != fh.nEnt ) {
+        printf("*** trace file truncated\n");
+        goto CLEANUP;
+    }
+
+    /* usec, code, offset and value; width..reserved are bytes */
+    if( swap )
+        for( i=0; i<fh.nEnt; i++ )
+            SwapU32( &ent[i].usec, 4 );
+
+    printf("replaying %u records%s x%u against %s%s\n", fh.nEnt,
+           fh.lost ? " (capture incomplete)" : "", loops,
+           tgt->ram ? "RAM stand-in" : tgt->device,
+           timed ? " with original timing" : "" );
+
+    /*--------------------+
+    |  replay             |
+    +--------------------*/
+    tStart = NowNs();
+    for( l=0; l<loops; l++ ) {
+        t0 = NowNs();
+        for( i=0; i<fh.nEnt; i++ ) {
+            if( timed ) {
+                /* wait until original offset from first record */
+                dueNs = (u_int64)(ent[i].usec - ent[0].usec) * 1000;
+                while( (ts = NowNs() - t0) < dueNs ) {
+                    if( dueNs - ts > 2000000 )
+                        UOS_Delay( 1 );         /* sleep if >2 ms early */
+                }
+            }
+
+            /* block operation, no data to re-issue */
+            if( ent[i].width == 0 ) {
+                nBlk++;
+                continue;
+            }
+
+            ts = NowNs();
+            if( Issue( tgt, &ent[i], &val ) )
+                nErr++;
+            else if( ent[i].op == MMODPRG_TRC_OP_READ &&
+                     val != ent[i].value )
+                nDiff++;
+            lat[nOps++] = (u_int32)(NowNs() - ts);
+        }
+    }
+    total = NowNs() - tStart;
+
+    /*--------------------+
+    |  report             |
+    +--------------------*/
+    printf("ops:        %u (%u errors, %u reads differing from trace, "
+           "%u block ops not re-issued)\n", nOps, nErr, nDiff, nBlk );
+    if( nOps == 0 ) {
+        err = 0;
+        goto CLEANUP;
+    }
+
+    qsort( lat, nOps, sizeof(*lat), CmpU32 );
+
+    printf("time:       %.3f ms\n", total / 1e6 );
+    printf("throughput: %.0f ops/s\n", total ? nOps * 1e9 / total : 0.0 );
+    printf("latency:    p50 %.2f us  p90 %.2f us  p99 %.2f us  "
+           "p99.9 %.2f us  max %.2f us\n",
+           lat[nOps / 2] / 1e3, lat[(u_int64)nOps * 90 / 100] / 1e3,
+           lat[(u_int64)nOps * 99 / 100] / 1e3,
+           lat[(u_int64)nOps * 999 / 1000] / 1e3, lat[nOps - 1] / 1e3 );
+
+    err = nErr ? 1 : 0;
+
+ CLEANUP:
+    free( lat );
+    free( ent );
+    fclose( fp );
+    return( err );
+}
@@ -31,8 +31,11 @@ MAK_SWITCH= \
 MAK_LIBS=$(LIB_PREFIX)$(MEN_LIB_DIR)/mdis_api$(LIB_SUFFIX)	\
          $(LIB_PREFIX)$(MEN_LIB_DIR)/usr_oss$(LIB_SUFFIX)	\
          $(LIB_PREFIX)$(MEN_LIB_DIR)/usr_utl$(LIB_SUFFIX)	\
+         $(LIB_PREFIX)$(MEN_LIB_DIR)/mmodprg_api$(LIB_SUFFIX)	\
+         -lpthread	\
 
 MAK_INCL=$(MEN_INC_DIR)/mmodprg_drv.h	\
+         $(MEN_INC_DIR)/mmodprg_api.h	\
          $(MEN_INC_DIR)/men_typs.h	\
          $(MEN_INC_DIR)/mdis_api.h	\
          $(MEN_INC_DIR)/usr_oss.h	\
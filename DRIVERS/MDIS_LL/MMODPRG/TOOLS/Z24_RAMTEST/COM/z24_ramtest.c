@@ -9,7 +9,10 @@
  *
  *        \brief Test program for the Z24 SRAM controller chameleon FPGA
  *
- *     Required: libraries: mdis_api, usr_oss, usr_utl
+ *               Several devices can be given; the test list is then
+ *               run on all of them concurrently, one thread per device.
+ *
+ *     Required: libraries: mdis_api, usr_oss, usr_utl, mmodprg_api
  *               drivers:   mmodprg
  *     \switches see usage()
  */
@@ -36,12 +39,15 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
 
 #include <MEN/men_typs.h>
 #include <MEN/usr_oss.h>
 #include <MEN/usr_utl.h>
 #include <MEN/mdis_api.h>
 #include <MEN/mmodprg_drv.h>
+#include <MEN/mmodprg_api.h>
 
 static const char IdentString[]=MENT_XSTR(MAK_REVISION);
 
@@ -72,27 +78,53 @@ static const char IdentString[]=MENT_XSTR(MAK_REVISION);
  */
 
 /* misc */
-#define SRAM_MAX         0x800          /* 2 kByte */
+#define SRAM_MAX         0x800          /* 2 kByte, if size probe fails */
+#define PERF_MIN_MS      200            /* min. time per throughput mode */
+#define STRESS_MAX_THR   64             /* max. number of stress threads */
+#define LAT_SUB          16             /* latency buckets per power of 2 */
+#define LAT_BUCKETS      (29*LAT_SUB)   /* latency histogram size */
+#define REGRESS_PCT      20             /* default baseline threshold [%] */
+#define SOAK_INTERVAL    60             /* default soak report interval [s] */
+#define SOAK_PATTERNS    7              /* number of soak fill patterns */
+#define SOAK_MAX_FAIL    64             /* max. tracked failing addresses */
+#define SOAK_SCRUB_MS    1000           /* scrub period of resident data */
+
+/* March test definitions */
+#define M_ANY            0              /* element address order: any */
+#define M_UP             1              /*                        ascending */
+#define M_DOWN           2              /*                        descending */
+
+#define MR0              0x10           /* read, expect background */
+#define MR1              0x11           /* read, expect inverted background */
+#define MW0              0x20           /* write background */
+#define MW1              0x21           /* write inverted background */
+#define M_IS_READ(op)    ((op) & 0x10)
+#define M_INV(op)        ((op) & 0x01)
+
+#define MARCH_MAX_OPS    7              /* max. ops per element (+ 0) */
+#define MARCH_MAX_ELEM   7              /* max. elements per algorithm (+ 0) */
+#define MARCH_SEQ_SIZE   MMODPRG_SEQ_SIZE(MMODPRG_SEQ_MAX_OPS, \
+                                          MMODPRG_SEQ_MAX_OPS)
 
 /* access macros */
 #define SRAM_SET_D8( offs, val ) \
-        FAIL_UNLESS( MMODPRG_SetD8( d->path, offs, val ) == 0 )
+        FAIL_UNLESS( (d->accCnt++, MMODPRG_SetD8( d->path, offs, val )) == 0 )
 
 #define SRAM_SET_D16( offs, val ) \
-        FAIL_UNLESS( MMODPRG_SetD16( d->path, offs, val ) == 0 )
+        FAIL_UNLESS( (d->accCnt++, MMODPRG_SetD16( d->path, offs, val )) == 0 )
 
 #define SRAM_SET_D32( offs, val ) \
-        FAIL_UNLESS( MMODPRG_SetD32( d->path, offs, val ) == 0 )
+        FAIL_UNLESS( (d->accCnt++, MMODPRG_SetD32( d->path, offs, val )) == 0 )
 
 
 #define SRAM_GET_D8( offs, val ) \
-        FAIL_UNLESS( MMODPRG_GetD8( d->path, offs, val ) == 0 )
+        FAIL_UNLESS( (d->accCnt++, MMODPRG_GetD8( d->path, offs, val )) == 0 )
 
 #define SRAM_GET_D16( offs, val ) \
-        FAIL_UNLESS( MMODPRG_GetD16( d->path, offs, val ) == 0 )
+        FAIL_UNLESS( (d->accCnt++, MMODPRG_GetD16( d->path, offs, val )) == 0 )
 
 #define SRAM_GET_D32( offs, val ) \
-        FAIL_UNLESS( MMODPRG_GetD32( d->path, offs, val ) == 0 )
+        FAIL_UNLESS( (d->accCnt++, MMODPRG_GetD32( d->path, offs, val )) == 0 )
 
 
 /*--------------------------------------+
@@ -101,6 +133,10 @@ static const char IdentString[]=MENT_XSTR(MAK_REVISION);
 typedef struct {
     MDIS_PATH path;
     char *name;
+    u_int32 accCnt;                     /* accesses of current test */
+    u_int32 seed;                       /* seed of next random test */
+    int     failValid;                  /* first failure recorded */
+    u_int32 failAdr, failVal, failSb;   /* first failure of current test */
 } DEVICE;
 
 /* test list description */
@@ -110,6 +146,84 @@ typedef struct {
     int (*func)( DEVICE *, u_int32 startAddr, u_int32 endAddr );
 } TEST_ELEM;
 
+/* bijective permutation of [0, n) (random test) */
+typedef struct {
+    u_int32 n;                          /* number of elements */
+    u_int32 bits, mask;                 /* smallest 2^bits >= n */
+    u_int32 a, c, mul;                  /* LCG and mixing parameters */
+    u_int32 state;                      /* LCG state */
+} PERM;
+
+/* failing address of soak mode */
+typedef struct {
+    u_int32 adr;
+    u_int32 count;                      /* number of failures */
+} SOAK_FAIL;
+
+/* result of one test run (-o, -B) */
+typedef struct {
+    TEST_ELEM *te;
+    int     run;                        /* run number */
+    double  ms;                         /* wall time */
+    u_int32 accesses;                   /* accesses (elements transferred) */
+    u_int32 errors;
+    int     failValid;                  /* first failure details valid */
+    u_int32 failAdr, failVal, failSb;
+    double  baseNs;                     /* baseline ns/access, 0=none */
+    int     regressed;                  /* slower than baseline+threshold */
+} TEST_RESULT;
+
+/* throughput mode description */
+typedef struct {
+    char *descr;
+    int  write;                         /* write (1) or read (0) pass */
+    int  random;                        /* random address order */
+    int  bulk;                          /* use burst transfers */
+} PERF_MODE;
+
+/* March element: address order and operations applied to each cell */
+typedef struct {
+    int     order;                      /* M_ANY, M_UP, M_DOWN */
+    u_int8  ops[MARCH_MAX_OPS+1];       /* MRx/MWx, terminated by 0 */
+} MARCH_ELEM;
+
+/* March algorithm */
+typedef struct {
+    int        checker;                 /* checkerboard background */
+    MARCH_ELEM elem[MARCH_MAX_ELEM+1];  /* terminated by empty element */
+} MARCH_ALG;
+
+/* stress test worker (-j) */
+typedef struct {
+    DEVICE    d;                        /* own path to device */
+    int       id;                       /* worker number */
+    u_int32   startAddr, endAddr;       /* disjoint range of this worker */
+    int       passes;                   /* number of passes over range */
+    u_int32   accesses;                 /* number of driver calls done */
+    u_int32   errors;                   /* data integrity errors */
+    u_int32   lat[LAT_BUCKETS];         /* latency histogram (LatBucket) */
+    u_int32   latMax;                   /* max. latency [ns] */
+    int       rc;                       /* 0=ok, 1=driver call failed */
+    pthread_t tid;
+} STRESS_JOB;
+
+/* test list run on one device (multi-device mode runs one per thread) */
+typedef struct {
+    DEVICE    d;
+    u_int32   startAddr, endAddr;       /* tested range */
+    char      *testlist;                /* test codes */
+    int       runs;                     /* runs per test */
+    int       stopOnFirst;              /* stop on first failed test */
+    int       wait;                     /* wait for key before each test */
+    int       quiet;                    /* one line per test, no progress */
+    TEST_RESULT *res;                   /* results */
+    int       nRes;                     /* number of results */
+    int       errCount;                 /* failed tests */
+    double    ms;                       /* wall time of all tests */
+    int       rc;                       /* 0=ok, 1=open/init failed */
+    pthread_t tid;
+} DEV_JOB;
+
 
 /*--------------------------------------+
 |   EXTERNALS                           |
@@ -124,7 +238,24 @@ static void    waitKey( char *msg, char key );
 
 static int     Init( DEVICE *d );
 static int     Deinit( DEVICE *d );
+static u_int32 SramSizeGet( DEVICE *d );
 static int     dumpSram( DEVICE *d, u_int32 adr, int numBytes );
+static void    FailRec( DEVICE *d, u_int32 adr, u_int32 val, u_int32 sb );
+static double  NsTime( void );
+static int     BaselineApply( char *file, TEST_RESULT *res, int nRes,
+                              int pct );
+static int     ResultWrite( char *file, DEVICE *d, u_int32 startAddr,
+                            u_int32 endAddr, TEST_RESULT *res, int nRes );
+static int     Perf( DEVICE *d, u_int32 startAddr, u_int32 endAddr );
+static int     Stress( char *name, int nThr, u_int32 startAddr,
+                       u_int32 endAddr, int passes );
+static int     Soak( DEVICE *d, u_int32 startAddr, u_int32 endAddr,
+                     u_int32 duration, u_int32 interval );
+static u_int32 ParseDuration( char *str );
+static int     RunTests( DEV_JOB *j );
+static int     MultiDev( char **names, int nDev, char *testlist, int runs,
+                         int stopOnFirst, u_int32 startAddr,
+                         u_int32 endAddr );
 
 
 
@@ -133,6 +264,12 @@ static int     TestA( DEVICE *d, u_int32 startAddr, u_int32 endAddr );
 static int     TestB( DEVICE *d, u_int32 startAddr, u_int32 endAddr );
 static int     TestC( DEVICE *d, u_int32 startAddr, u_int32 endAddr );
 static int     TestD( DEVICE *d, u_int32 startAddr, u_int32 endAddr );
+static int     TestMatsPlus( DEVICE *d, u_int32 startAddr, u_int32 endAddr );
+static int     TestMarchCm( DEVICE *d, u_int32 startAddr, u_int32 endAddr );
+static int     TestMarchB( DEVICE *d, u_int32 startAddr, u_int32 endAddr );
+static int     TestChecker( DEVICE *d, u_int32 startAddr, u_int32 endAddr );
+static int     TestWalkAdr( DEVICE *d, u_int32 startAddr, u_int32 endAddr );
+static int     TestWalkData( DEVICE *d, u_int32 startAddr, u_int32 endAddr );
 
 /*--------------------------------------+
 |   GLOBALS                             |
@@ -141,11 +278,64 @@ static TEST_ELEM G_testList[] = {
     { 'a', "Simple read/write",                        TestA },
     { 'b', "Autoincrement",                            TestB },
     { 'c', "Linear read/write",                        TestC },
-    { 'd', "Random read/write",                        TestD },
+    { 'd', "Random permutation read/write",            TestD },
+    { 'e', "March MATS+",                              TestMatsPlus },
+    { 'f', "March C-",                                 TestMarchCm },
+    { 'g', "March B",                                  TestMarchB },
+    { 'h', "Checkerboard",                             TestChecker },
+    { 'i', "Walking 1/0 on address lines",             TestWalkAdr },
+    { 'j', "Walking 1/0 on data lines",                TestWalkData },
     { 0, NULL, NULL }
 };
 
+/* MATS+: {any(w0); up(r0,w1); down(r1,w0)} */
+static MARCH_ALG G_matsPlus = { 0, {
+    { M_ANY,  { MW0 } },
+    { M_UP,   { MR0, MW1 } },
+    { M_DOWN, { MR1, MW0 } },
+    { 0, { 0 } } } };
+
+/* March C-: {any(w0); up(r0,w1); up(r1,w0); down(r0,w1); down(r1,w0);
+              any(r0)} */
+static MARCH_ALG G_marchCm = { 0, {
+    { M_ANY,  { MW0 } },
+    { M_UP,   { MR0, MW1 } },
+    { M_UP,   { MR1, MW0 } },
+    { M_DOWN, { MR0, MW1 } },
+    { M_DOWN, { MR1, MW0 } },
+    { M_ANY,  { MR0 } },
+    { 0, { 0 } } } };
+
+/* March B: {any(w0); up(r0,w1,r1,w0,r0,w1); up(r1,w0,w1);
+             down(r1,w0,w1,w0); down(r0,w1,w0)} */
+static MARCH_ALG G_marchB = { 0, {
+    { M_ANY,  { MW0 } },
+    { M_UP,   { MR0, MW1, MR1, MW0, MR0, MW1 } },
+    { M_UP,   { MR1, MW0, MW1 } },
+    { M_DOWN, { MR1, MW0, MW1, MW0 } },
+    { M_DOWN, { MR0, MW1, MW0 } },
+    { 0, { 0 } } } };
+
+/* checkerboard: {any(w0); any(r0); any(w1); any(r1)}, alternating words */
+static MARCH_ALG G_checker = { 1, {
+    { M_ANY,  { MW0 } },
+    { M_ANY,  { MR0 } },
+    { M_ANY,  { MW1 } },
+    { M_ANY,  { MR1 } },
+    { 0, { 0 } } } };
+
+static PERF_MODE G_perfModes[] = {
+    { "seq write",    1, 0, 0 },
+    { "seq read",     0, 0, 0 },
+    { "random write", 1, 1, 0 },
+    { "random read",  0, 1, 0 },
+    { "bulk write",   1, 0, 1 },
+    { "bulk read",    0, 0, 1 },
+    { NULL, 0, 0, 0 }
+};
+
 static int G_verbose = 0;
+static u_int32 G_seed;                  /* random test seed (-S) */
 
 /********************************* usage ************************************
  *
@@ -160,15 +350,31 @@ static void usage(void)
 {
     TEST_ELEM *te=G_testList;
 
-    printf("Usage: mmodprog_ramtest [<opts>] <device> [<opts>]\n");
+    printf("Usage: mmodprog_ramtest [<opts>] <device> [<device>...] "
+           "[<opts>]\n");
     printf("Function: Verification program for SRAM controller\n");
     printf("Options:\n");
 	printf("  -b=<offs>    start addr (relative to base addr).... [0]\n");
-	printf("  -e=<offs>    end addr (relative to base addr (+1)). [0x800]\n");
+	printf("  -e=<offs>    end addr (relative to base addr (+1)). [SRAM size]\n");
     printf("  -v=<num>     verbosity level (0-2)................. [0]\n");
     printf("  -n           number of runs for each test.......... [1]\n");
     printf("  -s           stop on first error .................. [no]\n");
-    printf("  -t=<list>    perform onlys those tests listed:..... [all]\n");
+    printf("  -p           throughput mode (D8/D16/D32 MB/s)..... [no]\n");
+    printf("  -j=<n>       stress mode: n threads/paths, disjoint\n");
+    printf("               ranges, -n passes each................ [off]\n");
+    printf("  -d=<time>    soak mode: fill/verify/scrub for <time>\n");
+    printf("               seconds (suffix m/h: minutes/hours)... [off]\n");
+    printf("  -i=<time>    soak report interval.................. [%ds]\n",
+           SOAK_INTERVAL);
+    printf("  -S=<seed>    seed for random test (hex)............ [random]\n");
+    printf("  -t=<list>    perform onlys those tests listed:..... [abcd]\n");
+    printf("  -o=<file>    write results to <file>, CSV if name ends\n");
+    printf("               with .csv, JSON otherwise............. [none]\n");
+    printf("  -B=<file>    compare ns/access with baseline CSV... [none]\n");
+    printf("  -R=<pct>     baseline regression threshold [%%]..... [%d]\n",
+           REGRESS_PCT);
+    printf("  With several devices, the tests run concurrently on all\n");
+    printf("  devices (-p, -j, -d, -o, -B only for one device).\n");
 
     while( te->func ){
         printf("    %c: %s\n", te->code, te->descr );
@@ -191,19 +397,27 @@ static void usage(void)
 int main(int argc, char *argv[])
 {
     int32   n;
-    DEVICE  d;
+    DEV_JOB job;
+    DEVICE  *d = &job.d;
+    char    **devs;
+    int     nDev = 0;
     char    buf[80];
     char    *str, *errstr, *testlist;
     char    *tCode;
-    int     errCount=1, err, stopOnFirst, runs, wait=0;
-    u_int32 startAddr = 0, endAddr = SRAM_MAX;
+    int     errCount=1, stopOnFirst, runs, perf, threads, wait=0;
+    int     nRes = 0, regressPct, regressions = 0;
+    u_int32 duration, interval;
+    char    *outFile, *baseFile;
+    TEST_RESULT *res = NULL;
+    u_int32 startAddr = 0, endAddr = 0;
+    int32   sramSize;
 
     TEST_ELEM *te;
 
     /*--------------------+
     |  check arguments    |
     +--------------------*/
-    if ((errstr = UTL_ILLIOPT("b=e=v=n=t=s?", buf))) {   /* check args */
+    if ((errstr = UTL_ILLIOPT("b=e=v=n=t=j=o=B=R=S=d=i=sp?", buf))) {   /* check args */
         printf("*** %s\n", errstr);
         return(1);
     }
@@ -216,23 +430,41 @@ int main(int argc, char *argv[])
     /*--------------------+
     |  get arguments      |
     +--------------------*/
-    d.name = NULL;
+    memset( &job, 0, sizeof(job) );
+    d->path = -1;
+
+    if( (devs = calloc( argc, sizeof(char*) )) == NULL )
+        return(1);
 
     for (n=1; n<argc; n++){
         if (*argv[n] != '-') {
-            d.name = argv[n];
+            devs[nDev++] = argv[n];
         }
     }
 
-    if (d.name == NULL) {
+    if (nDev == 0) {
         usage();
+        free( devs );
         return(1);
     }
+    d->name = devs[0];
 
     G_verbose     = ((str = UTL_TSTOPT("v=")) ? atoi(str) : 0);
     testlist      = ((str = UTL_TSTOPT("t=")) ? str : "abcd"/*efghijklmnopqrstuvxyz"*/);
     stopOnFirst   = !!UTL_TSTOPT("s");
     runs          = ((str = UTL_TSTOPT("n=")) ? atoi(str) : 1);
+    perf          = !!UTL_TSTOPT("p");
+    threads       = ((str = UTL_TSTOPT("j=")) ? atoi(str) : 0);
+    duration      = ((str = UTL_TSTOPT("d=")) ? ParseDuration(str) : 0);
+    interval      = ((str = UTL_TSTOPT("i=")) ? ParseDuration(str) :
+                     SOAK_INTERVAL);
+    outFile       = UTL_TSTOPT("o=");
+    baseFile      = UTL_TSTOPT("B=");
+    regressPct    = ((str = UTL_TSTOPT("R=")) ? atoi(str) : REGRESS_PCT);
+    G_seed        = ((str = UTL_TSTOPT("S=")) ? strtoul(str, NULL, 16) :
+                     UOS_Random( UOS_MsecTimerGet() ^ (u_int32)time(NULL) ));
+
+	FAIL_UNLESS_(threads >= 0 && threads <= STRESS_MAX_THR);
 
 	if( (str = UTL_TSTOPT("b=")) )
 		startAddr = strtol(str, NULL, 16);
@@ -241,78 +473,133 @@ int main(int argc, char *argv[])
 
 	if( (str = UTL_TSTOPT("e=")) )
 		endAddr = strtol(str, NULL, 16);
-	if( 0 == endAddr )
-		endAddr = SRAM_MAX;
 
-	if( endAddr > SRAM_MAX )
-		endAddr = SRAM_MAX;
+    for( tCode=testlist; *tCode; tCode++ ){
+        for( te=G_testList; te->func; te++ )
+            if( *tCode == te->code )
+                break;
 
-	FAIL_UNLESS(endAddr > startAddr);
+        if( te->func == NULL ){
+            printf("Unknown test: %c\n", *tCode );
+            free( devs );
+            return( 1 );
+        }
+    }
+
+    /*--------------------+
+    |  several devices    |
+    +--------------------*/
+    if( nDev > 1 ) {
+        if( perf || threads || duration || outFile || baseFile ) {
+            printf("*** -p, -j, -d, -o, -B not supported with several "
+                   "devices\n");
+            free( devs );
+            return( 1 );
+        }
+
+        errCount = MultiDev( devs, nDev, testlist, runs, stopOnFirst,
+                             startAddr, endAddr );
+        free( devs );
+        return( errCount ? 1 : 0 );
+    }
 
     /*--------------------+
     |  open device        |
     +--------------------*/
-    d.path = -1;
-    FAIL_UNLESS((d.path = M_open(d.name)) >= 0);
+    FAIL_UNLESS((d->path = M_open(d->name)) >= 0);
+
+    /*--------------------+
+    |  detect SRAM size   |
+    +--------------------*/
+	sramSize = SramSizeGet( d );
+
+	printmsg( 1, "SRAM size: 0x%x\n", sramSize );
+
+	if( 0 == endAddr || endAddr > (u_int32)sramSize )
+		endAddr = sramSize;
+
+	FAIL_UNLESS_(endAddr > startAddr);
 
 
     /*-----------------+
     |  init device     |
     +-----------------*/
 
-    FAIL_UNLESS( Init( &d ) == 0 );
+    FAIL_UNLESS( Init( d ) == 0 );
     errCount = 0;
 
     /*-----------------+
-    |  perform tests   |
+    |  throughput mode |
     +-----------------*/
-    for( tCode=testlist; *tCode; tCode++ ){
-
-        for( te=G_testList; te->func; te++ )
-            if( *tCode == te->code )
-                break;
-
-        if( te->func == NULL ){
-            printf("Unknown test: %c\n", *tCode );
-            return( 1 );
-        }
+    if( perf ) {
+        errCount = Perf( d, startAddr, endAddr );
+        goto ABORT;
+    }
 
-        for( n=0; n<runs; ++n ) {
+    /*-----------------+
+    |  stress mode     |
+    +-----------------*/
+    if( threads ) {
+        errCount = Stress( d->name, threads, startAddr, endAddr, runs );
+        goto ABORT;
+    }
 
-            if( wait ) {
-                printf( "Hit <Return> for test %c.\n", te->code );
-                getchar();
-            }
+    /*-----------------+
+    |  soak mode       |
+    +-----------------*/
+    if( duration ) {
+        errCount = Soak( d, startAddr, endAddr, duration,
+                         interval ? interval : 1 );
+        goto ABORT;
+    }
 
-            printf("=== Performing test %c: %-43s ", te->code, te->descr );
-            printmsg( 1, "===\n");
-            fflush(stdout);
+    /*-----------------+
+    |  perform tests   |
+    +-----------------*/
+    if( strchr( testlist, 'd' ) )
+        printf("Random test seed: -S=%x\n", G_seed );
 
-            err = te->func( &d, startAddr, endAddr );
-            errCount += err;
+    job.startAddr   = startAddr;
+    job.endAddr     = endAddr;
+    job.testlist    = testlist;
+    job.runs        = runs;
+    job.stopOnFirst = stopOnFirst;
+    job.wait        = wait;
+    d->seed         = G_seed;
 
-            printmsg( 1, "Test %c: ", te->code);
-            printf( "%s\n", err ? "FAILED" : "ok" );
+    errCount = RunTests( &job );
+    res  = job.res;
+    nRes = job.nRes;
 
-            if( err && stopOnFirst )
-                goto ABORT;
-        }
+ ABORT:
+    if( baseFile && nRes ) {
+        regressions = BaselineApply( baseFile, res, nRes, regressPct );
+        if( regressions < 0 )
+            errCount++;		/* baseline not readable */
     }
 
- ABORT:
+    if( outFile && nRes && ResultWrite( outFile, d, startAddr, endAddr,
+                                        res, nRes ) )
+        errCount++;
+
     printf("------------------------------------------------\n");
     printf("TEST RESULT: %d errors\n", errCount );
+    if( baseFile && regressions >= 0 )
+        printf("REGRESSIONS: %d (threshold %d%%)\n", regressions, regressPct );
+
+    free( res );
+    free( devs );
 
     if( wait ) {
         waitKey( "Enter 'x' to finish program.\n", 'x');
     }
 
-    if( d.path != -1 ) {
-        Deinit( &d );
-        M_close( d.path );
+    if( d->path != -1 ) {
+        Deinit( d );
+        M_close( d->path );
     }
 
-    return errCount ? 1 : 0 ;
+    return (errCount || regressions > 0) ? 1 : 0 ;
 }
 
 /***************************************************************************/
@@ -372,6 +659,148 @@ dumpSram( DEVICE *d, u_int32 adr, int numBytes )
     return( 1 );
 }
 
+/*--------------------------------------------------------------------------*/
+/* record first failure of current test */
+/*--------------------------------------------------------------------------*/
+static void
+FailRec( DEVICE *d, u_int32 adr, u_int32 val, u_int32 sb )
+{
+    if( d->failValid )
+        return;
+
+    d->failValid = 1;
+    d->failAdr   = adr;
+    d->failVal   = val;
+    d->failSb    = sb;
+}
+
+/*--------------------------------------------------------------------------*/
+/* ns per access of a test result */
+/*--------------------------------------------------------------------------*/
+static double
+ResultNs( TEST_RESULT *r )
+{
+    return( r->accesses ? r->ms * 1e6 / r->accesses : 0.0 );
+}
+
+/*--------------------------------------------------------------------------*/
+/* write results as JSON or CSV (file name ends with .csv) */
+/*--------------------------------------------------------------------------*/
+static int
+ResultWrite( char *file, DEVICE *d, u_int32 startAddr, u_int32 endAddr,
+             TEST_RESULT *res, int nRes )
+{
+    FILE *fp;
+    TEST_RESULT *r;
+    size_t len = strlen( file );
+    int n, csv = (len > 4 && !strcmp( file + len - 4, ".csv" ));
+
+    if( (fp = fopen( file, "w" )) == NULL ) {
+        printf("*** can't create %s\n", file );
+        return( 1 );
+    }
+
+    if( csv )
+        fprintf( fp, "device,test,run,ms,accesses,ns_per_access,errors,"
+                 "fail_addr,fail_got,fail_expected,base_ns_per_access,"
+                 "regressed,descr\n" );
+    else
+        fprintf( fp, "{\n  \"device\": \"%s\",\n  \"start\": %u,\n"
+                 "  \"end\": %u,\n  \"results\": [\n",
+                 d->name, startAddr, endAddr );
+
+    for( n=0; n<nRes; n++ ) {
+        r = &res[n];
+
+        if( csv ) {
+            fprintf( fp, "%s,%c,%d,%.3f,%u,%.1f,%u,", d->name, r->te->code,
+                     r->run, r->ms, r->accesses, ResultNs( r ), r->errors );
+            if( r->failValid )
+                fprintf( fp, "0x%x,0x%x,0x%x,", r->failAdr, r->failVal,
+                         r->failSb );
+            else
+                fprintf( fp, ",,," );
+            fprintf( fp, "%.1f,%d,\"%s\"\n", r->baseNs, r->regressed,
+                     r->te->descr );
+        }
+        else {
+            fprintf( fp, "    { \"test\": \"%c\", \"descr\": \"%s\", "
+                     "\"run\": %d, \"ms\": %.3f, \"accesses\": %u, "
+                     "\"ns_per_access\": %.1f, \"errors\": %u",
+                     r->te->code, r->te->descr, r->run, r->ms, r->accesses,
+                     ResultNs( r ), r->errors );
+            if( r->failValid )
+                fprintf( fp, ", \"first_failure\": { \"addr\": %u, "
+                         "\"got\": %u, \"expected\": %u }",
+                         r->failAdr, r->failVal, r->failSb );
+            if( r->baseNs > 0 )
+                fprintf( fp, ", \"base_ns_per_access\": %.1f, "
+                         "\"regressed\": %s", r->baseNs,
+                         r->regressed ? "true" : "false" );
+            fprintf( fp, " }%s\n", n < nRes-1 ? "," : "" );
+        }
+    }
+
+    if( !csv )
+        fprintf( fp, "  ]\n}\n" );
+
+    fclose( fp );
+    return( 0 );
+}
+
+/*--------------------------------------------------------------------------*/
+/* compare results with baseline CSV, returns number of regressions or -1
+ *
+ * The baseline ns/access of a test is the mean over all of its runs in
+ * the baseline file. A test regressed if its ns/access exceeds the
+ * baseline by more than pct percent. */
+/*--------------------------------------------------------------------------*/
+static int
+BaselineApply( char *file, TEST_RESULT *res, int nRes, int pct )
+{
+    FILE *fp;
+    char line[256], code;
+    double sum[256], ns, ms;
+    int cnt[256], n, run, regressions = 0;
+    unsigned int acc;
+    TEST_RESULT *r;
+
+    if( (fp = fopen( file, "r" )) == NULL ) {
+        printf("*** can't open baseline %s\n", file );
+        return( -1 );
+    }
+
+    memset( sum, 0, sizeof(sum) );
+    memset( cnt, 0, sizeof(cnt) );
+
+    while( fgets( line, sizeof(line), fp ) ) {
+        if( sscanf( line, "%*[^,],%c,%d,%lf,%u,%lf",
+                    &code, &run, &ms, &acc, &ns ) == 5 ) {
+            sum[(u_int8)code] += ns;
+            cnt[(u_int8)code]++;
+        }
+    }
+    fclose( fp );
+
+    for( n=0; n<nRes; n++ ) {
+        r = &res[n];
+        code = r->te->code;
+
+        if( !cnt[(u_int8)code] || !r->accesses )
+            continue;
+
+        r->baseNs = sum[(u_int8)code] / cnt[(u_int8)code];
+        if( ResultNs( r ) > r->baseNs * (100 + pct) / 100 ) {
+            r->regressed = 1;
+            regressions++;
+            printf("Test %c run %d: %.1f ns/access, baseline %.1f: "
+                   "REGRESSED\n", code, r->run, ResultNs( r ), r->baseNs );
+        }
+    }
+
+    return( regressions );
+}
+
 /*--------------------------------------------------------------------------*/
 /* init device for test */
 /*--------------------------------------------------------------------------*/
@@ -388,6 +817,26 @@ Deinit( DEVICE *d )
     return( 0 );
 }
 
+/*--------------------------------------------------------------------------*/
+/* usable SRAM size, warn if the probe was limited by the address window */
+/*--------------------------------------------------------------------------*/
+static u_int32
+SramSizeGet( DEVICE *d )
+{
+    int32 sramSize, winSize;
+
+    if( M_getstat( d->path, MMODPRG_SRAM_SIZE, &sramSize ) != 0 )
+        return( SRAM_MAX );             /* old driver */
+
+    if( M_getstat( d->path, MMODPRG_WIN_SIZE, &winSize ) == 0 &&
+        (sramSize & ~3) == (winSize & ~3) && sramSize < SRAM_MAX )
+        printf("*** %s: warning: SRAM size limited by address window "
+               "(0x%x < 0x%x), use a driver variant with larger window\n",
+               d->name, sramSize, SRAM_MAX );
+
+    return( sramSize );
+}
+
 
 static u_int32 G_testval_d32[] = { 0x5f5f5f5f, 0xa0a0a0a0 };
 
@@ -474,6 +923,7 @@ TestB( DEVICE *d, u_int32 startAddr, u_int32 endAddr )
         if( val != adr ) {
             printf( "Failure: address=0x%x  val=0x%x  sb=0x%x\n",
                     adr, val, adr );
+            FailRec( d, adr, val, adr );
             failed++;
             FAIL_UNLESS_( val != adr );
         }
@@ -509,6 +959,7 @@ TestC( DEVICE *d, u_int32 startAddr, u_int32 endAddr )
             if( val != G_testval_d32[i] ) {
                 printmsg( 3, "Adr 0x%x: got value 0x%x (should be 0x%x)\n",
                           adr, val, G_testval_d32[i] );
+                FailRec( d, adr, val, G_testval_d32[i] );
             	failed++;
                 FAIL_UNLESS_( 0 );
             }
@@ -522,39 +973,487 @@ TestC( DEVICE *d, u_int32 startAddr, u_int32 endAddr )
     return( 1 );
 }
 
+/*--------------------------------------------------------------------------*/
+/* xorshift32 PRNG, state must not be 0 */
+/*--------------------------------------------------------------------------*/
+static u_int32
+XorShift32( u_int32 *state )
+{
+    u_int32 x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return( *state = x );
+}
+
+/*--------------------------------------------------------------------------*/
+/* init permutation of [0, n) from seed
+ *
+ * A full period LCG modulo 2^bits (a = 1 mod 4, c odd) visits every
+ * value of [0, 2^bits) once per period. Each value is scrambled by a
+ * bijective multiply/xorshift mix and values >= n are skipped (cycle
+ * walking), so every index < n is returned exactly once per n calls. */
+/*--------------------------------------------------------------------------*/
+static void
+PermInit( PERM *p, u_int32 n, u_int32 seed )
+{
+    u_int32 rnd = seed ? seed : 1;
+
+    for( p->bits=1; p->bits<31 && (1UL << p->bits) < n; p->bits++ )
+        ;
+    p->n     = n;
+    p->mask  = (1UL << p->bits) - 1;
+    p->a     = ((XorShift32( &rnd ) << 2) | 1) & p->mask;
+    p->c     = (XorShift32( &rnd ) | 1) & p->mask;
+    p->mul   = XorShift32( &rnd ) | 1;
+    p->state = XorShift32( &rnd ) & p->mask;
+}
+
+/*--------------------------------------------------------------------------*/
+/* next index of permutation */
+/*--------------------------------------------------------------------------*/
+static u_int32
+PermNext( PERM *p )
+{
+    u_int32 x;
+
+    do {
+        p->state = (p->a * p->state + p->c) & p->mask;
+        x = (p->state * p->mul) & p->mask;
+        x ^= x >> ((p->bits + 1) / 2);
+    } while( x >= p->n );
+
+    return( x );
+}
+
+/*--------------------------------------------------------------------------*/
+/* random test data of a word: hash of seed and address */
+/*--------------------------------------------------------------------------*/
+static u_int32
+RandomData( u_int32 seed, u_int32 adr )
+{
+    u_int32 x = (adr * 0x9e3779b9) ^ seed;
+
+    x ^= x >> 16;
+    x *= 0x85ebca6b;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35;
+    x ^= x >> 16;
+
+    return( x );
+}
+
+/*--------------------------------------------------------------------------*/
+/* random test: every word of the range is written once in random order
+ * with random data, then read back and verified in another random order.
+ *
+ * Accesses are issued as micro-sequences of MMODPRG_SEQ_MAX_OPS accesses
+ * per driver call. Each run uses the next seed after -S=, so a failure
+ * can be reproduced with -S= and the same test list. */
+/*--------------------------------------------------------------------------*/
 static int
 TestD( DEVICE *d, u_int32 startAddr, u_int32 endAddr )
 {
-    u_int32 i, adr;
-    u_int32 val, rndVal, failed = 0;
+    MMODPRG_SEQ_HDR *hdr;
+    MMODPRG_SEQ_OP *op;
+    M_SG_BLOCK blk;
+    PERM perm;
+    u_int32 *res, words, chunk, i, c, seed, sb, failed = 0;
+    u_int8 *buf = NULL;
+    int pass;
+
+    seed  = d->seed++;
+    words = (endAddr - startAddr) / 4;
+
+    printmsg( 1, "writing/checking random permutation, seed 0x%x...\n",
+              seed );
+
+    FAIL_UNLESS_( (buf = malloc( MARCH_SEQ_SIZE )) != NULL );
+    blk.data = (void*)buf;
+    hdr = (MMODPRG_SEQ_HDR*)buf;
+
+    /*--- pass 0: write, pass 1: read back in different order ---*/
+    for( pass=0; pass<2; pass++ ) {
+        PermInit( &perm, words, seed + pass * 0x9e3779b9 );
+
+        for( i=0; i<words; i+=chunk ) {
+            chunk = words - i < MMODPRG_SEQ_MAX_OPS ?
+                    words - i : MMODPRG_SEQ_MAX_OPS;
+
+            memset( hdr, 0, sizeof(*hdr) );
+            hdr->nOps     = chunk;
+            hdr->nResults = pass ? chunk : 0;
+            op  = (MMODPRG_SEQ_OP*)(hdr + 1);
+            res = (u_int32*)(op + chunk);
+            blk.size = MMODPRG_SEQ_SIZE( hdr->nOps, hdr->nResults );
+
+            for( c=0; c<chunk; c++ ) {
+                op[c].op     = pass ? MMODPRG_SEQ_READ : MMODPRG_SEQ_WRITE;
+                op[c].width  = 4;
+                op[c].arg    = (u_int16)c;
+                op[c].offset = startAddr + PermNext( &perm ) * 4;
+                op[c].value  = RandomData( seed, op[c].offset );
+                op[c].mask   = 0;
+            }
+
+            FAIL_UNLESS( M_getstat( d->path, MMODPRG_BLK_SEQ,
+                                    (int32*)&blk ) == 0 );
+            d->accCnt += chunk;
+
+            for( c=0; pass && c<chunk; c++ ) {
+                sb = op[c].value;
+                if( res[c] != sb ) {
+                    printmsg( 1, "Adr 0x%x: got value 0x%x (should be 0x%x)\n",
+                              op[c].offset, res[c], sb );
+                    FailRec( d, op[c].offset, res[c], sb );
+                    failed++;
+                }
+            }
+        }
+    }
+
+    free( buf );
+    dumpSram( d, startAddr, 32 );
+
+    return( failed );
+ ABORT:
+    free( buf );
+    return( 1 );
+}
 
-    printmsg( 1, "writing/checking random test pattern...\n" );
+/*--------------------------------------------------------------------------*/
+/* parse duration: number with optional s/m/h suffix, returns seconds */
+/*--------------------------------------------------------------------------*/
+static u_int32
+ParseDuration( char *str )
+{
+    char *end;
+    u_int32 val = strtoul( str, &end, 10 );
 
-    rndVal = UOS_Random( 0 );
+    switch( *end ) {
+    case 'h': return( val * 3600 );
+    case 'm': return( val * 60 );
+    default:  return( val );
+    }
+}
 
-    /*--- check 100000 random accesses ---*/
-    for( i = 0; i < 100000; ++i ) {
-        /* address register ignores lowest two bits */
-        adr =  rndVal & 0x7fffc;
+/*--------------------------------------------------------------------------*/
+/* soak data word idx of pattern pat */
+/*--------------------------------------------------------------------------*/
+static u_int32
+SoakData( int pat, u_int32 idx, u_int32 adr, u_int32 seed )
+{
+    switch( pat ) {
+    case 0:  return( 0x00000000 );
+    case 1:  return( 0xffffffff );
+    case 2:  return( (idx & 1) ? 0xaaaaaaaa : 0x55555555 );
+    case 3:  return( (idx & 1) ? 0x55555555 : 0xaaaaaaaa );
+    case 4:  return( adr );
+    case 5:  return( ~adr );
+    default: return( RandomData( seed, adr ) );
+    }
+}
 
-        if( (adr < startAddr) || (adr >= (endAddr - 3)) ) {
-        	i--;
-        	continue;
+/*--------------------------------------------------------------------------*/
+/* count failure of adr in repeat table */
+/*--------------------------------------------------------------------------*/
+static void
+SoakFailAdd( SOAK_FAIL *tbl, u_int32 *nTbl, u_int32 adr )
+{
+    u_int32 i;
+
+    for( i=0; i<*nTbl; i++ )
+        if( tbl[i].adr == adr ) {
+            tbl[i].count++;
+            return;
         }
 
-        SRAM_SET_D32( adr, rndVal );
-        SRAM_GET_D32( adr, &val );
+    if( *nTbl < SOAK_MAX_FAIL ) {
+        tbl[*nTbl].adr   = adr;
+        tbl[*nTbl].count = 1;
+        (*nTbl)++;
+    }
+}
 
-        if( val != rndVal ) {
-            printmsg( 1, "Adr 0x%x: got value 0x%x (should be 0x%x)\n",
-                      adr, val, rndVal );
-            failed++;
-            FAIL_UNLESS_( 0 );
+/*--------------------------------------------------------------------------*/
+/* soak mode: fill/verify/scrub the range until duration expired
+ *
+ * Each iteration fills the range with the next pattern (burst write) and
+ * verifies it word by word (burst read). Every SOAK_SCRUB_MS, the data
+ * left resident by the previous iteration is scrubbed before the next
+ * fill: it is read once more and only its checksum is compared, so
+ * retention faults show up at little cost. A checksum mismatch is
+ * located word by word. Scrub mismatches are counted separately; only
+ * words that passed the verify are added to the failing addresses.
+ * Every interval seconds the error rate, throughput and repeatedly
+ * failing addresses are printed. */
+/*--------------------------------------------------------------------------*/
+static int
+Soak( DEVICE *d, u_int32 startAddr, u_int32 endAddr, u_int32 duration,
+      u_int32 interval )
+{
+    SOAK_FAIL fail[SOAK_MAX_FAIL];
+    u_int32 *exp = NULL, *rd = NULL, *sc = NULL;
+    u_int32 words, i, nFail = 0, sum, expSum = 0, seed, iter = 0;
+    u_int32 errTot = 0, errIv = 0, scrubErr = 0, scrubRet = 0;
+    double  t0, tIv, tScrub, now, accTot = 0, accIv = 0;
+    int     pat, resident = 0, failed = 1;
+
+    /* at least one word */
+    if( endAddr <= startAddr || endAddr - startAddr < 4 ) {
+        printf("*** soak: range 0x%x..0x%x too short\n", startAddr, endAddr );
+        goto ABORT;
+    }
+
+    words = (endAddr - startAddr) / 4;
+    FAIL_UNLESS_( (exp = malloc( words * 4 )) != NULL );
+    FAIL_UNLESS_( (rd  = malloc( words * 4 )) != NULL );
+    FAIL_UNLESS_( (sc  = malloc( words * 4 )) != NULL );
+
+    printf("=== Soak: 0x%x..0x%x for %us, report every %us, seed 0x%x\n",
+           startAddr, endAddr, duration, interval, G_seed );
+
+    t0 = tIv = tScrub = now = NsTime();
+
+    do {
+        /*--- scrub data left resident by previous iteration ---*/
+        if( resident && now - tScrub >= SOAK_SCRUB_MS * 1e6 ) {
+            FAIL_UNLESS( MMODPRG_BurstRead( d->path, startAddr, 4, words,
+                                            sc ) == 0 );
+            for( i=0, sum=0; i<words; i++ )
+                sum += sc[i];
+
+            if( sum != expSum )
+                for( i=0; i<words; i++ )
+                    if( sc[i] != exp[i] ) {
+                        printmsg( 1, "Scrub adr 0x%x: got value 0x%x "
+                                  "(should be 0x%x)\n", startAddr + i*4,
+                                  sc[i], exp[i] );
+                        scrubErr++;
+                        /* verify failure already recorded */
+                        if( rd[i] == exp[i] ) {
+                            SoakFailAdd( fail, &nFail, startAddr + i*4 );
+                            scrubRet++;
+                        }
+                    }
+
+            accIv += words;
+            tScrub = now;
+        }
+
+        pat  = iter % SOAK_PATTERNS;
+        seed = G_seed + iter++;
+
+        /*--- fill ---*/
+        for( i=0, expSum=0; i<words; i++ ) {
+            exp[i]  = SoakData( pat, i, startAddr + i*4, seed );
+            expSum += exp[i];
+        }
+        FAIL_UNLESS( MMODPRG_BurstWrite( d->path, startAddr, 4, words,
+                                         exp ) == 0 );
+
+        /*--- verify ---*/
+        FAIL_UNLESS( MMODPRG_BurstRead( d->path, startAddr, 4, words,
+                                        rd ) == 0 );
+        for( i=0; i<words; i++ )
+            if( rd[i] != exp[i] ) {
+                printmsg( 1, "Adr 0x%x: got value 0x%x (should be 0x%x)\n",
+                          startAddr + i*4, rd[i], exp[i] );
+                SoakFailAdd( fail, &nFail, startAddr + i*4 );
+                errIv++;
+            }
+
+        resident = 1;
+        accIv += 2.0 * words;
+        now = NsTime();
+
+        /*--- periodic report ---*/
+        if( now - tIv >= interval * 1e9 || now - t0 >= duration * 1e9 ) {
+            errTot += errIv;
+            accTot += accIv;
+
+            printf("[%7.0fs] iter %u: %.3f MB/s, errors %u (rate %.3g), "
+                   "total %u (rate %.3g), scrub mismatches %u "
+                   "(%u after good verify)\n",
+                   (now - t0) / 1e9, iter,
+                   accIv * 4 * 1e3 / (now - tIv), errIv,
+                   accIv ? errIv / accIv : 0.0, errTot,
+                   accTot ? errTot / accTot : 0.0, scrubErr, scrubRet );
+
+            for( i=0; i<nFail; i++ )
+                if( fail[i].count > 1 )
+                    printf("    repeated failure: adr 0x%x, %u times\n",
+                           fail[i].adr, fail[i].count );
+
+            errIv = 0;
+            accIv = 0;
+            tIv   = now;
+        }
+    } while( now - t0 < duration * 1e9 );
+
+    failed = errTot + scrubRet;
+
+ ABORT:
+    free( exp );
+    free( rd );
+    free( sc );
+    return( failed );
+}
+
+/*--------------------------------------------------------------------------*/
+/* March data word: background of word idx, optionally inverted */
+/*--------------------------------------------------------------------------*/
+static u_int32
+MarchData( const MARCH_ALG *alg, u_int32 idx, int inv )
+{
+    u_int32 bg = alg->checker ? ((idx & 1) ? 0xaaaaaaaa : 0x55555555) : 0;
+
+    return( inv ? ~bg : bg );
+}
+
+/*--------------------------------------------------------------------------*/
+/* compare March read, report mismatch */
+/*--------------------------------------------------------------------------*/
+static u_int32
+MarchCheck( DEVICE *d, u_int32 adr, u_int32 val, u_int32 sb )
+{
+    if( val == sb )
+        return( 0 );
+
+    printmsg( 1, "Adr 0x%x: got value 0x%x (should be 0x%x)\n", adr, val, sb );
+    FailRec( d, adr, val, sb );
+    return( 1 );
+}
+
+/*--------------------------------------------------------------------------*/
+/* apply one March element to all words of [startAddr, endAddr)
+ *
+ * Elements consisting of a single write or read in ascending or any
+ * order are done with burst transfers. All other elements are converted
+ * into micro-sequences (one READ/WRITE per operation and cell), so each
+ * driver call covers MMODPRG_SEQ_MAX_OPS operations in element order. */
+/*--------------------------------------------------------------------------*/
+static int
+MarchElem( DEVICE *d, const MARCH_ALG *alg, const MARCH_ELEM *e,
+           u_int32 startAddr, u_int32 endAddr, u_int8 *buf, u_int32 *failed )
+{
+    MMODPRG_SEQ_HDR *hdr = (MMODPRG_SEQ_HDR*)buf;
+    MMODPRG_SEQ_OP *op;
+    M_SG_BLOCK blk;
+    u_int32 *res, *data = (u_int32*)buf;
+    u_int32 nOps, nRd, words, cells, chunk, i, c, k, idx, r;
+
+    for( nOps=nRd=0; e->ops[nOps]; nOps++ )
+        if( M_IS_READ(e->ops[nOps]) )
+            nRd++;
+
+    words = (endAddr - startAddr) / 4;
+
+    /*--- single op in ascending order: burst ---*/
+    if( nOps == 1 && e->order != M_DOWN ) {
+        cells = MARCH_SEQ_SIZE / 4;
+
+        for( i=0; i<words; i+=chunk ) {
+            chunk = words - i < cells ? words - i : cells;
+
+            if( nRd ) {
+                FAIL_UNLESS( MMODPRG_BurstRead( d->path, startAddr + i*4, 4,
+                                                chunk, data ) == 0 );
+                d->accCnt += chunk;
+                for( c=0; c<chunk; c++ )
+                    *failed += MarchCheck( d, startAddr + (i+c)*4, data[c],
+                                           MarchData( alg, i+c,
+                                                      M_INV(e->ops[0]) ) );
+            }
+            else {
+                for( c=0; c<chunk; c++ )
+                    data[c] = MarchData( alg, i+c, M_INV(e->ops[0]) );
+                FAIL_UNLESS( MMODPRG_BurstWrite( d->path, startAddr + i*4, 4,
+                                                 chunk, data ) == 0 );
+                d->accCnt += chunk;
+            }
+        }
+        return( 0 );
+    }
+
+    /*--- general element: micro-sequence chunks ---*/
+    cells = MMODPRG_SEQ_MAX_OPS / nOps;
+    blk.data = (void*)buf;
+
+    for( i=0; i<words; i+=chunk ) {
+        chunk = words - i < cells ? words - i : cells;
+
+        memset( hdr, 0, sizeof(*hdr) );
+        hdr->nOps     = chunk * nOps;
+        hdr->nResults = chunk * nRd;
+        op  = (MMODPRG_SEQ_OP*)(hdr + 1);
+        res = (u_int32*)(op + hdr->nOps);
+        blk.size = MMODPRG_SEQ_SIZE( hdr->nOps, hdr->nResults );
+
+        for( c=0, r=0; c<chunk; c++ ) {
+            idx = (e->order == M_DOWN) ? words-1-(i+c) : i+c;
+
+            for( k=0; k<nOps; k++, op++ ) {
+                op->width  = 4;
+                op->offset = startAddr + idx*4;
+                op->mask   = 0;
+                if( M_IS_READ(e->ops[k]) ) {
+                    op->op    = MMODPRG_SEQ_READ;
+                    op->arg   = (u_int16)r++;
+                    op->value = 0;
+                }
+                else {
+                    op->op    = MMODPRG_SEQ_WRITE;
+                    op->arg   = 0;
+                    op->value = MarchData( alg, idx, M_INV(e->ops[k]) );
+                }
+            }
         }
 
-        rndVal = UOS_Random( rndVal );
+        FAIL_UNLESS( M_getstat( d->path, MMODPRG_BLK_SEQ, (int32*)&blk ) == 0 );
+        d->accCnt += hdr->nOps;
+
+        for( c=0, r=0; c<chunk; c++ ) {
+            idx = (e->order == M_DOWN) ? words-1-(i+c) : i+c;
+
+            for( k=0; k<nOps; k++ )
+                if( M_IS_READ(e->ops[k]) )
+                    *failed += MarchCheck( d, startAddr + idx*4, res[r++],
+                                           MarchData( alg, idx,
+                                                      M_INV(e->ops[k]) ) );
+        }
     }
 
+    return( 0 );
+ ABORT:
+    return( 1 );
+}
+
+/*--------------------------------------------------------------------------*/
+/* run March algorithm on [startAddr, endAddr) */
+/*--------------------------------------------------------------------------*/
+static int
+March( DEVICE *d, u_int32 startAddr, u_int32 endAddr, const MARCH_ALG *alg )
+{
+    const MARCH_ELEM *e;
+    u_int8 *buf;
+    u_int32 failed = 0;
+    int n;
+
+    FAIL_UNLESS_( (buf = malloc( MARCH_SEQ_SIZE )) != NULL );
+
+    for( e=alg->elem, n=0; e->ops[0]; e++, n++ ) {
+        printmsg( 2, "element %d...\n", n );
+
+        if( MarchElem( d, alg, e, startAddr, endAddr, buf, &failed ) ) {
+            failed++;
+            break;
+        }
+    }
+
+    free( buf );
     dumpSram( d, startAddr, 32 );
 
     return( failed );
@@ -562,6 +1461,724 @@ TestD( DEVICE *d, u_int32 startAddr, u_int32 endAddr )
     return( 1 );
 }
 
+static int
+TestMatsPlus( DEVICE *d, u_int32 startAddr, u_int32 endAddr )
+{
+    return( March( d, startAddr, endAddr, &G_matsPlus ) );
+}
+
+static int
+TestMarchCm( DEVICE *d, u_int32 startAddr, u_int32 endAddr )
+{
+    return( March( d, startAddr, endAddr, &G_marchCm ) );
+}
+
+static int
+TestMarchB( DEVICE *d, u_int32 startAddr, u_int32 endAddr )
+{
+    return( March( d, startAddr, endAddr, &G_marchB ) );
+}
+
+static int
+TestChecker( DEVICE *d, u_int32 startAddr, u_int32 endAddr )
+{
+    return( March( d, startAddr, endAddr, &G_checker ) );
+}
+
+/*--------------------------------------------------------------------------*/
+/* walking 1/0 on address lines
+ *
+ * Walking 1: test cells are startAddr and startAddr + 2^k (k >= 2) within
+ * the range. Walking 0: test cells are startAddr + m and
+ * startAddr + (m & ~2^k), m being all address bits of the largest power
+ * of two within the range (word aligned); if the range is no power of
+ * two, its top address line is only walked with 1.
+ * For each cell in turn the inverted background is written and all
+ * other test cells must still hold the background, so shorted or
+ * stuck address lines are detected. One micro-sequence per background. */
+/*--------------------------------------------------------------------------*/
+static int
+TestWalkAdr( DEVICE *d, u_int32 startAddr, u_int32 endAddr )
+{
+    MMODPRG_SEQ_HDR *hdr;
+    MMODPRG_SEQ_OP *op;
+    M_SG_BLOCK blk;
+    u_int32 adr[33], *res, nAdr, bg, mask, i, k, r, failed = 0;
+    u_int8 *buf = NULL;
+    int pass;
+
+    /* all address bits of the largest power of two within the range */
+    for( mask=3; mask < 0x7fffffff && mask * 2 + 2 <= endAddr - startAddr; )
+        mask = mask * 2 + 1;
+
+    FAIL_UNLESS_( (buf = malloc( MARCH_SEQ_SIZE )) != NULL );
+    blk.data = (void*)buf;
+
+    for( pass=0; pass<2; pass++ ) {
+        bg = pass ? 0xffffffff : 0;
+
+        /*--- collect test cells ---*/
+        if( pass == 0 ) {
+            adr[0] = startAddr;
+            for( nAdr=1, k=2; k<32 && (1UL<<k) < endAddr - startAddr; k++ )
+                adr[nAdr++] = startAddr + (1UL<<k);
+        }
+        else {
+            adr[0] = startAddr + (mask & ~3);
+            for( nAdr=1, k=2; k<32 && (1UL<<k) <= mask; k++ )
+                adr[nAdr++] = startAddr + (mask & ~3 & ~(1UL<<k));
+        }
+
+        printmsg( 2, "walking %d, %d address lines...\n", !pass, nAdr-1 );
+
+        hdr = (MMODPRG_SEQ_HDR*)buf;
+        memset( hdr, 0, sizeof(*hdr) );
+        hdr->nOps     = nAdr + nAdr * (nAdr + 1);
+        hdr->nResults = nAdr * (nAdr - 1);
+        op  = (MMODPRG_SEQ_OP*)(hdr + 1);
+        res = (u_int32*)(op + hdr->nOps);
+        blk.size = MMODPRG_SEQ_SIZE( hdr->nOps, hdr->nResults );
+        memset( op, 0, hdr->nOps * sizeof(*op) );
+
+        /* background */
+        for( i=0; i<nAdr; i++, op++ ) {
+            op->op = MMODPRG_SEQ_WRITE; op->width = 4;
+            op->offset = adr[i]; op->value = bg;
+        }
+
+        /* invert one cell, read all others, restore */
+        for( k=0, r=0; k<nAdr; k++ ) {
+            op->op = MMODPRG_SEQ_WRITE; op->width = 4;
+            op->offset = adr[k]; op->value = ~bg;
+            op++;
+            for( i=0; i<nAdr; i++ ) {
+                if( i == k )
+                    continue;
+                op->op = MMODPRG_SEQ_READ; op->width = 4;
+                op->offset = adr[i]; op->arg = (u_int16)r++;
+                op++;
+            }
+            op->op = MMODPRG_SEQ_WRITE; op->width = 4;
+            op->offset = adr[k]; op->value = bg;
+            op++;
+        }
+
+        FAIL_UNLESS( M_getstat( d->path, MMODPRG_BLK_SEQ, (int32*)&blk ) == 0 );
+        d->accCnt += hdr->nOps;
+
+        for( k=0, r=0; k<nAdr; k++ )
+            for( i=0; i<nAdr; i++ )
+                if( i != k && res[r++] != bg ) {
+                    printmsg( 1, "Adr 0x%x changed by writing 0x%x: "
+                              "got 0x%x (should be 0x%x)\n",
+                              adr[i], adr[k], res[r-1], bg );
+                    FailRec( d, adr[i], res[r-1], bg );
+                    failed++;
+                }
+    }
+
+    free( buf );
+    return( failed );
+ ABORT:
+    free( buf );
+    return( 1 );
+}
+
+/*--------------------------------------------------------------------------*/
+/* walking 1/0 on data lines at startAddr, one micro-sequence */
+/*--------------------------------------------------------------------------*/
+static int
+TestWalkData( DEVICE *d, u_int32 startAddr, u_int32 endAddr )
+{
+    u_int8 buf[MMODPRG_SEQ_SIZE(128, 64)];
+    MMODPRG_SEQ_HDR *hdr = (MMODPRG_SEQ_HDR*)buf;
+    MMODPRG_SEQ_OP *op = (MMODPRG_SEQ_OP*)(hdr + 1);
+    u_int32 *res = (u_int32*)(op + 128);
+    M_SG_BLOCK blk;
+    u_int32 k, sb, failed = 0;
+
+    memset( buf, 0, sizeof(buf) );
+    hdr->nOps     = 128;
+    hdr->nResults = 64;
+
+    for( k=0; k<64; k++ ) {
+        sb = (k < 32) ? (1UL << k) : ~(1UL << (k-32));
+        op->op = MMODPRG_SEQ_WRITE; op->width = 4;
+        op->offset = startAddr; op->value = sb;
+        op++;
+        op->op = MMODPRG_SEQ_READ; op->width = 4;
+        op->offset = startAddr; op->arg = (u_int16)k;
+        op++;
+    }
+
+    blk.size = sizeof(buf);
+    blk.data = (void*)buf;
+    FAIL_UNLESS( M_getstat( d->path, MMODPRG_BLK_SEQ, (int32*)&blk ) == 0 );
+    d->accCnt += hdr->nOps;
+
+    for( k=0; k<64; k++ ) {
+        sb = (k < 32) ? (1UL << k) : ~(1UL << (k-32));
+        failed += MarchCheck( d, startAddr, res[k], sb );
+    }
+
+    return( failed );
+ ABORT:
+    return( 1 );
+}
+
+/*--------------------------------------------------------------------------*/
+/* get MMODPRG_BLK_Dxx code for access width */
+/*--------------------------------------------------------------------------*/
+static int
+WidthCode( u_int32 width )
+{
+    return( width == 1 ? MMODPRG_BLK_D8 :
+            width == 2 ? MMODPRG_BLK_D16 : MMODPRG_BLK_D32 );
+}
+
+/*--------------------------------------------------------------------------*/
+/* one throughput pass over nAcc elements */
+/*--------------------------------------------------------------------------*/
+static int
+PerfPass( DEVICE *d, PERF_MODE *pm, u_int32 width, u_int32 *offs,
+          u_int32 nAcc, u_int8 *buf )
+{
+    u_int32 i, val;
+    int code = WidthCode( width );
+
+    if( pm->bulk ) {
+        if( pm->write ) {
+            FAIL_UNLESS( MMODPRG_BurstWrite( d->path, offs[0], width,
+                                             nAcc, buf ) == 0 );
+        }
+        else {
+            FAIL_UNLESS( MMODPRG_BurstRead( d->path, offs[0], width,
+                                            nAcc, buf ) == 0 );
+        }
+        return( 0 );
+    }
+
+    for( i=0; i<nAcc; i++ ) {
+        if( pm->write ) {
+            FAIL_UNLESS( MMODPRG_SetValue( d->path, code, offs[i], i ) == 0 );
+        }
+        else {
+            FAIL_UNLESS( MMODPRG_GetValue( d->path, code, offs[i], &val ) == 0 );
+        }
+    }
+
+    return( 0 );
+ ABORT:
+    return( 1 );
+}
+
+/*--------------------------------------------------------------------------*/
+/* throughput mode: time sequential/random/bulk passes at D8/D16/D32 */
+/*--------------------------------------------------------------------------*/
+static int
+Perf( DEVICE *d, u_int32 startAddr, u_int32 endAddr )
+{
+    static const u_int32 widths[] = { 1, 2, 4 };
+    PERF_MODE *pm;
+    u_int32 *seqOffs = NULL, *rndOffs = NULL;
+    u_int8  *buf = NULL;
+    u_int32 w, width, nAcc, i, j, tmp, rnd, passes, t0, ms;
+    double  accesses;
+    int     bulk, failed = 0;
+
+    FAIL_UNLESS_( (seqOffs = malloc( (endAddr-startAddr) * 4 )) != NULL );
+    FAIL_UNLESS_( (rndOffs = malloc( (endAddr-startAddr) * 4 )) != NULL );
+    FAIL_UNLESS_( (buf = malloc( endAddr-startAddr )) != NULL );
+
+    /* bulk passes only if driver supports burst transfers */
+    bulk = (MMODPRG_BurstRead( d->path, startAddr, 1, 1, buf ) == 0);
+
+    printf("=== Throughput 0x%x..0x%x%s\n", startAddr, endAddr,
+           bulk ? "" : " (no bulk path)" );
+    printf("%-14s %-5s %12s %12s %10s\n",
+           "mode", "width", "accesses", "ns/access", "MB/s" );
+
+    for( w=0; w<sizeof(widths)/sizeof(widths[0]); w++ ) {
+        width = widths[w];
+        nAcc  = (endAddr - startAddr) / width;
+
+        /* sequential and shuffled address lists */
+        for( i=0; i<nAcc; i++ )
+            seqOffs[i] = rndOffs[i] = startAddr + i * width;
+
+        rnd = UOS_Random( 0 );
+        for( i=nAcc-1; i>0; i-- ) {
+            rnd = UOS_Random( rnd );
+            j = rnd % (i+1);
+            tmp = rndOffs[i]; rndOffs[i] = rndOffs[j]; rndOffs[j] = tmp;
+        }
+
+        for( pm=G_perfModes; pm->descr; pm++ ) {
+            if( pm->bulk && !bulk )
+                continue;
+
+            passes = 0;
+            t0 = UOS_MsecTimerGet();
+            do {
+                if( PerfPass( d, pm, width, pm->random ? rndOffs : seqOffs,
+                              nAcc, buf ) ) {
+                    failed++;
+                    goto ABORT;
+                }
+                passes++;
+                ms = UOS_MsecTimerGet() - t0;
+            } while( ms < PERF_MIN_MS );
+
+            accesses = (double)passes * nAcc;
+            printf("%-14s D%-4d %12.0f %12.1f %10.3f\n",
+                   pm->descr, width*8, accesses,
+                   ms * 1e6 / accesses,
+                   accesses * width / (ms * 1e3) );
+        }
+    }
+
+ ABORT:
+    free( seqOffs );
+    free( rndOffs );
+    free( buf );
+    return( failed );
+}
+
+/*--------------------------------------------------------------------------*/
+/* monotonic time in ns */
+/*--------------------------------------------------------------------------*/
+static double
+NsTime( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return( ts.tv_sec * 1e9 + ts.tv_nsec );
+}
+
+/*--------------------------------------------------------------------------*/
+/* latency histogram bucket: exact below LAT_SUB ns, else LAT_SUB buckets
+ * per power of two (resolution 1/LAT_SUB) */
+/*--------------------------------------------------------------------------*/
+static int
+LatBucket( u_int32 ns )
+{
+    int e;
+
+    if( ns < LAT_SUB )
+        return( ns );
+
+    for( e=4; e<31 && (ns >> (e+1)); e++ )
+        ;
+    return( (e-3) * LAT_SUB + ((ns >> (e-4)) & (LAT_SUB-1)) );
+}
+
+/*--------------------------------------------------------------------------*/
+/* lower bound [ns] of a latency histogram bucket */
+/*--------------------------------------------------------------------------*/
+static u_int32
+LatValue( int b )
+{
+    if( b < LAT_SUB )
+        return( b );
+
+    return( (u_int32)(LAT_SUB + b % LAT_SUB) << (b / LAT_SUB - 1) );
+}
+
+/*--------------------------------------------------------------------------*/
+/* latency percentile (0..1) of a stress worker from its histogram */
+/*--------------------------------------------------------------------------*/
+static u_int32
+LatPercentile( const STRESS_JOB *j, double p )
+{
+    u_int32 rank = (u_int32)(j->accesses * p), sum = 0;
+    int b;
+
+    for( b=0; b<LAT_BUCKETS; b++ ) {
+        sum += j->lat[b];
+        if( sum > rank )
+            return( LatValue( b ) );
+    }
+    return( j->latMax );
+}
+
+/*--------------------------------------------------------------------------*/
+/* record one stress access latency */
+/*--------------------------------------------------------------------------*/
+static void
+LatAdd( STRESS_JOB *j, double ns )
+{
+    u_int32 v = ns < 4e9 ? (u_int32)ns : 0xffffffff;
+
+    j->lat[LatBucket( v )]++;
+    if( v > j->latMax )
+        j->latMax = v;
+    j->accesses++;
+}
+
+/*--------------------------------------------------------------------------*/
+/* stress worker: write/read/verify own range, record call latencies */
+/*--------------------------------------------------------------------------*/
+static void*
+StressWorker( void *arg )
+{
+    STRESS_JOB *j = (STRESS_JOB*)arg;
+    DEVICE *d = &j->d;
+    u_int32 adr, val, sb;
+    double t0;
+    int pass;
+
+    j->rc = 1;
+
+    for( pass=0; pass<j->passes; pass++ ) {
+        /*--- write pattern, unique per worker and pass ---*/
+        for( adr=j->startAddr; adr<j->endAddr; adr+=4 ) {
+            sb = adr ^ ((u_int32)j->id << 24) ^ (pass * 0x9e3779b9);
+            t0 = NsTime();
+            SRAM_SET_D32( adr, sb );
+            LatAdd( j, NsTime() - t0 );
+        }
+
+        /*--- read back and verify ---*/
+        for( adr=j->startAddr; adr<j->endAddr; adr+=4 ) {
+            sb = adr ^ ((u_int32)j->id << 24) ^ (pass * 0x9e3779b9);
+            t0 = NsTime();
+            SRAM_GET_D32( adr, &val );
+            LatAdd( j, NsTime() - t0 );
+
+            if( val != sb ) {
+                printmsg( 1, "thr %d: adr 0x%x: got 0x%x (should be 0x%x)\n",
+                          j->id, adr, val, sb );
+                j->errors++;
+            }
+        }
+    }
+
+    j->rc = 0;
+ ABORT:
+    return( NULL );
+}
+
+/*--------------------------------------------------------------------------*/
+/* stress mode: nThr threads with own paths on disjoint ranges */
+/*--------------------------------------------------------------------------*/
+static int
+Stress( char *name, int nThr, u_int32 startAddr, u_int32 endAddr, int passes )
+{
+    STRESS_JOB *job = NULL, *j;
+    u_int32 words, chunk, total = 0, errors = 0;
+    double t0, ns;
+    int n, started, failed = 1;
+
+    words = (endAddr - startAddr) / 4;
+    FAIL_UNLESS_( words >= (u_int32)nThr );
+    chunk = words / nThr;
+
+    /* access counters are 32 bit */
+    if( (double)words * 2 * passes > 0xffffffff ) {
+        printf("*** stress: range too large for %d passes\n", passes );
+        goto ABORT;
+    }
+
+    FAIL_UNLESS_( (job = calloc( nThr, sizeof(STRESS_JOB) )) != NULL );
+    for( n=0; n<nThr; n++ )
+        job[n].d.path = -1;
+
+    /*--- open one path per worker ---*/
+    for( n=0; n<nThr; n++ ) {
+        j = &job[n];
+        j->id        = n;
+        j->d.name    = name;
+        j->passes    = passes;
+        j->startAddr = startAddr + n * chunk * 4;
+        j->endAddr   = (n == nThr-1) ? startAddr + words * 4 :
+                       j->startAddr + chunk * 4;
+
+        FAIL_UNLESS( (j->d.path = M_open( name )) >= 0 );
+    }
+
+    /*--- run workers concurrently ---*/
+    t0 = NsTime();
+
+    for( started=0; started<nThr; started++ )
+        if( pthread_create( &job[started].tid, NULL, StressWorker,
+                            &job[started] ) != 0 )
+            break;
+    for( n=0; n<started; n++ )
+        pthread_join( job[n].tid, NULL );
+
+    ns = NsTime() - t0;
+    FAIL_UNLESS_( started == nThr );
+
+    /*--- report ---*/
+    printf("=== Stress: %d threads, 0x%x..0x%x, %d passes\n",
+           nThr, startAddr, endAddr, passes );
+    printf("%-4s %-17s %10s %7s %9s %9s %9s %9s\n", "thr", "range",
+           "accesses", "errors", "p50[ns]", "p99[ns]", "p99.9[ns]",
+           "max[ns]" );
+
+    for( n=0; n<nThr; n++ ) {
+        j = &job[n];
+        printf("%-4d 0x%06x..0x%06x %10u %7u %9u %9u %9u %9u%s\n",
+               j->id, j->startAddr, j->endAddr, j->accesses, j->errors,
+               LatPercentile( j, 0.5 ), LatPercentile( j, 0.99 ),
+               LatPercentile( j, 0.999 ), j->latMax,
+               j->rc ? "  *** driver call failed" : "" );
+
+        total  += j->accesses;
+        errors += j->errors;
+    }
+
+    printf("aggregate: %u accesses in %.1f ms, %.0f ns/access, %.3f MB/s, "
+           "%u integrity errors\n", total, ns / 1e6,
+           total ? ns / total : 0.0, total * 4 * 1e3 / ns, errors );
+
+    for( failed=errors, n=0; n<nThr; n++ )
+        failed += job[n].rc;
+
+ ABORT:
+    if( job ) {
+        for( n=0; n<nThr; n++ ) {
+            if( job[n].d.path >= 0 )
+                M_close( job[n].d.path );
+        }
+        free( job );
+    }
+    return( failed );
+}
+
+/*--------------------------------------------------------------------------*/
+/* run test list on an opened device, returns number of failed tests
+ *
+ * The results are stored in j->res (allocated here). In quiet mode, one
+ * line per test run prefixed with the device name is printed instead of
+ * the progress output, so that several devices can report concurrently. */
+/*--------------------------------------------------------------------------*/
+static int
+RunTests( DEV_JOB *j )
+{
+    DEVICE *d = &j->d;
+    TEST_ELEM *te;
+    TEST_RESULT *r;
+    char *tCode;
+    double t0, tStart;
+    int n, err;
+
+    j->errCount = 0;
+    j->nRes     = 0;
+    tStart      = NsTime();
+
+    if( (j->res = calloc( strlen(j->testlist) * j->runs,
+                          sizeof(TEST_RESULT) )) == NULL ) {
+        printf("*** can't allocate result table\n");
+        return( ++j->errCount );
+    }
+
+    for( tCode=j->testlist; *tCode; tCode++ ){
+
+        for( te=G_testList; te->func; te++ )
+            if( *tCode == te->code )
+                break;
+
+        if( te->func == NULL ){
+            printf("Unknown test: %c\n", *tCode );
+            j->errCount++;
+            goto ABORT;
+        }
+
+        for( n=0; n<j->runs; ++n ) {
+
+            if( j->wait ) {
+                printf( "Hit <Return> for test %c.\n", te->code );
+                getchar();
+            }
+
+            if( !j->quiet ) {
+                printf("=== Performing test %c: %-43s ", te->code,
+                       te->descr );
+                printmsg( 1, "===\n");
+                fflush(stdout);
+            }
+
+            d->accCnt    = 0;
+            d->failValid = 0;
+            t0 = NsTime();
+
+            err = te->func( d, j->startAddr, j->endAddr );
+            j->errCount += err;
+
+            r = &j->res[j->nRes++];
+            r->te        = te;
+            r->run       = n;
+            r->ms        = (NsTime() - t0) / 1e6;
+            r->accesses  = d->accCnt;
+            r->errors    = err;
+            r->failValid = d->failValid;
+            r->failAdr   = d->failAdr;
+            r->failVal   = d->failVal;
+            r->failSb    = d->failSb;
+
+            if( j->quiet )
+                printf("%s: test %c run %d: %s\n", d->name, te->code, n,
+                       err ? "FAILED" : "ok" );
+            else {
+                printmsg( 1, "Test %c: ", te->code);
+                printf( "%s\n", err ? "FAILED" : "ok" );
+            }
+
+            if( err && j->stopOnFirst )
+                goto ABORT;
+        }
+    }
+
+ ABORT:
+    j->ms = (NsTime() - tStart) / 1e6;
+    return( j->errCount );
+}
+
+/*--------------------------------------------------------------------------*/
+/* multi-device worker: open, size probe, run test list, close */
+/*--------------------------------------------------------------------------*/
+static void*
+DevWorker( void *arg )
+{
+    DEV_JOB *j = (DEV_JOB*)arg;
+    DEVICE *d = &j->d;
+    int32 sramSize;
+
+    j->rc = 1;
+
+    FAIL_UNLESS( (d->path = M_open( d->name )) >= 0 );
+
+    sramSize = SramSizeGet( d );
+
+    if( 0 == j->endAddr || j->endAddr > (u_int32)sramSize )
+        j->endAddr = sramSize;
+
+    FAIL_UNLESS_( j->endAddr > j->startAddr );
+    FAIL_UNLESS( Init( d ) == 0 );
+
+    RunTests( j );
+    j->rc = 0;
+
+    Deinit( d );
+ ABORT:
+    if( d->path >= 0 )
+        M_close( d->path );
+    return( NULL );
+}
+
+/*--------------------------------------------------------------------------*/
+/* multi-device mode: run test list on nDev devices, one thread each
+ *
+ * Each device gets its own path and the same random test seed, so a
+ * failure can be reproduced on that device alone with -S=. Returns the
+ * number of failed tests plus the number of devices that could not be
+ * tested. */
+/*--------------------------------------------------------------------------*/
+static int
+MultiDev( char **names, int nDev, char *testlist, int runs, int stopOnFirst,
+          u_int32 startAddr, u_int32 endAddr )
+{
+    DEV_JOB *job, *j;
+    TEST_ELEM *te;
+    TEST_RESULT *r;
+    u_int32 accesses;
+    double t0, wall, ms, sumMs = 0;
+    int n, k, started, nRun, nFail;
+    int tests = 0, failed = 0, devFailed = 0, untested = 0;
+
+    if( (job = calloc( nDev, sizeof(DEV_JOB) )) == NULL )
+        return( nDev );
+
+    for( n=0; n<nDev; n++ ) {
+        j = &job[n];
+        j->d.name      = names[n];
+        j->d.path      = -1;
+        j->d.seed      = G_seed;
+        j->startAddr   = startAddr;
+        j->endAddr     = endAddr;
+        j->testlist    = testlist;
+        j->runs        = runs;
+        j->stopOnFirst = stopOnFirst;
+        j->quiet       = 1;
+        j->rc          = 1;
+    }
+
+    printf("=== Testing %d devices concurrently, tests %s, %d runs each\n",
+           nDev, testlist, runs );
+    if( strchr( testlist, 'd' ) )
+        printf("Random test seed: -S=%x\n", G_seed );
+
+    /*--- run one thread per device ---*/
+    t0 = NsTime();
+
+    for( started=0; started<nDev; started++ )
+        if( pthread_create( &job[started].tid, NULL, DevWorker,
+                            &job[started] ) != 0 )
+            break;
+    for( n=0; n<started; n++ )
+        pthread_join( job[n].tid, NULL );
+
+    wall = (NsTime() - t0) / 1e6;
+
+    if( started < nDev )
+        printf("*** can't create thread for %s\n", names[started] );
+
+    /*--- per-device results ---*/
+    for( n=0; n<nDev; n++ ) {
+        j = &job[n];
+
+        printf("------------------------------------------------\n");
+        if( j->rc ) {
+            printf("%s: *** not tested (open/init failed)\n", j->d.name );
+            untested++;
+            continue;
+        }
+
+        printf("%s: 0x%x..0x%x, %d errors, %.1f ms\n", j->d.name,
+               j->startAddr, j->endAddr, j->errCount, j->ms );
+
+        /* one line per test, runs combined */
+        for( te=G_testList; te->func; te++ ) {
+            for( k=0, nRun=0, nFail=0, accesses=0, ms=0; k<j->nRes; k++ ) {
+                r = &j->res[k];
+                if( r->te != te )
+                    continue;
+                nRun++;
+                nFail    += !!r->errors;
+                accesses += r->accesses;
+                ms       += r->ms;
+            }
+            if( nRun == 0 )
+                continue;
+
+            printf("  test %c: %-43s %s (%d of %d runs failed, %.1f ms, "
+                   "%.1f ns/access)\n", te->code, te->descr,
+                   nFail ? "FAILED" : "ok", nFail, nRun, ms,
+                   accesses ? ms * 1e6 / accesses : 0.0 );
+        }
+
+        tests  += j->nRes;
+        failed += j->errCount;
+        sumMs  += j->ms;
+        if( j->errCount )
+            devFailed++;
+    }
+
+    /*--- aggregated summary ---*/
+    printf("------------------------------------------------\n");
+    printf("TEST RESULT: %d errors in %d test runs, %d of %d devices "
+           "failed, %d not tested\n", failed, tests, devFailed, nDev,
+           untested );
+    printf("wall time %.1f ms, sum of device times %.1f ms\n", wall, sumMs );
+
+    for( n=0; n<nDev; n++ )
+        free( job[n].res );
+    free( job );
+
+    return( failed + untested );
+}
 
 #if 0
 /* template */
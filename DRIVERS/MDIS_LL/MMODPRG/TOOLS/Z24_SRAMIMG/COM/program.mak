@@ -0,0 +1,46 @@
+#***************************  M a k e f i l e  *******************************
+#
+#         Author: kp
+#
+#    Description: Makefile definitions for z24 SRAM image save/restore tool
+#
+#-----------------------------------------------------------------------------
+#   Copyright 2019, MEN Mikro Elektronik GmbH
+#*****************************************************************************
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+MAK_NAME=z24_sramimg
+# the next line is updated during the MDIS installation
+STAMPED_REVISION="13Z024-06_01_03-3-g520fb94-dirty_2019-05-30"
+
+DEF_REVISION=MAK_REVISION=$(STAMPED_REVISION)
+MAK_SWITCH= \
+		$(SW_PREFIX)$(DEF_REVISION)
+
+MAK_LIBS=$(LIB_PREFIX)$(MEN_LIB_DIR)/mdis_api$(LIB_SUFFIX)	\
+         $(LIB_PREFIX)$(MEN_LIB_DIR)/usr_oss$(LIB_SUFFIX)	\
+         $(LIB_PREFIX)$(MEN_LIB_DIR)/usr_utl$(LIB_SUFFIX)	\
+         $(LIB_PREFIX)$(MEN_LIB_DIR)/mmodprg_api$(LIB_SUFFIX)	\
+         -lpthread	\
+
+MAK_INCL=$(MEN_INC_DIR)/mmodprg_drv.h	\
+         $(MEN_INC_DIR)/mmodprg_api.h	\
+         $(MEN_INC_DIR)/men_typs.h	\
+         $(MEN_INC_DIR)/mdis_api.h	\
+         $(MEN_INC_DIR)/usr_oss.h	\
+         $(MEN_INC_DIR)/usr_utl.h	\
+
+MAK_INP1=z24_sramimg$(INP_SUFFIX)
+
+MAK_INP=$(MAK_INP1)
@@ -0,0 +1,626 @@
+/****************************************************************************
+ ************                                                    ************
+ ************                     Z24_SRAMIMG                    ************
+ ************                                                    ************
+ ****************************************************************************/
+/*!
+ *         \file z24_sramimg.c
+ *       \author kp
+ *
+ *        \brief Save/restore Z24 SRAM contents to/from an image file
+ *
+ *               The image file starts with an IMG_HDR (offset, size,
+ *               access width, byte order marker, CRC-32 of the data),
+ *               followed by the data as array of elements of the access
+ *               width in the byte order of the saving host.
+ *
+ *               Device I/O uses burst transfers (single accesses if the
+ *               driver has no burst code). File I/O runs in a second
+ *               thread on a double buffer, so file and device I/O overlap.
+ *
+ *     Required: libraries: mdis_api, usr_oss, usr_utl, mmodprg_api
+ *               drivers:   mmodprg
+ *     \switches see usage()
+ */
+ /*
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include <MEN/men_typs.h>
+#include <MEN/usr_oss.h>
+#include <MEN/usr_utl.h>
+#include <MEN/mdis_api.h>
+#include <MEN/mmodprg_drv.h>
+#include <MEN/mmodprg_api.h>
+
+static const char IdentString[]=MENT_XSTR(MAK_REVISION);
+
+/*--------------------------------------+
+|   DEFINES                             |
++--------------------------------------*/
+#define IMG_MAGIC        0x5a323449     /* "Z24I" */
+#define IMG_VERSION      1
+#define IMG_BYTEORDER    0x01020304     /* as written by saving host */
+#define IMG_BYTEORDER_SW 0x04030201     /* saved on other endianness */
+
+#define CHUNK_SIZE       0x10000        /* bytes per pipeline buffer */
+
+/*--------------------------------------+
+|   TYPDEFS                             |
++--------------------------------------*/
+/* image file header */
+typedef struct {
+    u_int32 magic;                      /* IMG_MAGIC */
+    u_int32 version;                    /* IMG_VERSION */
+    u_int32 offset;                     /* start offset in window */
+    u_int32 size;                       /* data size [bytes] */
+    u_int32 width;                      /* access width (1, 2 or 4) */
+    u_int32 byteOrder;                  /* IMG_BYTEORDER */
+    u_int32 crc;                        /* CRC-32 of data */
+    u_int32 reserved;
+} IMG_HDR;
+
+/* double buffer between device and file thread */
+typedef struct {
+    u_int8  *buf[2];
+    u_int32 len[2];                     /* valid bytes */
+    int     full[2];                    /* buffer filled by producer */
+    int     done;                       /* producer finished */
+    int     err;                        /* error, abort pipeline */
+    FILE    *fp;
+    u_int32 size;                       /* total bytes to transfer */
+    u_int32 crc;                        /* CRC-32 of transferred data */
+    pthread_mutex_t mtx;
+    pthread_cond_t  cond;
+} PIPE;
+
+/*--------------------------------------+
+|   PROTOTYPES                          |
++--------------------------------------*/
+static int   Save( MDIS_PATH path, char *file, u_int32 offs, u_int32 size,
+                   u_int32 width );
+static int   Restore( MDIS_PATH path, char *file, int verify );
+static int   DevXfer( MDIS_PATH path, u_int32 offs, u_int32 width,
+                      u_int32 size, u_int8 *buf, int write );
+static u_int32 Crc32( u_int32 crc, const u_int8 *p, u_int32 len );
+
+/*--------------------------------------+
+|   GLOBALS                             |
++--------------------------------------*/
+static u_int32 G_crcTbl[256];
+static int     G_bulk;                  /* driver supports bursts */
+
+/********************************* usage ************************************
+ *
+ *  Description: Print program usage
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: -
+ *  Output.....: -
+ *  Globals....: -
+ ****************************************************************************/
+static void usage(void)
+{
+    printf("Usage: z24_sramimg [<opts>] <device> [<opts>]\n");
+    printf("Function: Save/restore SRAM contents to/from image file\n");
+    printf("Options:\n");
+    printf("  -s=<file>    save SRAM range to image file\n");
+    printf("  -r=<file>    restore image file to SRAM (at saved offset)\n");
+    printf("  -b=<offs>    save: start addr...................... [0]\n");
+    printf("  -e=<offs>    save: end addr (+1)................... [window size]\n");
+    printf("  -p           save: probe SRAM size for -e default.. [no]\n");
+    printf("               (destructive, writes test markers to the SRAM)\n");
+    printf("  -w=<n>       save: access width 1/2/4 bytes........ [4]\n");
+    printf("  -n           restore: don't verify................. [verify]\n");
+    printf("\n");
+    printf("Copyright 2019, MEN Mikro Elektronik GmbH\n%s\n", IdentString);
+}
+
+/********************************* main *************************************
+ *
+ *  Description: Program main function
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: argc,argv  argument counter, data ..
+ *  Output.....: return     success (0) or error (1)
+ *  Globals....: -
+ ****************************************************************************/
+int main(int argc, char *argv[])
+{
+    MDIS_PATH path = -1;
+    char    buf[80];
+    char    *str, *errstr, *device = NULL, *saveFile, *restFile;
+    u_int32 startAddr = 0, endAddr = 0, width, n, c, k;
+    int32   sramSize;
+    int     ret = 1;
+
+    /*--------------------+
+    |  check arguments    |
+    +--------------------*/
+    if ((errstr = UTL_ILLIOPT("s=r=b=e=w=np?", buf))) {
+        printf("*** %s\n", errstr);
+        return(1);
+    }
+
+    if (UTL_TSTOPT("?")) {
+        usage();
+        return(1);
+    }
+
+    for (n=1; n<(u_int32)argc; n++)
+        if (*argv[n] != '-')
+            device = argv[n];
+
+    saveFile = UTL_TSTOPT("s=");
+    restFile = UTL_TSTOPT("r=");
+    width    = ((str = UTL_TSTOPT("w=")) ? atoi(str) : 4);
+
+    if (device == NULL || !saveFile == !restFile ||
+        (width != 1 && width != 2 && width != 4)) {
+        usage();
+        return(1);
+    }
+
+    if( (str = UTL_TSTOPT("b=")) )
+        startAddr = strtoul(str, NULL, 16);
+    if( (str = UTL_TSTOPT("e=")) )
+        endAddr = strtoul(str, NULL, 16);
+
+    /* CRC-32 table (IEEE 802.3, reflected) */
+    for( n=0; n<256; n++ ) {
+        for( c=n, k=0; k<8; k++ )
+            c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        G_crcTbl[n] = c;
+    }
+
+    /*--------------------+
+    |  open device        |
+    +--------------------*/
+    if( (path = M_open(device)) < 0 ) {
+        printf("*** can't open %s: %s\n", device, M_errstring(UOS_ErrnoGet()));
+        return(1);
+    }
+
+    /* largest transfer path: bursts if supported by driver */
+    G_bulk = (MMODPRG_BurstRead( path, 0, 1, 1, buf ) == 0);
+
+    if( saveFile ) {
+        /* the size probe writes markers, only on request */
+        if( (!UTL_TSTOPT("p") ||
+             M_getstat( path, MMODPRG_SRAM_SIZE, &sramSize ) != 0) &&
+            M_getstat( path, MMODPRG_WIN_SIZE, &sramSize ) != 0 ) {
+            printf("*** can't get SRAM size, use -e=\n");
+            sramSize = endAddr;
+        }
+        if( endAddr == 0 || endAddr > (u_int32)sramSize )
+            endAddr = sramSize;
+
+        startAddr &= ~(width-1);
+        endAddr   &= ~(width-1);
+        if( endAddr <= startAddr ) {
+            printf("*** empty range 0x%x..0x%x\n", startAddr, endAddr);
+            goto ABORT;
+        }
+
+        ret = Save( path, saveFile, startAddr, endAddr - startAddr, width );
+    }
+    else
+        ret = Restore( path, restFile, !UTL_TSTOPT("n") );
+
+ ABORT:
+    M_close( path );
+    return( ret );
+}
+
+/*--------------------------------------------------------------------------*/
+/* update CRC-32 (init/final xor done by caller) */
+/*--------------------------------------------------------------------------*/
+static u_int32
+Crc32( u_int32 crc, const u_int8 *p, u_int32 len )
+{
+    while( len-- )
+        crc = G_crcTbl[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+    return( crc );
+}
+
+/*--------------------------------------------------------------------------*/
+/* transfer size bytes between device and buffer, bursts if available */
+/*--------------------------------------------------------------------------*/
+static int
+DevXfer( MDIS_PATH path, u_int32 offs, u_int32 width, u_int32 size,
+         u_int8 *buf, int write )
+{
+    int code = width == 1 ? MMODPRG_BLK_D8 :
+               width == 2 ? MMODPRG_BLK_D16 : MMODPRG_BLK_D32;
+    u_int32 i, val;
+
+    if( G_bulk )
+        return( write ? MMODPRG_BurstWrite( path, offs, width, size/width, buf )
+                      : MMODPRG_BurstRead( path, offs, width, size/width, buf ) );
+
+    for( i=0; i<size; i+=width ) {
+        if( write ) {
+            val = width == 1 ? buf[i] :
+                  width == 2 ? *(u_int16*)&buf[i] : *(u_int32*)&buf[i];
+            if( MMODPRG_SetValue( path, code, offs+i, val ) )
+                return( UOS_ErrnoGet() );
+        }
+        else {
+            if( MMODPRG_GetValue( path, code, offs+i, &val ) )
+                return( UOS_ErrnoGet() );
+            if( width == 1 )
+                buf[i] = (u_int8)val;
+            else if( width == 2 )
+                *(u_int16*)&buf[i] = (u_int16)val;
+            else
+                *(u_int32*)&buf[i] = val;
+        }
+    }
+    return( 0 );
+}
+
+/*--------------------------------------------------------------------------*/
+/* pipeline: wait for buffer b to become full (consumer) or empty
+ * (producer), returns 0 if pipeline aborted or producer done */
+/*--------------------------------------------------------------------------*/
+static int
+PipeWait( PIPE *p, int b, int full )
+{
+    int ok;
+
+    pthread_mutex_lock( &p->mtx );
+    while( p->full[b] != full && !p->err && !(full && p->done) )
+        pthread_cond_wait( &p->cond, &p->mtx );
+    ok = (p->full[b] == full) && !p->err;
+    pthread_mutex_unlock( &p->mtx );
+
+    return( ok );
+}
+
+/*--------------------------------------------------------------------------*/
+/* pipeline: mark buffer b full (producer) or empty (consumer) */
+/*--------------------------------------------------------------------------*/
+static void
+PipeSignal( PIPE *p, int b, int full )
+{
+    pthread_mutex_lock( &p->mtx );
+    p->full[b] = full;
+    pthread_cond_broadcast( &p->cond );
+    pthread_mutex_unlock( &p->mtx );
+}
+
+/*--------------------------------------------------------------------------*/
+/* pipeline: producer finished or aborted */
+/*--------------------------------------------------------------------------*/
+static void
+PipeEnd( PIPE *p, int err )
+{
+    pthread_mutex_lock( &p->mtx );
+    p->done = 1;
+    if( err )
+        p->err = 1;
+    pthread_cond_broadcast( &p->cond );
+    pthread_mutex_unlock( &p->mtx );
+}
+
+/*--------------------------------------------------------------------------*/
+/* save: file thread writes buffers filled by device thread */
+/*--------------------------------------------------------------------------*/
+static void*
+SaveWriter( void *arg )
+{
+    PIPE *p = (PIPE*)arg;
+    int b;
+
+    for( b=0; PipeWait( p, b, 1 ); b ^= 1 ) {
+        p->crc = Crc32( p->crc, p->buf[b], p->len[b] );
+        if( fwrite( p->buf[b], 1, p->len[b], p->fp ) != p->len[b] ) {
+            printf("*** write error\n");
+            PipeEnd( p, 1 );
+            break;
+        }
+        PipeSignal( p, b, 0 );
+    }
+    return( NULL );
+}
+
+/*--------------------------------------------------------------------------*/
+/* restore: file thread reads buffers consumed by device thread */
+/*--------------------------------------------------------------------------*/
+static void*
+RestoreReader( void *arg )
+{
+    PIPE *p = (PIPE*)arg;
+    u_int32 done;
+    int b;
+
+    for( b=0, done=0; done < p->size; b ^= 1 ) {
+        if( !PipeWait( p, b, 0 ) )
+            return( NULL );
+
+        p->len[b] = p->size - done < CHUNK_SIZE ? p->size - done : CHUNK_SIZE;
+        if( fread( p->buf[b], 1, p->len[b], p->fp ) != p->len[b] ) {
+            printf("*** image file truncated\n");
+            PipeEnd( p, 1 );
+            return( NULL );
+        }
+        p->crc = Crc32( p->crc, p->buf[b], p->len[b] );
+        done  += p->len[b];
+        PipeSignal( p, b, 1 );
+    }
+    PipeEnd( p, 0 );
+    return( NULL );
+}
+
+/*--------------------------------------------------------------------------*/
+static int
+PipeInit( PIPE *p, FILE *fp, u_int32 size )
+{
+    memset( p, 0, sizeof(*p) );
+    p->fp   = fp;
+    p->size = size;
+    p->crc  = 0xffffffff;
+    pthread_mutex_init( &p->mtx, NULL );
+    pthread_cond_init( &p->cond, NULL );
+
+    p->buf[0] = malloc( CHUNK_SIZE );
+    p->buf[1] = malloc( CHUNK_SIZE );
+
+    return( p->buf[0] && p->buf[1] ? 0 : 1 );
+}
+
+/*--------------------------------------------------------------------------*/
+static void
+PipeExit( PIPE *p )
+{
+    free( p->buf[0] );
+    free( p->buf[1] );
+    pthread_mutex_destroy( &p->mtx );
+    pthread_cond_destroy( &p->cond );
+}
+
+/*--------------------------------------------------------------------------*/
+/* save [offs, offs+size) to image file */
+/*--------------------------------------------------------------------------*/
+static int
+Save( MDIS_PATH path, char *file, u_int32 offs, u_int32 size, u_int32 width )
+{
+    IMG_HDR hdr;
+    PIPE pipe;
+    pthread_t tid;
+    FILE *fp;
+    u_int32 done, t0;
+    int b, err = 0;
+
+    if( (fp = fopen( file, "wb" )) == NULL ) {
+        printf("*** can't create %s\n", file );
+        return( 1 );
+    }
+
+    memset( &hdr, 0, sizeof(hdr) );
+    hdr.magic     = IMG_MAGIC;
+    hdr.version   = IMG_VERSION;
+    hdr.offset    = offs;
+    hdr.size      = size;
+    hdr.width     = width;
+    hdr.byteOrder = IMG_BYTEORDER;
+
+    /* header is rewritten with CRC at the end */
+    if( fwrite( &hdr, sizeof(hdr), 1, fp ) != 1 || PipeInit( &pipe, fp, size ) ) {
+        fclose( fp );
+        return( 1 );
+    }
+
+    t0 = UOS_MsecTimerGet();
+    if( (err = pthread_create( &tid, NULL, SaveWriter, &pipe )) ) {
+        printf("*** can't create file thread: %s\n", strerror( err ) );
+        PipeExit( &pipe );
+        fclose( fp );
+        return( 1 );
+    }
+
+    for( b=0, done=0; done < size; b ^= 1 ) {
+        if( !PipeWait( &pipe, b, 0 ) )
+            break;
+
+        pipe.len[b] = size - done < CHUNK_SIZE ? size - done : CHUNK_SIZE;
+        if( (err = DevXfer( path, offs + done, width, pipe.len[b],
+                            pipe.buf[b], 0 )) ) {
+            printf("*** read error at 0x%x: %s\n", offs + done,
+                   M_errstring( err ) );
+            break;
+        }
+        done += pipe.len[b];
+        PipeSignal( &pipe, b, 1 );
+    }
+
+    PipeEnd( &pipe, err );
+    pthread_join( tid, NULL );
+    err |= pipe.err;
+
+    hdr.crc = pipe.crc ^ 0xffffffff;
+    if( !err && (fseek( fp, 0, SEEK_SET ) ||
+                 fwrite( &hdr, sizeof(hdr), 1, fp ) != 1) )
+        err = 1;
+
+    PipeExit( &pipe );
+    if( fclose( fp ) )
+        err = 1;
+
+    if( !err )
+        printf("saved 0x%x..0x%x (D%d, crc 0x%08x) to %s in %u ms\n",
+               offs, offs + size, width*8, hdr.crc, file,
+               UOS_MsecTimerGet() - t0 );
+
+    return( err ? 1 : 0 );
+}
+
+/*--------------------------------------------------------------------------*/
+/* byte swap elements of width bytes (image from other endianness) */
+/*--------------------------------------------------------------------------*/
+static void
+SwapBuf( u_int8 *p, u_int32 len, u_int32 width )
+{
+    u_int32 i;
+    u_int8 t;
+
+    for( i=0; i+width<=len; i+=width ) {
+        if( width == 2 ) {
+            t = p[i]; p[i] = p[i+1]; p[i+1] = t;
+        }
+        else if( width == 4 ) {
+            t = p[i];   p[i]   = p[i+3]; p[i+3] = t;
+            t = p[i+1]; p[i+1] = p[i+2]; p[i+2] = t;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+/* restore image file to SRAM, optionally verify each chunk */
+/*--------------------------------------------------------------------------*/
+static int
+Restore( MDIS_PATH path, char *file, int verify )
+{
+    IMG_HDR hdr;
+    PIPE pipe;
+    pthread_t tid;
+    FILE *fp;
+    u_int8 *vbuf = NULL;
+    u_int32 done, crc, t0, i;
+    int b, swap, err = 0;
+
+    if( (fp = fopen( file, "rb" )) == NULL ) {
+        printf("*** can't open %s\n", file );
+        return( 1 );
+    }
+
+    if( fread( &hdr, sizeof(hdr), 1, fp ) != 1 )
+        hdr.magic = 0;
+
+    /* image saved on other endianness: header fields are swapped too */
+    swap = (hdr.byteOrder == IMG_BYTEORDER_SW);
+    if( swap )
+        SwapBuf( (u_int8*)&hdr, sizeof(hdr), 4 );
+
+    if( hdr.magic != IMG_MAGIC || hdr.version != IMG_VERSION ||
+        hdr.byteOrder != IMG_BYTEORDER ||
+        (hdr.width != 1 && hdr.width != 2 && hdr.width != 4) ||
+        hdr.size % hdr.width ) {
+        printf("*** %s: no valid SRAM image\n", file );
+        fclose( fp );
+        return( 1 );
+    }
+
+    /*--- check CRC before touching the SRAM ---*/
+    if( PipeInit( &pipe, fp, hdr.size ) ) {
+        fclose( fp );
+        return( 1 );
+    }
+
+    for( crc=0xffffffff, done=0; done < hdr.size; done += i ) {
+        i = hdr.size - done < CHUNK_SIZE ? hdr.size - done : CHUNK_SIZE;
+        if( fread( pipe.buf[0], 1, i, fp ) != i ) {
+            printf("*** image file truncated\n");
+            err = 1;
+            goto CLEANUP;
+        }
+        crc = Crc32( crc, pipe.buf[0], i );
+    }
+
+    if( (crc ^ 0xffffffff) != hdr.crc ) {
+        printf("*** %s: CRC mismatch (0x%08x, header 0x%08x)\n", file,
+               crc ^ 0xffffffff, hdr.crc );
+        err = 1;
+        goto CLEANUP;
+    }
+
+    fseek( fp, sizeof(hdr), SEEK_SET );
+
+    if( verify && (vbuf = malloc( CHUNK_SIZE )) == NULL ) {
+        err = 1;
+        goto CLEANUP;
+    }
+
+    /*--- write to device while next chunk is read from file ---*/
+    t0 = UOS_MsecTimerGet();
+    if( (err = pthread_create( &tid, NULL, RestoreReader, &pipe )) ) {
+        printf("*** can't create file thread: %s\n", strerror( err ) );
+        err = 1;
+        goto CLEANUP;
+    }
+
+    for( b=0, done=0; done < hdr.size; b ^= 1 ) {
+        if( !PipeWait( &pipe, b, 1 ) )
+            break;
+
+        if( swap )
+            SwapBuf( pipe.buf[b], pipe.len[b], hdr.width );
+
+        if( (err = DevXfer( path, hdr.offset + done, hdr.width, pipe.len[b],
+                            pipe.buf[b], 1 )) ) {
+            printf("*** write error at 0x%x: %s\n", hdr.offset + done,
+                   M_errstring( err ) );
+            break;
+        }
+
+        if( verify ) {
+            if( (err = DevXfer( path, hdr.offset + done, hdr.width,
+                                pipe.len[b], vbuf, 0 )) ) {
+                printf("*** read error at 0x%x: %s\n", hdr.offset + done,
+                       M_errstring( err ) );
+                break;
+            }
+            if( memcmp( vbuf, pipe.buf[b], pipe.len[b] ) ) {
+                for( i=0; vbuf[i] == pipe.buf[b][i]; i++ )
+                    ;
+                printf("*** verify error at 0x%x\n", hdr.offset + done + i );
+                err = 1;
+                break;
+            }
+        }
+
+        done += pipe.len[b];
+        PipeSignal( &pipe, b, 0 );
+    }
+
+    if( err ) {
+        pthread_mutex_lock( &pipe.mtx );
+        pipe.err = 1;
+        pthread_cond_broadcast( &pipe.cond );
+        pthread_mutex_unlock( &pipe.mtx );
+    }
+    pthread_join( tid, NULL );
+    err |= pipe.err;
+
+    if( !err )
+        printf("restored 0x%x..0x%x (D%d%s) from %s in %u ms\n",
+               hdr.offset, hdr.offset + hdr.size, hdr.width*8,
+               verify ? ", verified" : "", file, UOS_MsecTimerGet() - t0 );
+
+ CLEANUP:
+    free( vbuf );
+    PipeExit( &pipe );
+    fclose( fp );
+    return( err ? 1 : 0 );
+}
@@ -0,0 +1,269 @@
+/***********************  I n c l u d e  -  F i l e  ************************
+ *
+ *         Name: mmodprg_api.h
+ *
+ *       Author: kp
+ *
+ *  Description: Header file for MMODPRG user space API library
+ *               - batched and multi-device register access
+ *               - burst, FIFO port and strided/2D transfers
+ *               - in-driver copy and value search within the address window
+ *               - consistent snapshots of firmware-updated blocks
+ *               - per-path driver context selection and counters
+ *               - fixed-rate register sampler setup
+ *               - periodic in-driver write jobs (heartbeat/watchdog)
+ *               - persistent append-only record log
+ *               - persistent key-value store
+ *               - atomic update of small structures (transactions)
+ *               - partition directory for sharing the SRAM
+ *               - software SECDED ECC with scrubber
+ *
+ *     Switches: -
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2010-2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _MMODPRG_API_H
+#define _MMODPRG_API_H
+
+#ifdef __cplusplus
+      extern "C" {
+#endif
+
+/*-----------------------------------------+
+|  DEFINES                                 |
++-----------------------------------------*/
+/* max. number of data bytes transferred per burst driver call */
+#define MMODPRG_API_BURST_CHUNK   0x1000
+
+/* MMODPRG_LogReadNext: no more records */
+#define MMODPRG_LOG_EOF           (-1)
+
+/* MMODPRG_KvGet/KvDelete: key not found, MMODPRG_KvSet: no free slot */
+#define MMODPRG_KV_NOTFOUND       (-1)
+#define MMODPRG_KV_FULL           (-2)
+
+/* max. data length of a transaction object */
+#define MMODPRG_TXN_MAX_LEN       256
+/* max. retries of MMODPRG_TxnRead, max. wait for commit lock [ms] */
+#define MMODPRG_TXN_MAX_RETRY     100
+/* bytes occupied by a transaction object of max. data length m */
+#define MMODPRG_TXN_SIZE(m)       (16 + 2 * (12 + (((m) + 3) & ~3)))
+
+/* partition directory */
+#define MMODPRG_PART_NAME_LEN     16    /* incl. terminating NUL */
+#define MMODPRG_PART_MAX_ENT      256   /* max. number of partitions */
+#define MMODPRG_PART_ALIGN        4     /* alignment of partitions */
+#define MMODPRG_PART_NOTFOUND     (-1)
+#define MMODPRG_PART_NOSPACE      (-2)
+#define MMODPRG_PART_EXISTS       (-3)
+
+/* MMODPRG_EccDecode results, MMODPRG_EccRead: uncorrectable error */
+#define MMODPRG_ECC_OK            0
+#define MMODPRG_ECC_CORR          1
+#define MMODPRG_ECC_UNCORR        (-1)
+
+/*-----------------------------------------+
+|  TYPEDEFS                                |
++-----------------------------------------*/
+/** one register write of a batch */
+typedef struct {
+    u_int32  offset;      /**< offset within address window */
+    u_int32  width;       /**< access width in bytes (1, 2 or 4) */
+    u_int32  value;       /**< value to write */
+} MMODPRG_WR;
+
+/** one device of a fan-out operation */
+typedef struct {
+    MDIS_PATH  path;      /**< in:  path of opened device */
+    int32      result;    /**< out: 0 or MDIS error code of this device */
+} MMODPRG_FANOUT_DEV;
+
+/** log handle (opaque) */
+typedef struct MMODPRG_LOG MMODPRG_LOG;
+
+/** one record of a log append batch */
+typedef struct {
+    const void *data;     /**< record data */
+    u_int32    len;       /**< data length [bytes] */
+} MMODPRG_LOG_REC;
+
+/** read position in a log */
+typedef struct {
+    u_int32  pos;         /**< offset in data area */
+    u_int32  seq;         /**< sequence number of next record to read */
+} MMODPRG_LOG_CURSOR;
+
+/** log state */
+typedef struct {
+    u_int32  seqFirst;    /**< sequence number of oldest record */
+    u_int32  seqNext;     /**< sequence number of next appended record */
+    u_int32  used;        /**< bytes used by records */
+    u_int32  avail;       /**< bytes available without eviction */
+    u_int32  recovered;   /**< records recovered behind checkpoint on open */
+} MMODPRG_LOG_INFO;
+
+/** key-value store handle (opaque) */
+typedef struct MMODPRG_KV MMODPRG_KV;
+
+/** key-value store state */
+typedef struct {
+    u_int32  nSlots;      /**< number of slots */
+    u_int32  used;        /**< slots in use */
+    u_int32  keyMax;      /**< max. key length */
+    u_int32  valMax;      /**< max. value length */
+    u_int32  invalid;     /**< slots with bad CRC found on open */
+} MMODPRG_KV_INFO;
+
+/** transaction object handle (opaque) */
+typedef struct MMODPRG_TXN MMODPRG_TXN;
+
+/** partition directory handle (opaque) */
+typedef struct MMODPRG_PART MMODPRG_PART;
+
+/** partition directory entry (as stored in SRAM) */
+typedef struct {
+    char     name[MMODPRG_PART_NAME_LEN]; /**< name, "" = unused entry */
+    u_int32  offset;      /**< start offset in address window */
+    u_int32  size;        /**< size [bytes] */
+    u_int32  owner;       /**< owner id (application defined) */
+    u_int32  version;     /**< incremented on each resize */
+} MMODPRG_PART_ENT;
+
+/** ECC handle (opaque) */
+typedef struct MMODPRG_ECC MMODPRG_ECC;
+
+/** ECC error counters */
+typedef struct {
+    u_int32  corrected;     /**< single bit errors corrected */
+    u_int32  uncorrectable; /**< double bit errors detected */
+    u_int32  scrubbed;      /**< words rewritten by scrubber */
+    u_int32  scrubPasses;   /**< complete scrubber passes */
+} MMODPRG_ECC_STAT;
+
+/*-----------------------------------------+
+|  PROTOTYPES                              |
++-----------------------------------------*/
+extern int32 MMODPRG_WriteBatch( MDIS_PATH path, const MMODPRG_WR *wr,
+                                 int nWr );
+extern int32 MMODPRG_FanOutWrite( MMODPRG_FANOUT_DEV *dev, int nDev,
+                                  const MMODPRG_WR *wr, int nWr );
+extern int32 MMODPRG_BurstRead( MDIS_PATH path, u_int32 offset,
+                                u_int32 width, u_int32 count, void *data );
+extern int32 MMODPRG_BurstWrite( MDIS_PATH path, u_int32 offset,
+                                 u_int32 width, u_int32 count,
+                                 const void *data );
+extern int32 MMODPRG_FifoRead( MDIS_PATH path, const MMODPRG_FIFO_HDR *port,
+                               void *data, u_int32 *doneP );
+extern int32 MMODPRG_FifoWrite( MDIS_PATH path, const MMODPRG_FIFO_HDR *port,
+                                const void *data, u_int32 *doneP );
+extern int32 MMODPRG_StrideRead( MDIS_PATH path,
+                                 const MMODPRG_STRIDE_HDR *desc, void *data );
+extern int32 MMODPRG_StrideWrite( MDIS_PATH path,
+                                  const MMODPRG_STRIDE_HDR *desc,
+                                  const void *data );
+extern int32 MMODPRG_Copy( MDIS_PATH path, u_int32 dst, u_int32 src,
+                           u_int32 len );
+extern int32 MMODPRG_Search( MDIS_PATH path, const MMODPRG_SEARCH_HDR *desc,
+                             u_int32 *hits, u_int32 *nHitsP );
+extern int32 MMODPRG_SnapRead( MDIS_PATH path,
+                               const MMODPRG_SNAP_HDR *desc, void *data,
+                               u_int32 *retriesP );
+extern int32 MMODPRG_CtxSelect( MDIS_PATH path, u_int32 ctx );
+extern int32 MMODPRG_CtxStat( MDIS_PATH path, MMODPRG_CTX_STAT *stat,
+                              int clear );
+extern int32 MMODPRG_SamplerStart( MDIS_PATH path, u_int32 periodMs,
+                                   u_int32 nSamples,
+                                   const MMODPRG_SMP_ENTRY *ent,
+                                   u_int32 nEntries );
+extern int32 MMODPRG_JobStart( MDIS_PATH path, const MMODPRG_JOB *job );
+extern int32 MMODPRG_JobStop( MDIS_PATH path, u_int32 id );
+extern int32 MMODPRG_JobStat( MDIS_PATH path, u_int32 id,
+                              MMODPRG_JOB_STAT *stat );
+
+extern u_int32 MMODPRG_Crc32( u_int32 crc, const void *data, u_int32 len );
+extern int32 MMODPRG_LogFormat( MDIS_PATH path, u_int32 base, u_int32 size );
+extern int32 MMODPRG_LogOpen( MDIS_PATH path, u_int32 base, u_int32 size,
+                              MMODPRG_LOG **logP );
+extern int32 MMODPRG_LogClose( MMODPRG_LOG *log );
+extern int32 MMODPRG_LogAppend( MMODPRG_LOG *log, const void *data,
+                                u_int32 len );
+extern int32 MMODPRG_LogAppendBatch( MMODPRG_LOG *log,
+                                     const MMODPRG_LOG_REC *rec, int nRec );
+extern void  MMODPRG_LogRewind( MMODPRG_LOG *log, MMODPRG_LOG_CURSOR *cur );
+extern int32 MMODPRG_LogReadNext( MMODPRG_LOG *log, MMODPRG_LOG_CURSOR *cur,
+                                  void *buf, u_int32 maxLen, u_int32 *lenP,
+                                  u_int32 *seqP );
+extern void  MMODPRG_LogGetInfo( MMODPRG_LOG *log, MMODPRG_LOG_INFO *info );
+
+extern int32 MMODPRG_KvFormat( MDIS_PATH path, u_int32 base, u_int32 size,
+                               u_int32 keyMax, u_int32 valMax );
+extern int32 MMODPRG_KvOpen( MDIS_PATH path, u_int32 base, MMODPRG_KV **kvP );
+extern int32 MMODPRG_KvClose( MMODPRG_KV *kv );
+extern int32 MMODPRG_KvGet( MMODPRG_KV *kv, const char *key, void *val,
+                            u_int32 maxLen, u_int32 *lenP );
+extern int32 MMODPRG_KvSet( MMODPRG_KV *kv, const char *key, const void *val,
+                            u_int32 len );
+extern int32 MMODPRG_KvDelete( MMODPRG_KV *kv, const char *key );
+extern void  MMODPRG_KvGetInfo( MMODPRG_KV *kv, MMODPRG_KV_INFO *info );
+
+extern int32 MMODPRG_TxnFormat( MDIS_PATH path, u_int32 base, u_int32 maxLen );
+extern int32 MMODPRG_TxnOpen( MDIS_PATH path, u_int32 base, u_int32 maxLen,
+                              MMODPRG_TXN **txP );
+extern int32 MMODPRG_TxnClose( MMODPRG_TXN *tx );
+extern int32 MMODPRG_TxnCommit( MMODPRG_TXN *tx, const void *data,
+                                u_int32 len );
+extern int32 MMODPRG_TxnRead( MMODPRG_TXN *tx, void *buf, u_int32 maxLen,
+                              u_int32 *lenP, u_int32 *retriesP );
+
+extern int32 MMODPRG_PartFormat( MDIS_PATH path, u_int32 sramSize,
+                                 u_int32 maxEnt );
+extern int32 MMODPRG_PartOpen( MDIS_PATH path, MMODPRG_PART **ptP );
+extern int32 MMODPRG_PartClose( MMODPRG_PART *pt );
+extern int32 MMODPRG_PartRefresh( MMODPRG_PART *pt );
+extern int32 MMODPRG_PartLookup( MMODPRG_PART *pt, const char *name,
+                                 MMODPRG_PART_ENT *ent );
+extern int32 MMODPRG_PartCreate( MMODPRG_PART *pt, const char *name,
+                                 u_int32 size, u_int32 owner,
+                                 MMODPRG_PART_ENT *ent );
+extern int32 MMODPRG_PartResize( MMODPRG_PART *pt, const char *name,
+                                 u_int32 newSize, MMODPRG_PART_ENT *ent );
+extern int32 MMODPRG_PartDelete( MMODPRG_PART *pt, const char *name );
+extern int   MMODPRG_PartList( MMODPRG_PART *pt, MMODPRG_PART_ENT *ent,
+                               int maxEnt );
+
+extern u_int8 MMODPRG_EccEncode( u_int32 data );
+extern int   MMODPRG_EccDecode( u_int32 *dataP, u_int8 chk );
+extern int32 MMODPRG_EccOpen( MDIS_PATH path, u_int32 dataBase, u_int32 size,
+                              u_int32 chkBase, MMODPRG_ECC **eccP );
+extern int32 MMODPRG_EccClose( MMODPRG_ECC *ecc );
+extern int32 MMODPRG_EccRebuild( MMODPRG_ECC *ecc );
+extern int32 MMODPRG_EccWrite( MMODPRG_ECC *ecc, u_int32 offset,
+                               const u_int32 *data, u_int32 nWords );
+extern int32 MMODPRG_EccRead( MMODPRG_ECC *ecc, u_int32 offset,
+                              u_int32 *data, u_int32 nWords, u_int32 *badP );
+extern void  MMODPRG_EccGetStat( MMODPRG_ECC *ecc, MMODPRG_ECC_STAT *stat );
+extern int32 MMODPRG_EccScrubStart( MMODPRG_ECC *ecc, u_int32 nWords,
+                                    u_int32 periodMs );
+extern void  MMODPRG_EccScrubStop( MMODPRG_ECC *ecc );
+
+#ifdef __cplusplus
+      }
+#endif
+
+#endif /* _MMODPRG_API_H */
@@ -45,17 +45,378 @@ typedef struct {
     u_int32  value;       /**< value read from / write to hardware register */
 } MMODPRG_DX_PB;
 
+/** one instruction of a micro-sequence program (MMODPRG_BLK_SEQ) */
+typedef struct {
+    u_int8   op;          /**< opcode MMODPRG_SEQ_xxx */
+    u_int8   width;       /**< access width in bytes (1, 2 or 4) */
+    u_int16  arg;         /**< opcode specific argument (see opcodes) */
+    u_int32  offset;      /**< register offset within address window */
+    u_int32  value;       /**< value to write / compare */
+    u_int32  mask;        /**< bit mask for RMW / POLL / BEQ / BNE */
+} MMODPRG_SEQ_OP;
+
+/**
+ * header of a micro-sequence program (MMODPRG_BLK_SEQ)
+ *
+ * The header is followed by \a nOps MMODPRG_SEQ_OP instructions and
+ * \a nResults u_int32 result slots in the same M_SG_BLOCK.
+ */
+typedef struct {
+    u_int32  nOps;        /**< number of instructions */
+    u_int32  nResults;    /**< number of result slots */
+    u_int32  status;      /**< out: MMODPRG_SEQ_ST_xxx */
+    u_int32  steps;       /**< out: number of executed instructions */
+    u_int32  failOp;      /**< out: index of instruction that timed out */
+    u_int32  acc;         /**< out: accumulator at program end */
+} MMODPRG_SEQ_HDR;
+
+/**
+ * header of a burst transfer (MMODPRG_BLK_BURST)
+ *
+ * The header is followed by \a count elements of \a width bytes
+ * (u_int8/u_int16/u_int32 array) in the same M_SG_BLOCK.
+ */
+typedef struct {
+    u_int32  offset;      /**< start offset within address window */
+    u_int32  width;       /**< access width in bytes (1, 2 or 4) */
+    u_int32  count;       /**< number of elements */
+} MMODPRG_BURST_HDR;
+
+/**
+ * header of a FIFO transfer (MMODPRG_BLK_FIFO)
+ *
+ * All \a count elements are transferred at the fixed \a offset. If
+ * \a levelWidth is not 0, the level register is read once before the
+ * transfer and the transfer is limited to
+ * ((level & levelMask) >> levelShift) elements (filled entries when
+ * reading, free entries when writing). The header is followed by
+ * \a count elements of \a width bytes in the same M_SG_BLOCK.
+ * Writes (SetStat) return no \a done count, read the level register
+ * before writing to know how many elements fit.
+ */
+typedef struct {
+    u_int32  offset;      /**< FIFO data register offset */
+    u_int32  width;       /**< access width in bytes (1, 2 or 4) */
+    u_int32  count;       /**< number of elements */
+    u_int32  levelOffset; /**< level register offset */
+    u_int32  levelWidth;  /**< level register width, 0=no level register */
+    u_int32  levelMask;   /**< level bits, 0=all */
+    u_int32  levelShift;  /**< level bit position */
+    u_int32  done;        /**< out: elements transferred (GetStat only) */
+} MMODPRG_FIFO_HDR;
+
+/**
+ * header of a strided/2D transfer (MMODPRG_BLK_STRIDE)
+ *
+ * Element e of row r is at offset + r*pitch + e*stride. The elements
+ * are packed densely (row by row) into the data following the header
+ * in the same M_SG_BLOCK, i.e. rows*count elements of \a width bytes.
+ * Use rows=1 for a 1D strided transfer.
+ */
+typedef struct {
+    u_int32  offset;      /**< offset of first element */
+    u_int32  width;       /**< element width in bytes (1, 2 or 4) */
+    u_int32  count;       /**< elements per row */
+    u_int32  stride;      /**< distance of elements within a row [bytes] */
+    u_int32  rows;        /**< number of rows (>=1) */
+    u_int32  pitch;       /**< distance of row starts [bytes] */
+} MMODPRG_STRIDE_HDR;
+
+/**
+ * parameters of an in-window copy (MMODPRG_BLK_COPY)
+ *
+ * Copies \a len bytes from \a src to \a dst like memmove(), i.e.
+ * overlapping ranges are handled correctly.
+ */
+typedef struct {
+    u_int32  src;         /**< source offset */
+    u_int32  dst;         /**< destination offset */
+    u_int32  len;         /**< number of bytes */
+} MMODPRG_COPY_PB;
+
+/**
+ * header of a pattern search (MMODPRG_BLK_SEARCH)
+ *
+ * The elements at offset, offset+stride, ... within
+ * [offset, offset+len) are compared with (elem & mask) == (value & mask).
+ * The header is followed by \a maxHits u_int32 slots receiving the
+ * offsets of the first matches in the same M_SG_BLOCK.
+ */
+typedef struct {
+    u_int32  offset;      /**< start of search range (aligned to width) */
+    u_int32  len;         /**< length of search range [bytes] */
+    u_int32  width;       /**< element width in bytes (1, 2 or 4) */
+    u_int32  stride;      /**< element distance [bytes], 0=width */
+    u_int32  value;       /**< value to search */
+    u_int32  mask;        /**< bits to compare, 0=all */
+    u_int32  maxHits;     /**< number of offset slots */
+    u_int32  nHits;       /**< out: number of matches stored */
+} MMODPRG_SEARCH_HDR;
+
+/**
+ * header of a consistent snapshot read (MMODPRG_BLK_SNAP)
+ *
+ * The firmware changes the sequence register around each update of the
+ * block. The driver reads the sequence register, the block and the
+ * sequence register again and retries until both sequence values are
+ * equal (and even, with MMODPRG_SNAP_ODD_BUSY). The header is followed
+ * by \a count elements of \a width bytes in the same M_SG_BLOCK.
+ */
+typedef struct {
+    u_int32  seqOffset;   /**< sequence register offset */
+    u_int32  seqWidth;    /**< sequence register width (1, 2 or 4) */
+    u_int32  offset;      /**< start offset of block */
+    u_int32  width;       /**< access width in bytes (1, 2 or 4) */
+    u_int32  count;       /**< number of elements */
+    u_int32  flags;       /**< MMODPRG_SNAP_xxx */
+    u_int32  maxRetry;    /**< max. retries, 0=MMODPRG_SNAP_MAX_RETRY */
+    u_int32  retries;     /**< out: retries needed */
+    u_int32  seq;         /**< out: sequence value of snapshot */
+} MMODPRG_SNAP_HDR;
+
+/**
+ * per-path counters (MMODPRG_BLK_CTX_STAT)
+ *
+ * Each channel has its own context holding these counters and the copy
+ * staging buffer (MMODPRG_COPY_STAGE).
+ *
+ * Isolation is opt-in: every path starts on channel 0, so all paths
+ * share context 0 (and count into the same counters) until they select
+ * different channels with M_MK_CH_CURRENT (see MMODPRG_CtxSelect()).
+ * Note that the driver reports MMODPRG_CTX_NUM channels
+ * (M_LL_CH_NUMBER), not 1, so M_IO_EXEC_INC mode steps through the
+ * contexts.
+ */
+typedef struct {
+    u_int32  setStats;    /**< SetStat calls */
+    u_int32  getStats;    /**< GetStat calls */
+    u_int32  blkReads;    /**< block read calls */
+    u_int32  errors;      /**< calls that returned an error */
+    u_int32  bytesIn;     /**< driver block bytes passed by SetStat */
+    u_int32  bytesOut;    /**< driver block bytes returned (GetStat, read) */
+} MMODPRG_CTX_STAT;
+
+/**
+ * trace record (MMODPRG_BLK_TRC)
+ *
+ * One record per successful status call issued while tracing is on. Single accesses
+ * (MMODPRG_BLK_D8/D16/D32) are recorded with offset and value, all other
+ * device codes (e.g. MMODPRG_BLK_SEQ, _BURST, _FIFO, _STRIDE, _COPY,
+ * _SNAP) with code and block length only.
+ */
+typedef struct {
+    u_int32  usec;        /**< timestamp [us], wraps (see MMODPRG_TRC_RES) */
+    u_int32  code;        /**< status code */
+    u_int32  offset;      /**< offset within address window, 0=none */
+    u_int32  value;       /**< value written/read, or block length [bytes] */
+    u_int8   width;       /**< access width in bytes (1, 2 or 4), 0=none */
+    u_int8   op;          /**< MMODPRG_TRC_OP_xxx */
+    u_int8   ch;          /**< channel (context) of the path */
+    u_int8   reserved;
+} MMODPRG_TRC_ENT;
+
+/**
+ * header of a trace read (MMODPRG_BLK_TRC)
+ *
+ * Followed by \a maxEnt MMODPRG_TRC_ENT slots in the same M_SG_BLOCK.
+ * The driver moves up to maxEnt records (oldest first) to the slots.
+ */
+typedef struct {
+    u_int32  maxEnt;      /**< number of record slots */
+    u_int32  nEnt;        /**< out: records returned */
+    u_int32  lost;        /**< out: records lost since start (ring full) */
+} MMODPRG_TRC_HDR;
+
+/* periodic job limits */
+#define MMODPRG_JOB_MAX      8      /* number of job slots                   */
+#define MMODPRG_JOB_MAX_VAL  16     /* max. values of a sequence             */
+
+/**
+ * periodic write job (MMODPRG_BLK_JOB_START)
+ *
+ * Every \a periodMs the job writes one value to \a offset:
+ * - MMODPRG_JOB_SEQ: values[0], values[1], ... values[nValues-1],
+ *   values[0], ...
+ * - MMODPRG_JOB_XOR: values[0], values[0]^mask, values[0], ...
+ *   i.e. the bits in \a mask toggle each period (no read-back)
+ */
+typedef struct {
+    u_int32  id;          /**< job slot (0..MMODPRG_JOB_MAX-1) */
+    u_int32  offset;      /**< register offset */
+    u_int32  width;       /**< access width in bytes (1, 2 or 4) */
+    u_int32  periodMs;    /**< period [ms], min. two OSS ticks */
+    u_int32  mode;        /**< MMODPRG_JOB_SEQ or MMODPRG_JOB_XOR */
+    u_int32  mask;        /**< XOR: bits to toggle */
+    u_int32  nValues;     /**< SEQ: number of values (1..max) */
+    u_int32  values[MMODPRG_JOB_MAX_VAL]; /**< values, XOR: start value */
+} MMODPRG_JOB;
+
+/** status of a periodic write job (MMODPRG_BLK_JOB_STAT) */
+typedef struct {
+    u_int32  id;          /**< in: job slot */
+    u_int32  running;     /**< out: job is running */
+    u_int32  realMs;      /**< out: real timer period [ms] */
+    u_int32  runs;        /**< out: writes done */
+    u_int32  missed;      /**< out: missed deadlines */
+    u_int32  lastValue;   /**< out: value last written */
+} MMODPRG_JOB_STAT;
+
+/** one register of a sampling plan */
+typedef struct {
+    u_int32  offset;      /**< offset within address window */
+    u_int32  width;       /**< access width in bytes (1, 2 or 4) */
+} MMODPRG_SMP_ENTRY;
+
+/**
+ * sampling plan (MMODPRG_BLK_SMP_PLAN)
+ *
+ * The header is followed by \a nEntries MMODPRG_SMP_ENTRY in the same
+ * M_SG_BLOCK.
+ */
+typedef struct {
+    u_int32  periodMs;    /**< sampling period [ms] */
+    u_int32  nEntries;    /**< number of registers per sample */
+    u_int32  nSamples;    /**< ring buffer capacity [samples] */
+} MMODPRG_SMP_PLAN;
+
+/**
+ * sample as read with M_getblock()
+ *
+ * The header is followed by \a nEntries u_int32 values in plan order.
+ */
+typedef struct {
+    u_int32  seq;         /**< sample number since start */
+    u_int32  tick;        /**< OSS tick counter at sampling time */
+} MMODPRG_SMP_REC;
+
 /*-----------------------------------------+
 |  DEFINES                                 |
 +-----------------------------------------*/
 /* MMODPRG specific status codes (STD) */			/* S,G: S=setstat, G=getstat */
-/*#define MMODPRG_XXX           M_DEV_OF+0x00	*/	/* G,S: xxx */
+#define MMODPRG_WIN_SIZE     M_DEV_OF+0x00     /* G  : Address window size   */
+#define MMODPRG_SRAM_SIZE    M_DEV_OF+0x01     /* G  : Probe usable SRAM size*/
+#define MMODPRG_SMP_STOP     M_DEV_OF+0x02     /*   S: Stop sampler          */
+#define MMODPRG_SMP_OVERRUN  M_DEV_OF+0x03     /* G  : Samples lost (full)   */
+#define MMODPRG_SMP_COUNT    M_DEV_OF+0x04     /* G  : Samples in buffer     */
+#define MMODPRG_SMP_PERIOD   M_DEV_OF+0x05     /* G  : Real period [ms],0=off*/
+#define MMODPRG_CTX_CLR      M_DEV_OF+0x07     /*   S: Clear path counters   */
+#define MMODPRG_TRC_START    M_DEV_OF+0x08     /*   S: Start trace (capacity)*/
+#define MMODPRG_TRC_STOP     M_DEV_OF+0x09     /*   S: Stop trace            */
+#define MMODPRG_TRC_COUNT    M_DEV_OF+0x0a     /* G  : Records in trace ring */
+#define MMODPRG_TRC_RES      M_DEV_OF+0x0b     /* G  : Trace time resol. [us]*/
+#define MMODPRG_JOB_STOP     M_DEV_OF+0x0c     /*   S: Stop periodic job(id) */
 
 /* MMODPRG specific status codes (BLK)	*/	   /* S,G: S=setstat, G=getstat */
 #define MMODPRG_BLK_D8       M_DEV_BLK_OF+0x00 /* G,S: Read/write 8bit value */
 #define MMODPRG_BLK_D16      M_DEV_BLK_OF+0x01 /* G,S: Read/write 16bit value*/
 #define MMODPRG_BLK_D32      M_DEV_BLK_OF+0x02 /* G,S: Read/write 32bit value*/
+#define MMODPRG_BLK_SEQ      M_DEV_BLK_OF+0x03 /* G,S: Run micro-sequence    */
+#define MMODPRG_BLK_BURST    M_DEV_BLK_OF+0x04 /* G,S: Read/write burst      */
+#define MMODPRG_BLK_SMP_PLAN M_DEV_BLK_OF+0x05 /*   S: Load plan, start sampler*/
+#define MMODPRG_BLK_FIFO     M_DEV_BLK_OF+0x06 /* G,S: Read/write FIFO port  */
+#define MMODPRG_BLK_STRIDE   M_DEV_BLK_OF+0x07 /* G,S: Strided/2D transfer   */
+#define MMODPRG_BLK_COPY     M_DEV_BLK_OF+0x08 /*   S: Copy within window    */
+#define MMODPRG_BLK_SEARCH   M_DEV_BLK_OF+0x09 /* G  : Search value/pattern  */
+#define MMODPRG_BLK_SNAP     M_DEV_BLK_OF+0x0a /* G  : Seqlock snapshot read */
+#define MMODPRG_BLK_CTX_STAT M_DEV_BLK_OF+0x0b /* G  : Get path counters     */
+#define MMODPRG_BLK_TRC      M_DEV_BLK_OF+0x0c /* G  : Read trace records    */
+#define MMODPRG_BLK_JOB_START M_DEV_BLK_OF+0x0d /*  S: Start periodic job    */
+#define MMODPRG_BLK_JOB_STAT M_DEV_BLK_OF+0x0e /* G  : Periodic job status   */
 
+/*
+ * micro-sequence opcodes (MMODPRG_SEQ_OP.op)
+ * acc is the accumulator holding the last value read
+ */
+#define MMODPRG_SEQ_END      0x00   /* stop program                          */
+#define MMODPRG_SEQ_WRITE    0x01   /* write value to offset                 */
+#define MMODPRG_SEQ_READ     0x02   /* acc = read offset, store to res[arg]  */
+#define MMODPRG_SEQ_RMW      0x03   /* acc = (read & ~mask) | (value & mask),
+                                       write acc back to offset              */
+#define MMODPRG_SEQ_POLL     0x04   /* wait until (read & mask) == value,
+                                       re-read max. arg times 1us apart      */
+#define MMODPRG_SEQ_DELAY    0x05   /* wait value microseconds (sleeps for
+                                       whole milliseconds)                   */
+#define MMODPRG_SEQ_BEQ      0x06   /* goto op arg if (acc & mask) == value  */
+#define MMODPRG_SEQ_BNE      0x07   /* goto op arg if (acc & mask) != value  */
+
+#define MMODPRG_SEQ_NORES    0xffff /* READ: don't store to result slot      */
+#define MMODPRG_SEQ_MAX_OPS  1024   /* max. number of instructions           */
+#define MMODPRG_SEQ_MAX_STEPS 0x10000 /* max. executed instructions (loops)  */
+#define MMODPRG_SEQ_MAX_DELAY 10000   /* max. DELAY value [us]               */
+#define MMODPRG_SEQ_MAX_WAIT 1000000  /* max. sum of DELAY and POLL wait
+                                         times of one program run [us]       */
+
+/* micro-sequence status (MMODPRG_SEQ_HDR.status) */
+#define MMODPRG_SEQ_ST_OK       0   /* program completed                     */
+#define MMODPRG_SEQ_ST_TIMEOUT  1   /* POLL timed out at failOp              */
+#define MMODPRG_SEQ_ST_STEPS    2   /* MMODPRG_SEQ_MAX_STEPS exceeded        */
+#define MMODPRG_SEQ_ST_WAIT     3   /* MMODPRG_SEQ_MAX_WAIT exceeded (failOp)*/
+
+/* size of a micro-sequence block with n instructions and r result slots */
+#define MMODPRG_SEQ_SIZE(n,r) \
+        (sizeof(MMODPRG_SEQ_HDR) + (n)*sizeof(MMODPRG_SEQ_OP) + (r)*4)
+
+
+/* size of a burst block with n elements of w bytes */
+#define MMODPRG_BURST_SIZE(n,w) \
+        (sizeof(MMODPRG_BURST_HDR) + (n)*(w))
+
+/* size of a FIFO block with n elements of w bytes */
+#define MMODPRG_FIFO_SIZE(n,w) \
+        (sizeof(MMODPRG_FIFO_HDR) + (n)*(w))
+
+/* size of a strided block with r rows of n elements of w bytes */
+#define MMODPRG_STRIDE_SIZE(r,n,w) \
+        (sizeof(MMODPRG_STRIDE_HDR) + (r)*(n)*(w))
+
+/* size of a search block with k offset slots */
+#define MMODPRG_SEARCH_SIZE(k) (sizeof(MMODPRG_SEARCH_HDR) + (k)*4)
+
+/* snapshot flags (MMODPRG_SNAP_HDR.flags) */
+#define MMODPRG_SNAP_ODD_BUSY  0x01 /* odd sequence value: update running */
+
+/* snapshot retry limit */
+#define MMODPRG_SNAP_MAX_RETRY 1000
+
+/* size of a snapshot block with n elements of w bytes */
+#define MMODPRG_SNAP_SIZE(n,w) (sizeof(MMODPRG_SNAP_HDR) + (n)*(w))
+
+/* per-path contexts (channel 0 is shared by all paths that select none) */
+#define MMODPRG_CTX_NUM      16     /* number of contexts (M_LL_CH_NUMBER)   */
+#define MMODPRG_COPY_STAGE   0x400  /* misaligned copy staging buffer per
+                                       context, allocated on first use
+                                       [bytes]                               */
+
+/* trace operations (MMODPRG_TRC_ENT.op) */
+#define MMODPRG_TRC_OP_READ  0      /* GetStat single access         */
+#define MMODPRG_TRC_OP_WRITE 1      /* SetStat single access         */
+#define MMODPRG_TRC_OP_GET   2      /* GetStat other code            */
+#define MMODPRG_TRC_OP_SET   3      /* SetStat other code            */
+
+/* trace limits */
+#define MMODPRG_TRC_MAX_ENT  0x10000    /* max. trace ring capacity      */
+
+/* size of a trace read block with n record slots */
+#define MMODPRG_TRC_SIZE(n) \
+        (sizeof(MMODPRG_TRC_HDR) + (n)*sizeof(MMODPRG_TRC_ENT))
+
+/* periodic job modes (MMODPRG_JOB.mode) */
+#define MMODPRG_JOB_SEQ      0      /* write value sequence cyclically       */
+#define MMODPRG_JOB_XOR      1      /* toggle mask bits each period          */
+
+#define MMODPRG_JOB_ALL      0xffffffff /* MMODPRG_JOB_STOP: all jobs        */
+
+/* sampler limits */
+#define MMODPRG_SMP_MAX_ENTRIES 64        /* max. registers per sample     */
+#define MMODPRG_SMP_MAX_BUF     0x100000  /* max. ring buffer size [bytes] */
+
+/* size of a sampling plan block with n entries */
+#define MMODPRG_SMP_PLAN_SIZE(n) \
+        (sizeof(MMODPRG_SMP_PLAN) + (n)*sizeof(MMODPRG_SMP_ENTRY))
+
+/* size of one sample with n values */
+#define MMODPRG_SMP_REC_SIZE(n) \
+        (sizeof(MMODPRG_SMP_REC) + (n)*4)
 
 /* some useful defines... */
 